@@ -26,6 +26,10 @@
 #define AM33XX_FLAG_SELF_REFRESH	BIT(17)
 #define AM33XX_FLAG_DISABLE_EMIF	BIT(18)
 
+// emulated extra exit latency per state, fixed at init as cpufreq_re
+// may rewrite exit_latency with what it measures
+static u32 am33xx_extra_latency[CPUIDLE_STATE_MAX];
+
 static int am33xx_enter_idle(struct cpuidle_device *dev,
 					struct cpuidle_driver *drv, int index)
 {
@@ -58,7 +62,7 @@ static int am33xx_enter_idle(struct cpuidle_device *dev,
 	// for the emulated states, let M3 enforce the adjustment of 
 	// extra exit_latency
 	if (index > 1) {
-		state_flags = state->exit_latency - drv->states[1].exit_latency;
+		state_flags = am33xx_extra_latency[index];
 	}
 
 	//am33xx_do_sram_cpuidle(wfi_flags, m3_flags);
@@ -151,6 +155,8 @@ static struct cpuidle_driver am33xx_idle_driver = {
  */
 int am33xx_idle_init(bool ddr3)
 {
+	int i;
+
 	if (ddr3) {
 		BUILD_BUG_ON(ARRAY_SIZE(am33xx_ddr3_states) >
 					ARRAY_SIZE(am33xx_idle_driver.states));
@@ -166,5 +172,9 @@ int am33xx_idle_init(bool ddr3)
 		am33xx_idle_driver.state_count =
 						ARRAY_SIZE(am33xx_ddr2_states);
 	}
+	for (i = 2; i < am33xx_idle_driver.state_count; i++)
+		am33xx_extra_latency[i] =
+			am33xx_idle_driver.states[i].exit_latency -
+			am33xx_idle_driver.states[1].exit_latency;
 	return cpuidle_register(&am33xx_idle_driver, NULL);
 }
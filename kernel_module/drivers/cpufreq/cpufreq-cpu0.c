@@ -17,6 +17,7 @@
 #include <linux/clk.h>
 #include <linux/cpu.h>
 #include <linux/cpufreq.h>
+#include <linux/cpufreq_re.h>
 #include <linux/err.h>
 #include <linux/module.h>
 #include <linux/of.h>
@@ -46,9 +47,6 @@ static unsigned int cpu0_get_speed(unsigned int cpu)
 	return clk_get_rate(cpu_clk) / 1000;
 }
 
-extern int cpufreq_re_get_P_states(unsigned int cpu);
-extern int cpufreq_re_report_P_states(int actual_state, int ideal_state);
-
 static int cpu0_set_target(struct cpufreq_policy *policy,
 			   unsigned int target_freq, unsigned int relation)
 {
@@ -58,9 +56,8 @@ static int cpu0_set_target(struct cpufreq_policy *policy,
 	long freq_Hz, freq_exact;
 	unsigned int index;
 	int ret;
-	int cpufreq_re_state;
         ktime_t time_start1, time_start2, time_start3, time_start4;
-        s64 diff1, diff2, diff3;
+        s64 diff1 = 0, diff2, diff3 = 0;
 
 
 	mutex_lock(&cpu_lock);
@@ -72,22 +69,8 @@ static int cpu0_set_target(struct cpufreq_policy *policy,
 
 	ret = cpufreq_frequency_table_target(policy, freq_table, target_freq,
 					     relation, &index);
-	cpufreq_re_state = cpufreq_re_get_P_states(policy->cpu);
-	cpufreq_re_report_P_states(cpufreq_re_state, index);
-	if (index < cpufreq_re_state) 
-	{
-		index = cpufreq_re_state;
-	}
-	/*
-	printk("cpu0_set_target: cpufreq_re_P_state: %d\n", cpufreq_re_state);
-	printk("freq_table: %d %d %d %d %d\n", 
-			freq_table[0].frequency * 1000,
-			freq_table[1].frequency * 1000,
-			freq_table[2].frequency * 1000,
-			freq_table[3].frequency * 1000,
-			freq_table[4].frequency * 1000
-		);
-	*/
+	// the reliability floor and energy cap are applied by the
+	// "reliability" governor (cpufreq_re_governor.c)
 	if (ret) {
 		pr_err("failed to match target freqency %d: %d\n",
 		       target_freq, ret);
@@ -176,6 +159,9 @@ static int cpu0_set_target(struct cpufreq_policy *policy,
 	//printk("Step1 takes %d usec\n", (int)diff1);
 	//printk("Step2 takes %d usec\n", (int)diff2);
         //printk("Step3 takes %d usec\n", (int)diff3);
+	if (!ret)
+		cpufreq_re_hook_report_transition(policy->cpu,
+				(unsigned int)(diff1 + diff2 + diff3));
 
 post_notify:
 	cpufreq_notify_transition(policy, &freqs, CPUFREQ_POSTCHANGE);
@@ -302,6 +288,13 @@ static int cpu0_cpufreq_probe(struct platform_device *pdev)
 	}
 
 	ret = of_init_opp_table(cpu_dev);
+	if (ret) {
+		// OPPs may be added at run time instead (cpufreq_re_emu.c)
+		rcu_read_lock();
+		if (opp_get_opp_count(cpu_dev) > 0)
+			ret = 0;
+		rcu_read_unlock();
+	}
 	if (ret) {
 		pr_err("failed to init OPP table: %d\n", ret);
 		goto out_put_node;
@@ -0,0 +1,225 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_bench.c
+ *
+ * Times the entry points cpufreq_re_stats puts on the idle path and the
+ * transition path when loaded, then stays loaded until rmmod. Every
+ * function is measured warm (back to back calls) and cold (a buffer
+ * larger than L2 is written between calls), each with and without
+ * kthreads reading core_fit_acc through the sysfs show function. One
+ * line per case goes to the kernel log:
+ *
+ *   RE_BENCH <function> <warm|cold> <readers>: calls mean p50 p99 max
+ *
+ * with times in ns, the ktime_get() overhead taken off.
+ *
+ */
+
+#include <linux/cpufreq.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
+
+#include "cpufreq_re_bench.h"
+
+static unsigned int iterations = 100000;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "warm calls per case, cold cases run 1/100 of it");
+
+static unsigned int readers = 1;
+module_param(readers, uint, 0444);
+MODULE_PARM_DESC(readers, "sysfs reader threads in the loaded cases");
+
+static unsigned int cold_kb = 1024;
+module_param(cold_kb, uint, 0444);
+MODULE_PARM_DESC(cold_kb, "buffer written between cold calls, above L2");
+
+enum re_bench_func {
+	RE_BENCH_GET_C,
+	RE_BENCH_GET_P,
+	RE_BENCH_UPDATE,
+	RE_BENCH_TRANS,
+	RE_BENCH_FUNCS,
+};
+
+static const char * const re_bench_names[RE_BENCH_FUNCS] = {
+	"get_C_states", "get_P_states", "stats_update", "notifier_trans",
+};
+
+static u32 *re_bench_samples;
+static u8 *re_bench_thrash;
+static struct task_struct **re_bench_readers;
+static struct cpufreq_freqs re_bench_freqs;
+
+static int re_bench_reader(void *data)
+{
+	struct cpufreq_policy *policy = data;
+	char *buf = (char *)get_zeroed_page(GFP_KERNEL);
+
+	if (!buf)
+		return -ENOMEM;
+	while (!kthread_should_stop()) {
+		cpufreq_re_bench_ops.show_core_fit_acc(policy, buf);
+		cond_resched();
+	}
+	free_page((unsigned long)buf);
+	return 0;
+}
+
+static void re_bench_call(int func, unsigned int cpu)
+{
+	switch (func) {
+	case RE_BENCH_GET_C:
+		cpufreq_re_bench_ops.get_C_states(cpu);
+		break;
+	case RE_BENCH_GET_P:
+		cpufreq_re_bench_ops.get_P_states(cpu);
+		break;
+	case RE_BENCH_UPDATE:
+		cpufreq_re_bench_ops.stats_update(cpu);
+		break;
+	case RE_BENCH_TRANS:
+		// same frequency, so the accounting is updated but not moved
+		cpufreq_re_bench_ops.notifier_trans(NULL, CPUFREQ_POSTCHANGE,
+				&re_bench_freqs);
+		break;
+	}
+}
+
+static void re_bench_cold(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < cold_kb * 1024; i += L1_CACHE_BYTES)
+		re_bench_thrash[i]++;
+}
+
+static int re_bench_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+// cost of the time stamps around one call
+static u32 re_bench_overhead(void)
+{
+	unsigned int i;
+	u32 best = ~0U;
+	ktime_t t0;
+	s64 ns;
+
+	for (i = 0; i < 1000; i++) {
+		t0 = ktime_get();
+		ns = ktime_to_ns(ktime_sub(ktime_get(), t0));
+		if (ns < best)
+			best = ns;
+	}
+	return best;
+}
+
+static void re_bench_case(int func, unsigned int cpu, int cold,
+			unsigned int nr_readers, u32 overhead)
+{
+	unsigned int calls = cold ? max(iterations / 100, 1U) : iterations;
+	unsigned int i;
+	u64 sum = 0;
+	ktime_t t0;
+	s64 ns;
+
+	for (i = 0; i < calls; i++) {
+		if (cold)
+			re_bench_cold();
+		t0 = ktime_get();
+		re_bench_call(func, cpu);
+		ns = ktime_to_ns(ktime_sub(ktime_get(), t0)) - overhead;
+		re_bench_samples[i] = ns > 0 ? ns : 0;
+		sum += re_bench_samples[i];
+		// lets the readers in on UP, and keeps the watchdog quiet
+		if (!(i & 1023))
+			cond_resched();
+	}
+	sort(re_bench_samples, calls, sizeof(u32), re_bench_cmp, NULL);
+	pr_info("RE_BENCH %s %s %u: %u %llu %u %u %u\n", re_bench_names[func],
+		cold ? "cold" : "warm", nr_readers, calls,
+		div_u64(sum, calls), re_bench_samples[calls / 2],
+		re_bench_samples[(u64)calls * 99 / 100],
+		re_bench_samples[calls - 1]);
+}
+
+static void re_bench_stop_readers(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < readers; i++)
+		if (!IS_ERR_OR_NULL(re_bench_readers[i]))
+			kthread_stop(re_bench_readers[i]);
+}
+
+static int __init cpufreq_re_bench_init(void)
+{
+	struct cpufreq_policy *policy;
+	unsigned int cpu, i, loaded;
+	int func, cold, ret = 0;
+	u32 overhead;
+
+	if (!iterations)
+		return -EINVAL;
+	cpu = get_cpu();
+	put_cpu();
+	policy = cpufreq_cpu_get(cpu);
+	if (!policy)
+		return -ENODEV;
+	re_bench_freqs.cpu = cpu;
+	re_bench_freqs.old = policy->cur;
+	re_bench_freqs.new = policy->cur;
+
+	re_bench_samples = vmalloc(iterations * sizeof(u32));
+	re_bench_thrash = vmalloc(cold_kb * 1024);
+	re_bench_readers = kcalloc(readers, sizeof(*re_bench_readers),
+			GFP_KERNEL);
+	if (!re_bench_samples || !re_bench_thrash ||
+	    (readers && !re_bench_readers)) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	overhead = re_bench_overhead();
+	pr_info("RE_BENCH overhead: %u\n", overhead);
+	for (loaded = 0; loaded <= 1; loaded++) {
+		if (loaded) {
+			if (!readers)
+				break;
+			for (i = 0; i < readers; i++)
+				re_bench_readers[i] = kthread_run(re_bench_reader,
+						policy, "re_bench/%u", i);
+		}
+		for (func = 0; func < RE_BENCH_FUNCS; func++)
+			for (cold = 0; cold <= 1; cold++)
+				re_bench_case(func, cpu, cold,
+						loaded ? readers : 0, overhead);
+		if (loaded)
+			re_bench_stop_readers();
+	}
+out:
+	vfree(re_bench_samples);
+	vfree(re_bench_thrash);
+	kfree(re_bench_readers);
+	cpufreq_cpu_put(policy);
+	return ret;
+}
+
+static void __exit cpufreq_re_bench_exit(void)
+{
+}
+
+MODULE_DESCRIPTION("'cpufreq_re_bench' - timing of the cpufreq_re_stats hooks");
+MODULE_LICENSE("GPL");
+
+module_init(cpufreq_re_bench_init);
+module_exit(cpufreq_re_bench_exit);
@@ -0,0 +1,27 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_bench.h
+ *
+ * cpufreq_re_bench.h : interface for timing the idle path and
+ * transition path entry points of cpufreq_re_stats from the
+ * cpufreq_re_bench module
+ *
+ */
+
+#ifndef _CPUFREQ_RE_BENCH_H
+#define _CPUFREQ_RE_BENCH_H
+
+#include <linux/cpufreq.h>
+#include <linux/notifier.h>
+
+struct cpufreq_re_bench_ops {
+	int (*get_C_states)(unsigned int cpu);
+	int (*get_P_states)(unsigned int cpu);
+	int (*stats_update)(unsigned int cpu);
+	int (*notifier_trans)(struct notifier_block *nb, unsigned long val,
+			void *data);
+	ssize_t (*show_core_fit_acc)(struct cpufreq_policy *policy, char *buf);
+};
+
+extern const struct cpufreq_re_bench_ops cpufreq_re_bench_ops;
+
+#endif
@@ -0,0 +1,284 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_calib.c
+ *
+ * Online calibration of the cpuidle exit latencies.
+ *
+ * cpuidle_enter_state() reports every idle period that ended with the
+ * timer it was programmed for, together with how late it came back
+ * after the timer expired: the hardware wakeup plus the exit path of
+ * the driver (on the AM335x the M3 relocking the PLL and busy waiting
+ * the emulated part of C2/C3). A work item samples the wkup_m3 IPC
+ * round trip, which the MPU PLL states pay again on entry. Both go into
+ * per state histograms of RE_CALIB_BUCKET_US wide buckets.
+ *
+ * In RE_CALIB_APPLY mode, once a state has RE_CALIB_MIN_SAMPLES, its
+ * exit_latency becomes the RE_CALIB_PCT percentile of the lateness,
+ * plus that of the round trip for states past WFI where wkup_m3 exists.
+ * target_residency keeps its ratio to exit_latency from the driver
+ * table. Both stay monotonic over the states, so the menu governor
+ * stops picking a deep state its real cost does not pay for. The table
+ * values are restored when the mode is left.
+ *
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpuidle.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+#include "cpufreq_re_calib.h"
+
+#define RE_CALIB_BUCKETS 128
+#define RE_CALIB_BUCKET_US 16		// 0 .. 2 ms, the last bucket is open
+#define RE_CALIB_PCT 90
+#define RE_CALIB_MIN_SAMPLES 64
+#define RE_CALIB_PERIOD_MS 1000
+
+#if defined(CONFIG_SOC_AM33XX) || defined(CONFIG_ARCH_VEXPRESS)
+#define RE_CALIB_M3
+extern int wkup_m3_ping_delay(int iteration);
+#endif
+
+struct re_calib_hist {
+	u32 count;
+	u32 max;
+	u64 sum;
+	u32 bucket[RE_CALIB_BUCKETS];
+};
+
+// written from the idle path of the cpu only
+static DEFINE_PER_CPU(struct re_calib_hist [CPUIDLE_STATE_MAX], re_calib_late);
+static struct re_calib_hist re_calib_m3;
+
+static int re_calib_mode;
+static DEFINE_SPINLOCK(re_calib_lock);
+
+// the table as registered, while RE_CALIB_APPLY has it changed
+static struct cpuidle_driver *re_calib_drv;
+static unsigned int re_calib_exit_latency[CPUIDLE_STATE_MAX];
+static unsigned int re_calib_target_residency[CPUIDLE_STATE_MAX];
+
+static void re_calib_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(re_calib_work, re_calib_work_fn);
+
+static void re_calib_add(struct re_calib_hist *h, unsigned int us)
+{
+	h->bucket[min_t(unsigned int, us / RE_CALIB_BUCKET_US,
+			RE_CALIB_BUCKETS - 1)]++;
+	h->count++;
+	h->sum += us;
+	if (us > h->max)
+		h->max = us;
+}
+
+// upper edge of the bucket holding the pct percentile, max when open
+static unsigned int re_calib_pct(const struct re_calib_hist *h,
+			unsigned int pct)
+{
+	u32 want, seen = 0;
+	int i;
+
+	if (!h->count)
+		return 0;
+	want = DIV_ROUND_UP(h->count * pct, 100);
+	for (i = 0; i < RE_CALIB_BUCKETS - 1; i++) {
+		seen += h->bucket[i];
+		if (seen >= want)
+			return min_t(unsigned int, (i + 1) * RE_CALIB_BUCKET_US,
+					h->max);
+	}
+	return h->max;
+}
+
+// per state histograms of all cpus, one cpuidle driver is assumed
+static void re_calib_merge(int state, struct re_calib_hist *out)
+{
+	struct re_calib_hist *h;
+	unsigned int cpu;
+	int i;
+
+	memset(out, 0, sizeof(*out));
+	for_each_online_cpu(cpu) {
+		h = &per_cpu(re_calib_late, cpu)[state];
+		out->count += h->count;
+		out->sum += h->sum;
+		out->max = max(out->max, h->max);
+		for (i = 0; i < RE_CALIB_BUCKETS; i++)
+			out->bucket[i] += h->bucket[i];
+	}
+}
+
+void cpufreq_re_calib_late(unsigned int cpu, int state, int late_us)
+{
+	if (re_calib_mode == RE_CALIB_OFF || state < 0 ||
+	    state >= CPUIDLE_STATE_MAX || late_us < 0)
+		return;
+	re_calib_add(&per_cpu(re_calib_late, cpu)[state], late_us);
+}
+
+static struct cpuidle_driver *re_calib_get_driver(void)
+{
+	struct cpuidle_device *dev = per_cpu(cpuidle_devices, 0);
+
+	return dev ? cpuidle_get_cpu_driver(dev) : NULL;
+}
+
+static void re_calib_restore(void)
+{
+	int i;
+
+	if (!re_calib_drv)
+		return;
+	for (i = 0; i < re_calib_drv->state_count; i++) {
+		re_calib_drv->states[i].exit_latency = re_calib_exit_latency[i];
+		re_calib_drv->states[i].target_residency =
+			re_calib_target_residency[i];
+	}
+	re_calib_drv = NULL;
+}
+
+static void re_calib_apply(void)
+{
+	struct cpuidle_driver *drv = re_calib_get_driver();
+	struct re_calib_hist h;
+	unsigned int exit, target, prev_exit = 0, prev_target = 0, m3 = 0;
+	int i;
+
+	if (!drv)
+		return;
+	if (!re_calib_drv) {
+		re_calib_drv = drv;
+		for (i = 0; i < drv->state_count; i++) {
+			re_calib_exit_latency[i] = drv->states[i].exit_latency;
+			re_calib_target_residency[i] =
+				drv->states[i].target_residency;
+		}
+	}
+#ifdef RE_CALIB_M3
+	if (re_calib_m3.count >= RE_CALIB_MIN_SAMPLES)
+		m3 = re_calib_pct(&re_calib_m3, RE_CALIB_PCT);
+#endif
+	for (i = 0; i < drv->state_count; i++) {
+		re_calib_merge(i, &h);
+		exit = re_calib_exit_latency[i];
+		target = re_calib_target_residency[i];
+		if (h.count >= RE_CALIB_MIN_SAMPLES) {
+			exit = re_calib_pct(&h, RE_CALIB_PCT);
+			if (i > 0)
+				exit += m3;
+			if (re_calib_exit_latency[i])
+				target = (u64)re_calib_target_residency[i] * exit
+					/ re_calib_exit_latency[i];
+			target = max(target, exit);
+		}
+		exit = max(exit, prev_exit);
+		target = max(target, prev_target);
+		drv->states[i].exit_latency = exit;
+		drv->states[i].target_residency = target;
+		prev_exit = exit;
+		prev_target = target;
+	}
+}
+
+static void re_calib_work_fn(struct work_struct *work)
+{
+#ifdef RE_CALIB_M3
+	int rtt = wkup_m3_ping_delay(0);
+
+	if (rtt >= 0) {
+		spin_lock(&re_calib_lock);
+		re_calib_add(&re_calib_m3, rtt);
+		spin_unlock(&re_calib_lock);
+	}
+#endif
+	spin_lock(&re_calib_lock);
+	if (re_calib_mode == RE_CALIB_APPLY)
+		re_calib_apply();
+	spin_unlock(&re_calib_lock);
+	if (re_calib_mode != RE_CALIB_OFF)
+		schedule_delayed_work(&re_calib_work,
+				msecs_to_jiffies(RE_CALIB_PERIOD_MS));
+}
+
+int cpufreq_re_calib_get_mode(void)
+{
+	return re_calib_mode;
+}
+
+/*
+ * Starting to collect clears the histograms, leaving RE_CALIB_APPLY
+ * puts the driver table back.
+ */
+int cpufreq_re_calib_set_mode(int mode)
+{
+	unsigned int cpu;
+
+	if (mode < RE_CALIB_OFF || mode > RE_CALIB_APPLY)
+		return -EINVAL;
+	spin_lock(&re_calib_lock);
+	if (re_calib_mode == RE_CALIB_OFF && mode != RE_CALIB_OFF) {
+		for_each_possible_cpu(cpu)
+			memset(per_cpu(re_calib_late, cpu), 0,
+				sizeof(per_cpu(re_calib_late, cpu)));
+		memset(&re_calib_m3, 0, sizeof(re_calib_m3));
+	}
+	if (mode != RE_CALIB_APPLY)
+		re_calib_restore();
+	re_calib_mode = mode;
+	spin_unlock(&re_calib_lock);
+	if (mode != RE_CALIB_OFF)
+		mod_delayed_work(system_wq, &re_calib_work, 0);
+	return 0;
+}
+
+/*
+ * One line per state and one for the M3:
+ * "name count mean p50 p90 max exit_latency target_residency", then the
+ * non-empty buckets as "lower_edge_us:count".
+ */
+static ssize_t re_calib_show_hist(char *buf, ssize_t len, const char *name,
+			const struct re_calib_hist *h, int exit, int target)
+{
+	int i;
+
+	len += scnprintf(buf + len, PAGE_SIZE - len, "%s %u %llu %u %u %u %d %d",
+			name, h->count,
+			h->count ? div_u64(h->sum, h->count) : 0,
+			re_calib_pct(h, 50), re_calib_pct(h, RE_CALIB_PCT),
+			h->max, exit, target);
+	for (i = 0; i < RE_CALIB_BUCKETS; i++)
+		if (h->bucket[i])
+			len += scnprintf(buf + len, PAGE_SIZE - len, " %u:%u",
+					i * RE_CALIB_BUCKET_US, h->bucket[i]);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+	return len;
+}
+
+ssize_t cpufreq_re_calib_show(char *buf)
+{
+	struct cpuidle_driver *drv = re_calib_get_driver();
+	struct re_calib_hist h;
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; drv && i < drv->state_count; i++) {
+		re_calib_merge(i, &h);
+		len = re_calib_show_hist(buf, len, drv->states[i].name, &h,
+				drv->states[i].exit_latency,
+				drv->states[i].target_residency);
+	}
+	spin_lock(&re_calib_lock);
+	h = re_calib_m3;
+	spin_unlock(&re_calib_lock);
+	return re_calib_show_hist(buf, len, "M3", &h, -1, -1);
+}
+
+// leaves the driver table as registered
+void cpufreq_re_calib_exit(void)
+{
+	cpufreq_re_calib_set_mode(RE_CALIB_OFF);
+	cancel_delayed_work_sync(&re_calib_work);
+}
@@ -0,0 +1,26 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_calib.h
+ *
+ * cpufreq_re_calib.h : interface for the online calibration of the
+ * cpuidle exit latencies: per state histograms of how late timer
+ * wakeups return from cpuidle_enter_state(), the wkup_m3 round trip,
+ * and a mode that writes the measured values back into the driver.
+ *
+ */
+
+#ifndef _CPUFREQ_RE_CALIB_H
+#define _CPUFREQ_RE_CALIB_H
+
+#include <linux/types.h>
+
+#define RE_CALIB_OFF 0		// nothing recorded
+#define RE_CALIB_COLLECT 1	// histograms only
+#define RE_CALIB_APPLY 2	// and exit_latency / target_residency updated
+
+void cpufreq_re_calib_exit(void);
+void cpufreq_re_calib_late(unsigned int cpu, int state, int late_us);
+int cpufreq_re_calib_get_mode(void);
+int cpufreq_re_calib_set_mode(int mode);
+ssize_t cpufreq_re_calib_show(char *buf);
+
+#endif
@@ -0,0 +1,342 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_cgroup.c
+ *
+ * "re" cgroup subsystem for cpufreq_re_stats.
+ *
+ * FIT and energy accumulated by cpufreq_re_stats_update() are charged
+ * to the cgroup of the task that was running, hierarchically. Each
+ * cgroup exposes:
+ *   re.fit_consumed    - core + mem FIT accumulated (rate * usec)
+ *   re.energy_consumed - core + mem energy accumulated (power * usec)
+ *   re.fit_budget      - FIT rate budget (same unit as cur_core_fit),
+ *                        0 means the cpu wide budget applies
+ *
+ * Charging happens at every accounting point of cpufreq_re_stats
+ * (idle entry, frequency transition, sysfs and log samples). When
+ * tracepoints are available, every context switch also charges the
+ * task that ran at the C0 rates cpufreq_re_stats last published for
+ * the cpu; the next accounting point only charges what is left over.
+ *
+ */
+
+#include <linux/atomic.h>
+#include <linux/cgroup.h>
+#include <linux/cpufreq_re.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <trace/events/sched.h>
+
+#include "cpufreq_re_cgroup.h"
+
+
+struct re_cgroup {
+	struct cgroup_subsys_state css;
+	atomic64_t fit_consumed;
+	atomic64_t energy_consumed;
+	unsigned int fit_budget;
+	spinlock_t lock;			// protects the budget cycle
+	unsigned long long budget_stop_time;	// in usec
+	u64 budget_start_fit;
+};
+
+static struct re_cgroup *root_re_cgroup;
+
+/*
+ * Group of the last user task seen on each cpu. The cpufreq governor
+ * runs from a kworker, so the P-state floor must look at the task it
+ * interrupted rather than at current.
+ */
+static DEFINE_PER_CPU(struct re_cgroup *, re_cgroup_running);
+
+/*
+ * Per cpu state of the context switch probe, which runs under the
+ * runqueue lock and must not call back into cpufreq_re_stats.
+ */
+struct re_cgroup_cpu {
+	u64 last_switch;		// local_clock() ns
+	unsigned int fit_rate;		// C0 FIT and power per usec
+	unsigned int energy_rate;
+	atomic64_t fit_charged;		// charged since the last accounting
+	atomic64_t energy_charged;
+};
+
+static DEFINE_PER_CPU(struct re_cgroup_cpu, re_cgroup_cpu);
+
+static inline struct re_cgroup *css_re(struct cgroup_subsys_state *css)
+{
+	return css ? container_of(css, struct re_cgroup, css) : NULL;
+}
+
+static inline struct re_cgroup *task_re(struct task_struct *task)
+{
+	return css_re(task_css(task, re_subsys_id));
+}
+
+static inline struct re_cgroup *parent_re(struct re_cgroup *rg)
+{
+	return css_re(css_parent(&rg->css));
+}
+
+static struct cgroup_subsys_state *
+re_css_alloc(struct cgroup_subsys_state *parent_css)
+{
+	struct re_cgroup *rg;
+
+	rg = kzalloc(sizeof(*rg), GFP_KERNEL);
+	if (!rg)
+		return ERR_PTR(-ENOMEM);
+	atomic64_set(&rg->fit_consumed, 0);
+	atomic64_set(&rg->energy_consumed, 0);
+	spin_lock_init(&rg->lock);
+	if (!parent_css)
+		root_re_cgroup = rg;
+	return &rg->css;
+}
+
+static void re_css_offline(struct cgroup_subsys_state *css)
+{
+	struct re_cgroup *rg = css_re(css);
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu)
+		cmpxchg(&per_cpu(re_cgroup_running, cpu), rg, NULL);
+}
+
+static void re_css_free(struct cgroup_subsys_state *css)
+{
+	struct re_cgroup *rg = css_re(css);
+
+	if (rg == root_re_cgroup)
+		root_re_cgroup = NULL;
+	kfree(rg);
+}
+
+static u64 re_fit_consumed_read(struct cgroup_subsys_state *css,
+				struct cftype *cft)
+{
+	unsigned int cpu;
+
+	for_each_online_cpu(cpu)
+		cpufreq_re_hook_stats_sync(cpu);
+	return atomic64_read(&css_re(css)->fit_consumed);
+}
+
+static u64 re_energy_consumed_read(struct cgroup_subsys_state *css,
+				struct cftype *cft)
+{
+	unsigned int cpu;
+
+	for_each_online_cpu(cpu)
+		cpufreq_re_hook_stats_sync(cpu);
+	return atomic64_read(&css_re(css)->energy_consumed);
+}
+
+static u64 re_fit_budget_read(struct cgroup_subsys_state *css,
+				struct cftype *cft)
+{
+	return css_re(css)->fit_budget;
+}
+
+static int re_fit_budget_write(struct cgroup_subsys_state *css,
+				struct cftype *cft, u64 val)
+{
+	struct re_cgroup *rg = css_re(css);
+	unsigned long flags;
+
+	if (val > UINT_MAX)
+		return -EINVAL;
+	spin_lock_irqsave(&rg->lock, flags);
+	rg->fit_budget = (unsigned int)val;
+	// restart the budget cycle with the new rate
+	rg->budget_stop_time = 0;
+	spin_unlock_irqrestore(&rg->lock, flags);
+	return 0;
+}
+
+static struct cftype re_cgroup_files[] = {
+	{
+		.name = "fit_consumed",
+		.read_u64 = re_fit_consumed_read,
+	},
+	{
+		.name = "energy_consumed",
+		.read_u64 = re_energy_consumed_read,
+	},
+	{
+		.name = "fit_budget",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = re_fit_budget_read,
+		.write_u64 = re_fit_budget_write,
+	},
+	{ }	/* terminate */
+};
+
+struct cgroup_subsys re_subsys = {
+	.name = "re",
+	.css_alloc = re_css_alloc,
+	.css_offline = re_css_offline,
+	.css_free = re_css_free,
+	.subsys_id = re_subsys_id,
+	.base_cftypes = re_cgroup_files,
+};
+
+// rg and all its ancestors, within rcu_read_lock()
+static void re_cgroup_add(struct re_cgroup *rg, u64 fit, u64 energy)
+{
+	for (; rg; rg = parent_re(rg)) {
+		atomic64_add(fit, &rg->fit_consumed);
+		atomic64_add(energy, &rg->energy_consumed);
+	}
+}
+
+/*
+ * Charge fit and energy to the group of current and all its ancestors,
+ * less what context switches on cpu charged since the last call.
+ * Called from cpufreq_re_stats_update(), possibly from the idle loop
+ * where RCU is not watching; the idle task always charges the root.
+ * So does a sync of another cpu, whose task current is not.
+ */
+void cpufreq_re_cgroup_charge(unsigned int cpu, u64 fit, u64 energy)
+{
+	struct re_cgroup_cpu *rc = &per_cpu(re_cgroup_cpu, cpu);
+	struct re_cgroup *rg;
+
+	fit -= min_t(u64, fit, atomic64_xchg(&rc->fit_charged, 0));
+	energy -= min_t(u64, energy, atomic64_xchg(&rc->energy_charged, 0));
+	if (!fit && !energy)
+		return;
+
+	if (cpu != raw_smp_processor_id() || is_idle_task(current)) {
+		rg = root_re_cgroup;
+		if (rg) {
+			atomic64_add(fit, &rg->fit_consumed);
+			atomic64_add(energy, &rg->energy_consumed);
+		}
+		return;
+	}
+
+	rcu_read_lock();
+	rg = task_re(current);
+	if (!(current->flags & PF_KTHREAD))
+		per_cpu(re_cgroup_running, cpu) = rg;
+	re_cgroup_add(rg, fit, energy);
+	rcu_read_unlock();
+}
+EXPORT_SYMBOL_GPL(cpufreq_re_cgroup_charge);
+
+/*
+ * C0 rates of cpu at its current OPP and vulnerability factors, set by
+ * cpufreq_re_stats_update() for the context switch probe.
+ */
+void cpufreq_re_cgroup_set_rates(unsigned int cpu, unsigned int fit_rate,
+			unsigned int energy_rate)
+{
+	struct re_cgroup_cpu *rc = &per_cpu(re_cgroup_cpu, cpu);
+
+	ACCESS_ONCE(rc->fit_rate) = fit_rate;
+	ACCESS_ONCE(rc->energy_rate) = energy_rate;
+}
+EXPORT_SYMBOL_GPL(cpufreq_re_cgroup_set_rates);
+
+/*
+ * FIT rate still available to the group of the last user task on cpu
+ * for the rest of its budget cycle. Returns -ENOENT if that group has
+ * no budget of its own, in which case the cpu wide budget applies.
+ */
+int cpufreq_re_cgroup_fit_target(unsigned int cpu,
+			unsigned long long cur_time,
+			unsigned long long epoch_length,
+			unsigned int *fit_target)
+{
+	struct re_cgroup *rg;
+	unsigned long flags;
+	u64 consumed, budget;
+	int ret = -ENOENT;
+
+	rcu_read_lock();
+	rg = per_cpu(re_cgroup_running, cpu);
+	if (!rg || !rg->fit_budget)
+		goto out;
+
+	consumed = atomic64_read(&rg->fit_consumed);
+	spin_lock_irqsave(&rg->lock, flags);
+	if (cur_time >= rg->budget_stop_time) {
+		rg->budget_stop_time = cur_time + epoch_length;
+		rg->budget_start_fit = consumed;
+	}
+	budget = (u64)rg->fit_budget * epoch_length;
+	consumed -= rg->budget_start_fit;
+	if (consumed >= budget)
+		*fit_target = 0;
+	else
+		*fit_target = (unsigned int)div64_u64(budget - consumed,
+				rg->budget_stop_time - cur_time + 1);
+	spin_unlock_irqrestore(&rg->lock, flags);
+	ret = 0;
+out:
+	rcu_read_unlock();
+	return ret;
+}
+EXPORT_SYMBOL_GPL(cpufreq_re_cgroup_fit_target);
+
+#ifdef CONFIG_TRACEPOINTS
+/*
+ * Charge prev for the time it ran since the last switch, from per cpu
+ * state only. Idle time stays with cpufreq_re_stats_update(), which
+ * tells the idle states apart.
+ */
+static void re_cgroup_sched_switch(void *data, struct task_struct *prev,
+				struct task_struct *next)
+{
+	struct re_cgroup_cpu *rc = this_cpu_ptr(&re_cgroup_cpu);
+	u64 now = local_clock(), usec, fit, energy;
+	struct re_cgroup *rg;
+
+	usec = rc->last_switch ? div_u64(now - rc->last_switch, NSEC_PER_USEC)
+			: 0;
+	rc->last_switch = now;
+	if (is_idle_task(prev) || !usec)
+		return;
+	fit = usec * ACCESS_ONCE(rc->fit_rate);
+	energy = usec * ACCESS_ONCE(rc->energy_rate);
+
+	rcu_read_lock();
+	rg = task_re(prev);
+	if (!(prev->flags & PF_KTHREAD))
+		__this_cpu_write(re_cgroup_running, rg);
+	re_cgroup_add(rg, fit, energy);
+	rcu_read_unlock();
+	atomic64_add(fit, &rc->fit_charged);
+	atomic64_add(energy, &rc->energy_charged);
+}
+
+int cpufreq_re_cgroup_init(void)
+{
+	return register_trace_sched_switch(re_cgroup_sched_switch, NULL);
+}
+EXPORT_SYMBOL_GPL(cpufreq_re_cgroup_init);
+
+void cpufreq_re_cgroup_exit(void)
+{
+	unregister_trace_sched_switch(re_cgroup_sched_switch, NULL);
+	tracepoint_synchronize_unregister();
+}
+EXPORT_SYMBOL_GPL(cpufreq_re_cgroup_exit);
+#else
+int cpufreq_re_cgroup_init(void)
+{
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cpufreq_re_cgroup_init);
+
+void cpufreq_re_cgroup_exit(void)
+{
+}
+EXPORT_SYMBOL_GPL(cpufreq_re_cgroup_exit);
+#endif
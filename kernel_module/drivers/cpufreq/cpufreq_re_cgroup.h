@@ -0,0 +1,37 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_cgroup.h
+ *
+ * cpufreq_re_cgroup.h : interface for attributing reliability
+ * and energy accumulation to the cgroup of the running task
+ *
+ */
+
+#ifndef _CPUFREQ_RE_CGROUP_H
+#define _CPUFREQ_RE_CGROUP_H
+
+#include <linux/types.h>
+
+#ifdef CONFIG_CGROUPS
+int cpufreq_re_cgroup_init(void);
+void cpufreq_re_cgroup_exit(void);
+void cpufreq_re_cgroup_charge(unsigned int cpu, u64 fit, u64 energy);
+void cpufreq_re_cgroup_set_rates(unsigned int cpu, unsigned int fit_rate,
+			unsigned int energy_rate);
+int cpufreq_re_cgroup_fit_target(unsigned int cpu,
+			unsigned long long cur_time,
+			unsigned long long epoch_length,
+			unsigned int *fit_target);
+#else
+static inline int cpufreq_re_cgroup_init(void) { return 0; }
+static inline void cpufreq_re_cgroup_exit(void) { }
+static inline void cpufreq_re_cgroup_charge(unsigned int cpu, u64 fit,
+			u64 energy) { }
+static inline void cpufreq_re_cgroup_set_rates(unsigned int cpu,
+			unsigned int fit_rate, unsigned int energy_rate) { }
+static inline int cpufreq_re_cgroup_fit_target(unsigned int cpu,
+			unsigned long long cur_time,
+			unsigned long long epoch_length,
+			unsigned int *fit_target) { return -ENOENT; }
+#endif
+
+#endif
@@ -0,0 +1,284 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_core.c
+ *
+ * Accounting and budget rules of cpufreq_re_stats that do not depend on
+ * the kernel. Everything here works on plain values passed in by the
+ * caller, locking and per cpu state stay with the caller, so the file
+ * builds unchanged for userspace (see tools/jit-rfts).
+ *
+ */
+
+#ifdef __KERNEL__
+#include <linux/kernel.h>
+#include <linux/string.h>
+#else
+#include <string.h>
+#endif
+
+#include "cpufreq_re_core.h"
+
+/*
+ * OPP frequencies in fit_data index order
+ */
+const unsigned int re_opp_khz[RE_CORE_OPPS] = {
+	1000*1000, 800*1000, 720*1000, 600*1000, 300*1000
+};
+
+/*
+ * fit_data index of an OPP, -1 if the model has no data for it
+ */
+int re_core_opp_index(unsigned int khz)
+{
+	int i;
+
+	for (i = 0; i < RE_CORE_OPPS; i++)
+		if (re_opp_khz[i] == khz)
+			return i;
+	return -1;
+}
+
+void re_core_rates(const struct cpufreq_re_fit_data *fit_data, int index,
+			unsigned int location_factor,
+			struct re_core_rates *rates)
+{
+	rates->cur_core_fit = fit_data->core_fit[index]
+	                        * location_factor / 100;
+	rates->cur_mem_fit = (fit_data->L1_mem_fit[index] + fit_data->L2_mem_fit)
+	                        * location_factor / 100;
+	rates->cur_l1_fit = fit_data->L1_mem_fit[index]
+	                        * location_factor / 100;
+	rates->cpuidle_c1_fit = fit_data->core_fit_c1[index]
+	                        * location_factor / 100;
+	rates->cpuidle_c2_fit = fit_data->core_fit_c2
+	                        * location_factor / 100;
+	rates->cpuidle_mem_ret_fit = (fit_data->L1_mem_fit_ret[index] + fit_data->L2_mem_fit_ret)
+	                        * location_factor / 100;
+	rates->cur_core_pow = fit_data->core_pow[index];
+	rates->cur_mem_pow = fit_data->L1_mem_pow[index] + fit_data->L2_mem_pow;
+	rates->cur_mem_pow_l2_ret = fit_data->L1_mem_pow[index] + fit_data->L2_mem_fit_ret;
+	rates->cpuidle_c1_pow = fit_data->core_pow_c1[index];
+	rates->cpuidle_mem_ret_pow = fit_data->L1_mem_pow_ret[index]
+	                        + fit_data->L2_mem_pow_ret;
+	rates->cur_wear = fit_data->wear_rate[index];
+	rates->cpuidle_c1_wear = fit_data->wear_rate_c1[index];
+	rates->cpuidle_ret_wear = fit_data->wear_rate_ret;
+}
+
+/*
+ * Default per cycle targets: target_factor / 10 times the rates of the
+ * deepest idle configuration at the slowest OPP
+ */
+void re_core_fit_targets(const struct cpufreq_re_fit_data *fit_data,
+			unsigned int target_factor,
+			unsigned int *core_fit_target,
+			unsigned int *mem_fit_target)
+{
+	if (fit_data->core_fit_c2 > fit_data->core_fit[4])
+		*core_fit_target = fit_data->core_fit_c2 * target_factor / 10;
+	else
+		*core_fit_target = fit_data->core_fit[4] * target_factor / 10;
+	*mem_fit_target = (fit_data->L1_mem_fit_ret[4] + fit_data->L2_mem_fit_ret)
+				* target_factor / 10;
+}
+
+/*
+ * Total FIT rate while in cpuidle state i, as charged by
+ * re_core_account(). State 0 (WFI) counts as C0.
+ */
+unsigned int re_core_idle_fit(const struct re_core_rates *rates, int state)
+{
+	switch (state) {
+	case 0:
+		return rates->cur_core_fit + rates->cur_mem_fit;
+	case 1:
+		return rates->cpuidle_c1_fit + rates->cur_mem_fit;
+	case 2:
+		return rates->cpuidle_c2_fit + rates->cur_mem_fit;
+	default:
+		return rates->cpuidle_c2_fit + rates->cpuidle_mem_ret_fit;
+	}
+}
+
+/*
+ * Charge idle_time[i] usec spent in each C-state at the given rates.
+ * c0_core_fit and c0_mem_fit are the C0 rates after any vulnerability
+ * scaling.
+ */
+void re_core_account(struct re_core_acc *acc,
+			const struct re_core_rates *rates,
+			const int idle_time[RE_CORE_IDLE_STATES],
+			unsigned int c0_core_fit, unsigned int c0_mem_fit)
+{
+	acc->core_fit_acc += (u64)idle_time[0] * c0_core_fit
+			+ (u64)idle_time[1] * rates->cpuidle_c1_fit
+			+ (u64)idle_time[2] * rates->cpuidle_c2_fit
+			+ (u64)idle_time[3] * rates->cpuidle_c2_fit;
+	acc->mem_fit_acc += (u64)idle_time[0] * c0_mem_fit
+			+ (u64)idle_time[1] * rates->cur_mem_fit
+			+ (u64)idle_time[2] * rates->cur_mem_fit
+			+ (u64)idle_time[3] * rates->cpuidle_mem_ret_fit;
+
+	acc->core_pow_acc += (u64)idle_time[0] * rates->cur_core_pow
+			+ (u64)idle_time[1] * rates->cpuidle_c1_pow;
+	acc->mem_pow_acc += (u64)idle_time[0] * rates->cur_mem_pow
+			+ (u64)idle_time[1] * rates->cur_mem_pow
+			+ (u64)idle_time[2] * rates->cur_mem_pow_l2_ret
+			+ (u64)idle_time[3] * rates->cpuidle_mem_ret_pow;
+
+	acc->wear_acc += (u64)idle_time[0] * rates->cur_wear
+			+ (u64)idle_time[1] * rates->cpuidle_c1_wear
+			+ (u64)(idle_time[2] + idle_time[3])
+				* rates->cpuidle_ret_wear;
+}
+
+/*
+ * Budget bank: the balance of a closed cycle (leftover or overflow) is
+ * carried into the next one, up to bank_cap cycles worth of credit and
+ * at most one cycle worth of debt, so idle periods fund later bursts
+ * while the long window target still holds. bank_cap = 0 keeps the
+ * old behaviour of discarding the balance.
+ */
+s64 re_core_bank_close(s64 balance, u64 cycle_budget, int bank_cap)
+{
+	s64 cap = (s64)cycle_budget * bank_cap;
+
+	if (!bank_cap)
+		return 0;
+	if (balance > cap)
+		return cap;
+	if (balance < -(s64)cycle_budget)
+		return -(s64)cycle_budget;
+	return balance;
+}
+
+/*
+ * FIT rate left for the rest of the running cycle, 0 once the cycle
+ * budget (including bank credit) is spent.
+ */
+unsigned int re_core_remaining_rate(u64 target_acc, u64 acc,
+			unsigned long long budget_stop_time,
+			unsigned long long cur_wall_time)
+{
+	unsigned int time_left;
+
+	if (target_acc <= acc)
+		return 0;
+	time_left = (unsigned int)((budget_stop_time - cur_wall_time)>>8);
+	if (!time_left)
+		time_left = 1;
+	return (unsigned int)((target_acc - acc)>>8) / time_left;
+}
+
+/*
+ * Threshold rule for the C-state ceiling: C2 and C3 are only allowed
+ * while the remaining allowance covers their retention FIT.
+ */
+int re_core_c_ceiling(unsigned int core_fit_rate, unsigned int mem_fit_rate,
+			unsigned int c2_fit, unsigned int mem_ret_fit)
+{
+	if (core_fit_rate < c2_fit)
+		return 1;	// C1 only
+	if (mem_fit_rate < mem_ret_fit)
+		return 2;	// C1 or C2
+	return 3;
+}
+
+/*
+ * Lowest P-state whose core and mem FIT rates both fit the allowance,
+ * with the C0 rates scaled by the vulnerability factors (1/1024)
+ */
+int re_core_fit_floor(const struct cpufreq_re_fit_data *fit_data,
+			unsigned int location_factor, unsigned int avf_core,
+			unsigned int avf_l1, unsigned int core_rate,
+			unsigned int mem_rate)
+{
+	unsigned int core_i, mem_i;
+	int i;
+
+	for (i = 4; i >= 0; i--) {
+		core_i = (unsigned int)((u64)fit_data->core_fit[i] * avf_core >> 10)
+				* location_factor / 100;
+		mem_i = ((unsigned int)((u64)fit_data->L1_mem_fit[i] * avf_l1 >> 10)
+				+ fit_data->L2_mem_fit) * location_factor / 100;
+		if (core_rate >= core_i && mem_rate >= mem_i)
+			return 4 - i;
+	}
+	return 0;
+}
+
+/*
+ * Targets from fit_data, full vulnerability and an empty bank. The
+ * first cycle is opened by the caller.
+ */
+void re_core_budget_init(struct re_core_budget *budget,
+			const struct cpufreq_re_fit_data *fit_data,
+			unsigned int target_factor)
+{
+	memset(budget, 0, sizeof(*budget));
+	re_core_fit_targets(fit_data, target_factor, &budget->core_fit_target,
+			&budget->mem_fit_target);
+	budget->avf_core = 1024;
+	budget->avf_l1 = 1024;
+}
+
+/*
+ * Open a cycle of len usec at now: the targets of the cycle plus the
+ * bank on top of the accumulators as they are.
+ */
+void re_core_budget_open(struct re_core_budget *budget,
+			const struct re_core_acc *acc, unsigned int len,
+			unsigned long long now)
+{
+	budget->stop_time = now + len;
+	budget->target_core_fit_acc = acc->core_fit_acc
+			+ (u64)budget->core_fit_target * len
+			+ budget->core_fit_bank;
+	budget->target_mem_fit_acc = acc->mem_fit_acc
+			+ (u64)budget->mem_fit_target * len
+			+ budget->mem_fit_bank;
+}
+
+// the running cycle has used more than it was given
+int re_core_budget_overflow(const struct re_core_budget *budget,
+			const struct re_core_acc *acc)
+{
+	return budget->target_core_fit_acc < acc->core_fit_acc ||
+		budget->target_mem_fit_acc < acc->mem_fit_acc;
+}
+
+/*
+ * Close the running cycle: its balance goes to the bank, see
+ * re_core_bank_close(). The next one is opened by the caller.
+ */
+void re_core_budget_close(struct re_core_budget *budget,
+			const struct re_core_acc *acc, unsigned int len,
+			int bank_cap)
+{
+	budget->core_fit_bank = re_core_bank_close(
+			(s64)(budget->target_core_fit_acc - acc->core_fit_acc),
+			(u64)budget->core_fit_target * len, bank_cap);
+	budget->mem_fit_bank = re_core_bank_close(
+			(s64)(budget->target_mem_fit_acc - acc->mem_fit_acc),
+			(u64)budget->mem_fit_target * len, bank_cap);
+}
+
+// FIT rates left for the rest of the running cycle
+void re_core_budget_rates(const struct re_core_budget *budget,
+			const struct re_core_acc *acc, unsigned long long now,
+			unsigned int *core_rate, unsigned int *mem_rate)
+{
+	*core_rate = re_core_remaining_rate(budget->target_core_fit_acc,
+			acc->core_fit_acc, budget->stop_time, now);
+	*mem_rate = re_core_remaining_rate(budget->target_mem_fit_acc,
+			acc->mem_fit_acc, budget->stop_time, now);
+}
+
+// re_core_fit_floor() with the vulnerability factors of budget
+int re_core_budget_floor(const struct re_core_budget *budget,
+			const struct cpufreq_re_fit_data *fit_data,
+			unsigned int location_factor, unsigned int core_rate,
+			unsigned int mem_rate)
+{
+	return re_core_fit_floor(fit_data, location_factor, budget->avf_core,
+			budget->avf_l1, core_rate, mem_rate);
+}
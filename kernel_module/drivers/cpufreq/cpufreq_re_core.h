@@ -0,0 +1,116 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_core.h
+ *
+ * cpufreq_re_core.h : interface for the kernel independent part of the
+ * reliability engine: FIT / power / wear rates of an OPP, interval
+ * accounting, the control cycle budget and the threshold rule.
+ * cpufreq_re_stats is the kernel glue around it; tools/jit-rfts builds
+ * the same sources for userspace on top of re_host.h.
+ *
+ */
+
+#ifndef _CPUFREQ_RE_CORE_H
+#define _CPUFREQ_RE_CORE_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include "re_host.h"
+#endif
+
+#include "cpufreq_re_fit_data.h"
+
+#define RE_CORE_OPPS 5		// fit_data entries, 0 = 1GHz .. 4 = 300MHz
+#define RE_CORE_IDLE_STATES 4	// C0 (incl. WFI), C1, C2, C3
+
+/*
+ * Model rates at one OPP. FIT rates are scaled by location_factor,
+ * power and wear are not.
+ */
+struct re_core_rates {
+	unsigned int cur_core_fit;
+	unsigned int cur_mem_fit;
+	unsigned int cur_l1_fit;		// L1 part of cur_mem_fit
+	unsigned int cpuidle_c1_fit;
+	unsigned int cpuidle_c2_fit;
+	unsigned int cpuidle_mem_ret_fit;
+	unsigned int cur_core_pow;
+	unsigned int cur_mem_pow;
+	unsigned int cur_mem_pow_l2_ret;
+	unsigned int cpuidle_c1_pow;
+	unsigned int cpuidle_mem_ret_pow;
+	unsigned int cur_wear;			// aging stress rates, see fit_data
+	unsigned int cpuidle_c1_wear;
+	unsigned int cpuidle_ret_wear;
+};
+
+struct re_core_acc {
+	u64 core_fit_acc;
+	u64 mem_fit_acc;
+	u64 core_pow_acc;
+	u64 mem_pow_acc;
+	u64 wear_acc;				// aging stress over the whole life
+};
+
+/*
+ * Budget of a cpu: per cycle targets, the C0 vulnerability factors the
+ * floor is computed with, and the running control cycle.
+ */
+struct re_core_budget {
+	unsigned int core_fit_target;		// per usec
+	unsigned int mem_fit_target;
+	unsigned int avf_core;			// 1/1024, 1024 without PMU
+	unsigned int avf_l1;
+	unsigned long long stop_time;		// end of the cycle, usec
+	u64 target_core_fit_acc;		// accumulators allowed by then
+	u64 target_mem_fit_acc;
+	s64 core_fit_bank;			// carried into this cycle
+	s64 mem_fit_bank;
+};
+
+extern const unsigned int re_opp_khz[RE_CORE_OPPS];
+
+int re_core_opp_index(unsigned int khz);
+void re_core_rates(const struct cpufreq_re_fit_data *fit_data, int index,
+			unsigned int location_factor,
+			struct re_core_rates *rates);
+void re_core_fit_targets(const struct cpufreq_re_fit_data *fit_data,
+			unsigned int target_factor,
+			unsigned int *core_fit_target,
+			unsigned int *mem_fit_target);
+unsigned int re_core_idle_fit(const struct re_core_rates *rates, int state);
+void re_core_account(struct re_core_acc *acc,
+			const struct re_core_rates *rates,
+			const int idle_time[RE_CORE_IDLE_STATES],
+			unsigned int c0_core_fit, unsigned int c0_mem_fit);
+s64 re_core_bank_close(s64 balance, u64 cycle_budget, int bank_cap);
+unsigned int re_core_remaining_rate(u64 target_acc, u64 acc,
+			unsigned long long budget_stop_time,
+			unsigned long long cur_wall_time);
+int re_core_c_ceiling(unsigned int core_fit_rate, unsigned int mem_fit_rate,
+			unsigned int c2_fit, unsigned int mem_ret_fit);
+int re_core_fit_floor(const struct cpufreq_re_fit_data *fit_data,
+			unsigned int location_factor, unsigned int avf_core,
+			unsigned int avf_l1, unsigned int core_rate,
+			unsigned int mem_rate);
+
+void re_core_budget_init(struct re_core_budget *budget,
+			const struct cpufreq_re_fit_data *fit_data,
+			unsigned int target_factor);
+void re_core_budget_open(struct re_core_budget *budget,
+			const struct re_core_acc *acc, unsigned int len,
+			unsigned long long now);
+int re_core_budget_overflow(const struct re_core_budget *budget,
+			const struct re_core_acc *acc);
+void re_core_budget_close(struct re_core_budget *budget,
+			const struct re_core_acc *acc, unsigned int len,
+			int bank_cap);
+void re_core_budget_rates(const struct re_core_budget *budget,
+			const struct re_core_acc *acc, unsigned long long now,
+			unsigned int *core_rate, unsigned int *mem_rate);
+int re_core_budget_floor(const struct re_core_budget *budget,
+			const struct cpufreq_re_fit_data *fit_data,
+			unsigned int location_factor, unsigned int core_rate,
+			unsigned int mem_rate);
+
+#endif
@@ -0,0 +1,272 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_emu.c
+ *
+ * Stand-ins for the BeagleBone Black parts JIT-RFTS depends on, so the
+ * stack runs on the QEMU vexpress-a9 machine:
+ *  - a cpuidle driver with the four states of am33xx_ddr3_states, which
+ *    busy waits the exit latency of the state after WFI returns
+ *  - a software cpu0 clock and vdd_mpu regulator that accept any rate
+ *    and voltage, and the five AM335x OPPs for cpufreq-cpu0
+ *  - wkup_m3_ping_delay() when the kernel is built without AM33XX
+ * Built with ARCH_VEXPRESS and only registered on a vexpress machine.
+ *
+ */
+
+#include <linux/clk.h>
+#include <linux/clk-provider.h>
+#include <linux/clkdev.h>
+#include <linux/cpu.h>
+#include <linux/cpuidle.h>
+#include <linux/delay.h>
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/opp.h>
+#include <linux/platform_device.h>
+#include <linux/regulator/driver.h>
+#include <linux/regulator/machine.h>
+#include <linux/sched.h>
+
+#include <asm/proc-fns.h>
+
+// % of the exit latency to busy wait after WFI, 0 = plain WFI
+static unsigned int latency_scale = 100;
+module_param(latency_scale, uint, 0644);
+
+// PLL relock time charged to every rate change, usec
+static unsigned int relock_us;
+module_param(relock_us, uint, 0644);
+
+// wkup_m3 IPC round trip, usec, and cost of one M3 loop iteration, ns
+static unsigned int m3_ping_us = 20;
+module_param(m3_ping_us, uint, 0644);
+static unsigned int m3_loop_ns = 40;
+module_param(m3_loop_ns, uint, 0644);
+
+// re_opp_khz of cpufreq_re_core.c (a copy, cpufreq_re may be a module)
+// with the AM335x vdd_mpu voltages
+static const unsigned long re_emu_opps[][2] = {
+	{ 1000000000, 1325000 },
+	{ 800000000, 1260000 },
+	{ 720000000, 1200000 },
+	{ 600000000, 1100000 },
+	{ 300000000, 950000 },
+};
+
+// exit_latency of the states below, kept apart as cpufreq_re may
+// rewrite the driver values with what it measures
+static const unsigned int re_emu_exit_us[] = { 68, 130, 530, 650 };
+
+static int re_emu_enter_idle(struct cpuidle_device *dev,
+			struct cpuidle_driver *drv, int index)
+{
+	if (need_resched())
+		return index;
+	cpu_do_idle();
+	// WFI returns at once under QEMU; the hardware would still be
+	// relocking the PLL or restoring the core here
+	if (latency_scale)
+		udelay(re_emu_exit_us[index] * latency_scale / 100);
+	return index;
+}
+
+// am33xx_ddr3_states of cpuidle33xx.c
+static struct cpuidle_driver re_emu_idle_driver = {
+	.name		= "re_emu_idle",
+	.owner		= THIS_MODULE,
+	.states		= {
+		{
+			.exit_latency = 68,
+			.target_residency = 150,
+			.power_usage = 557,
+			.flags = CPUIDLE_FLAG_TIME_VALID,
+			.enter = re_emu_enter_idle,
+			.name = "C0",
+			.desc = "WFI",
+		},
+		{
+			.exit_latency = 130,
+			.target_residency = 200,
+			.power_usage = 497,
+			.flags = CPUIDLE_FLAG_TIME_VALID,
+			.enter = re_emu_enter_idle,
+			.name = "C1",
+			.desc = "Bypass MPU PLL",
+		},
+		{
+			.exit_latency = 530,
+			.target_residency = 800,
+			.power_usage = 350,
+			.flags = CPUIDLE_FLAG_TIME_VALID,
+			.enter = re_emu_enter_idle,
+			.name = "C2",
+			.desc = "C1 + core power gating",
+		},
+		{
+			.exit_latency = 650,
+			.target_residency = 1000,
+			.power_usage = 250,
+			.flags = CPUIDLE_FLAG_TIME_VALID,
+			.enter = re_emu_enter_idle,
+			.name = "C3",
+			.desc = "C2 + MEM ret",
+		},
+	},
+	.state_count	= 4,
+};
+
+struct re_emu_clk {
+	struct clk_hw hw;
+	unsigned long rate;
+};
+
+static struct re_emu_clk re_emu_mpu_clk = {
+	.rate = 1000 * 1000 * 1000,
+};
+
+static unsigned long re_emu_clk_recalc_rate(struct clk_hw *hw,
+			unsigned long parent_rate)
+{
+	return container_of(hw, struct re_emu_clk, hw)->rate;
+}
+
+static long re_emu_clk_round_rate(struct clk_hw *hw, unsigned long rate,
+			unsigned long *parent_rate)
+{
+	return rate;
+}
+
+static int re_emu_clk_set_rate(struct clk_hw *hw, unsigned long rate,
+			unsigned long parent_rate)
+{
+	container_of(hw, struct re_emu_clk, hw)->rate = rate;
+	if (relock_us)
+		udelay(relock_us);
+	return 0;
+}
+
+static const struct clk_ops re_emu_clk_ops = {
+	.recalc_rate = re_emu_clk_recalc_rate,
+	.round_rate = re_emu_clk_round_rate,
+	.set_rate = re_emu_clk_set_rate,
+};
+
+static int re_emu_vdd_uV = 1325000;
+
+static int re_emu_set_voltage(struct regulator_dev *rdev, int min_uV,
+			int max_uV, unsigned *selector)
+{
+	re_emu_vdd_uV = min_uV;
+	return 0;
+}
+
+static int re_emu_get_voltage(struct regulator_dev *rdev)
+{
+	return re_emu_vdd_uV;
+}
+
+static struct regulator_ops re_emu_vdd_ops = {
+	.set_voltage = re_emu_set_voltage,
+	.get_voltage = re_emu_get_voltage,
+};
+
+static const struct regulator_desc re_emu_vdd_desc = {
+	.name = "re_emu_vdd_mpu",
+	.ops = &re_emu_vdd_ops,
+	.type = REGULATOR_VOLTAGE,
+	.owner = THIS_MODULE,
+};
+
+static struct regulator_consumer_supply re_emu_vdd_supply =
+	REGULATOR_SUPPLY("cpu0", "cpu0");
+
+static struct regulator_init_data re_emu_vdd_data = {
+	.constraints = {
+		.name = "vdd_mpu",
+		.min_uV = 900000,
+		.max_uV = 1400000,
+		.valid_ops_mask = REGULATOR_CHANGE_VOLTAGE,
+		.always_on = 1,
+	},
+	.num_consumer_supplies = 1,
+	.consumer_supplies = &re_emu_vdd_supply,
+};
+
+#ifndef CONFIG_SOC_AM33XX
+/*
+ * cpufreq_re_stats times the M3 IPC through this; here it is a busy
+ * wait of the round trip plus the requested M3 loop.
+ */
+int wkup_m3_ping_delay(int iteration)
+{
+	ktime_t time_start = ktime_get();
+
+	udelay(m3_ping_us);
+	ndelay(iteration * m3_loop_ns);
+	return (int)ktime_to_us(ktime_sub(ktime_get(), time_start));
+}
+EXPORT_SYMBOL_GPL(wkup_m3_ping_delay);
+#endif
+
+static int __init re_emu_dvfs_init(void)
+{
+	struct clk_init_data init = {
+		.name = "re_emu_mpu",
+		.ops = &re_emu_clk_ops,
+		.flags = CLK_IS_ROOT,
+	};
+	struct regulator_config config = { };
+	struct platform_device *pdev;
+	struct regulator_dev *rdev;
+	struct device *cpu_dev;
+	struct clk *clk;
+	int i, ret;
+
+	cpu_dev = get_cpu_device(0);
+	if (!cpu_dev)
+		return -ENODEV;
+
+	re_emu_mpu_clk.hw.init = &init;
+	clk = clk_register(NULL, &re_emu_mpu_clk.hw);
+	if (IS_ERR(clk))
+		return PTR_ERR(clk);
+	ret = clk_register_clkdev(clk, NULL, dev_name(cpu_dev));
+	if (ret)
+		return ret;
+
+	pdev = platform_device_register_simple("re_emu_vdd", -1, NULL, 0);
+	if (IS_ERR(pdev))
+		return PTR_ERR(pdev);
+	config.dev = &pdev->dev;
+	config.init_data = &re_emu_vdd_data;
+	rdev = regulator_register(&re_emu_vdd_desc, &config);
+	if (IS_ERR(rdev))
+		return PTR_ERR(rdev);
+
+	for (i = 0; i < ARRAY_SIZE(re_emu_opps); i++) {
+		ret = opp_add(cpu_dev, re_emu_opps[i][0], re_emu_opps[i][1]);
+		if (ret)
+			return ret;
+	}
+	pdev = platform_device_register_simple("cpufreq-cpu0", -1, NULL, 0);
+	return IS_ERR(pdev) ? PTR_ERR(pdev) : 0;
+}
+
+static int __init re_emu_init(void)
+{
+	int ret;
+
+	if (!of_machine_is_compatible("arm,vexpress"))
+		return 0;
+	ret = cpuidle_register(&re_emu_idle_driver, NULL);
+	if (ret)
+		pr_err("re_emu: cpuidle driver not registered: %d\n", ret);
+	ret = re_emu_dvfs_init();
+	if (ret)
+		pr_err("re_emu: cpufreq stand-ins not registered: %d\n", ret);
+	return 0;
+}
+late_initcall(re_emu_init);
@@ -10,11 +10,22 @@
 #include "cpufreq_re_fit_data.h"
 
 // Select the targeting hardware configuration cases
-// here
+// here, or with -DRE_FIT_CASE=n (tools/jit-rfts builds all four)
+#ifndef RE_FIT_CASE
+#define RE_FIT_CASE 1
+#endif
+
+#if RE_FIT_CASE == 1
 #define CASE1
-//#define CASE2
-//#define CASE3
-//#define CASE4
+#elif RE_FIT_CASE == 2
+#define CASE2
+#elif RE_FIT_CASE == 3
+#define CASE3
+#elif RE_FIT_CASE == 4
+#define CASE4
+#else
+#error "RE_FIT_CASE must be 1 to 4"
+#endif
 
 #ifdef CASE1
 //#define L1_ECC        // L1 with ECC or not
@@ -61,6 +72,13 @@ void import_fit_data(struct cpufreq_re_fit_data *fit_data,
 	unsigned int SRAM_cell_base_fit[5] = {500, 545, 650, 745, 859};
 	unsigned int SRAM_cell_ret_fit[5] = {2000, 2180, 2600, 2980, 3436};
 	unsigned int FF_cell_base_fit[5] = {153, 167, 199, 228, 263};
+
+	// Aging stress, 1000 -> OPP100 (600MHz, 1.10V) in C0.
+	// Voltage acceleration exp(10 * (V - 1.10)) at 1.325/1.26/1.20/1.10/0.95V,
+	// 60% NBTI (voltage only) and 40% HCI/EM (scales with frequency)
+	unsigned int WEAR_base[5] = {12018, 5613, 2935, 1000, 178};
+	unsigned int WEAR_c1_base[5] = {5693, 2972, 1631, 600, 134};
+	unsigned int WEAR_ret = 20;
 #ifdef RET_FLOP
 	unsigned int RET_LATCH_base_fit = 500;
 #endif
@@ -97,6 +115,8 @@ void import_fit_data(struct cpufreq_re_fit_data *fit_data,
 		fit_data->L2_mem_pow_ret = 8 * l2_base_ret_pointer[0];
 	        fit_data->core_pow[i] = CORE_base[i];
 	        fit_data->core_pow_c1[i] = CORE_c1_base[i];
+		fit_data->wear_rate[i] = WEAR_base[i];
+		fit_data->wear_rate_c1[i] = WEAR_c1_base[i];
 
 		// SER part
 	        fit_data->core_fit[i] = FF_COUNT * FF_cell_base_fit[i]/ NORM_FACTOR;
@@ -129,5 +149,6 @@ void import_fit_data(struct cpufreq_re_fit_data *fit_data,
 #endif
 	fit_data->core_pow_c2 = CORE_c2; 
 	fit_data->core_pow_c3 = CORE_c3;
+	fit_data->wear_rate_ret = WEAR_ret;
 	return;
 }
@@ -30,6 +30,9 @@ struct cpufreq_re_fit_data {
         unsigned int L1_mem_pow_ret[5];
         unsigned int L2_mem_pow;
         unsigned int L2_mem_pow_ret;
+        unsigned int wear_rate[5];	// aging stress in C0
+        unsigned int wear_rate_c1[5];	// clock gated, voltage still applied
+        unsigned int wear_rate_ret;	// C2/C3 retention
 };
 
 void import_fit_data(struct cpufreq_re_fit_data *fit_data, unsigned int cpu);
@@ -0,0 +1,348 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_governor.c
+ *
+ * "reliability" cpufreq governor. Ondemand style load sampling on top
+ * of the common dbs code, with the cpufreq_re_stats P-state floor (FIT
+ * budget) and ceiling (energy cap) folded into the frequency choice, so
+ * the driver never has to override the governor.
+ *
+ */
+
+#include <linux/cpufreq.h>
+#include <linux/cpufreq_re.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/kernel_stat.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/percpu-defs.h>
+#include <linux/slab.h>
+#include <linux/tick.h>
+
+#include "cpufreq_governor.h"
+
+#define DEF_FREQUENCY_UP_THRESHOLD		(80)
+#define DEF_SAMPLING_DOWN_FACTOR		(1)
+#define MAX_SAMPLING_DOWN_FACTOR		(100000)
+#define MICRO_FREQUENCY_UP_THRESHOLD		(95)
+#define MICRO_FREQUENCY_MIN_SAMPLE_RATE		(10000)
+#define MIN_FREQUENCY_UP_THRESHOLD		(11)
+#define MAX_FREQUENCY_UP_THRESHOLD		(100)
+#define TRANSITION_LATENCY_LIMIT		(10 * 1000 * 1000)
+
+static DEFINE_PER_CPU(struct od_cpu_dbs_info_s, re_cpu_dbs_info);
+
+static struct cpufreq_governor cpufreq_gov_reliability;
+
+/*
+ * Frequency of a cpufreq_re P-state index, i.e. an index into the
+ * ascending frequency table the floor and ceiling are expressed in.
+ */
+static unsigned int re_index_freq(struct cpufreq_frequency_table *table,
+			int index)
+{
+	int i;
+
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++)
+		if (i == index)
+			return table[i].frequency;
+	return 0;
+}
+
+static int re_freq_index(struct cpufreq_policy *policy,
+			struct cpufreq_frequency_table *table, unsigned int freq)
+{
+	unsigned int index = 0;
+
+	if (cpufreq_frequency_table_target(policy, table, freq,
+				CPUFREQ_RELATION_L, &index))
+		return 0;
+	return index;
+}
+
+/*
+ * Every sampling_rate, load is mapped to a frequency as ondemand does
+ * (max above up_threshold, proportional below) and then limited to the
+ * reliability floor and the energy cap. The floor wins only over the
+ * load based choice, the cap wins over everything.
+ */
+static void re_check_cpu(int cpu, unsigned int load)
+{
+	struct od_cpu_dbs_info_s *dbs_info = &per_cpu(re_cpu_dbs_info, cpu);
+	struct cpufreq_policy *policy = dbs_info->cdbs.cur_policy;
+	struct dbs_data *dbs_data = policy->governor_data;
+	struct od_dbs_tuners *re_tuners = dbs_data->tuners;
+	unsigned int freq_next, freq_floor, freq_ceiling;
+	int floor, ceiling;
+
+	dbs_info->freq_lo = 0;
+
+	if (load > re_tuners->up_threshold) {
+		/* If switching to max speed, apply sampling_down_factor */
+		if (policy->cur < policy->max)
+			dbs_info->rate_mult = re_tuners->sampling_down_factor;
+		freq_next = policy->max;
+	} else {
+		/* No longer fully busy, reset rate_mult */
+		dbs_info->rate_mult = 1;
+		freq_next = load * policy->cpuinfo.max_freq / 100;
+		if (freq_next < policy->min)
+			freq_next = policy->min;
+	}
+
+	if (!dbs_info->freq_table)
+		goto target;
+
+	floor = cpufreq_re_hook_get_P_states(cpu);
+	ceiling = cpufreq_re_hook_get_P_ceiling(cpu);
+	cpufreq_re_hook_report_P_states(floor,
+			re_freq_index(policy, dbs_info->freq_table, freq_next));
+
+	freq_floor = re_index_freq(dbs_info->freq_table, floor);
+	if (freq_next < freq_floor) {
+		freq_next = freq_floor;
+		// budget forces the ramp, no need to wait for load
+		if (policy->cur < freq_floor)
+			dbs_info->rate_mult = 1;
+	}
+	if (ceiling != INT_MAX) {
+		freq_ceiling = re_index_freq(dbs_info->freq_table, ceiling);
+		if (freq_ceiling && freq_next > freq_ceiling)
+			freq_next = freq_ceiling;
+	}
+
+target:
+	// nothing left for the driver to override, skip no-op requests
+	if (freq_next == policy->cur)
+		return;
+	__cpufreq_driver_target(policy, freq_next, CPUFREQ_RELATION_L);
+}
+
+static void re_dbs_timer(struct work_struct *work)
+{
+	struct od_cpu_dbs_info_s *dbs_info =
+		container_of(work, struct od_cpu_dbs_info_s, cdbs.work.work);
+	unsigned int cpu = dbs_info->cdbs.cur_policy->cpu;
+	struct od_cpu_dbs_info_s *core_dbs_info = &per_cpu(re_cpu_dbs_info,
+			cpu);
+	struct dbs_data *dbs_data = dbs_info->cdbs.cur_policy->governor_data;
+	struct od_dbs_tuners *re_tuners = dbs_data->tuners;
+	bool modify_all = true;
+
+	mutex_lock(&core_dbs_info->cdbs.timer_mutex);
+	if (!need_load_eval(&core_dbs_info->cdbs, re_tuners->sampling_rate))
+		modify_all = false;
+	else
+		dbs_check_cpu(dbs_data, cpu);
+
+	gov_queue_work(dbs_data, dbs_info->cdbs.cur_policy,
+			delay_for_sampling_rate(re_tuners->sampling_rate
+				* core_dbs_info->rate_mult), modify_all);
+	mutex_unlock(&core_dbs_info->cdbs.timer_mutex);
+}
+
+/************************** sysfs interface ************************/
+/*
+ * Named like ondemand's, the show/store macros expect _gov##_dbs_cdata
+ * and _gov##_dbs_tuners. It is a separate instance though, so
+ * gdbs_data, the tunables and the sysfs group are our own.
+ */
+static struct common_dbs_data od_dbs_cdata;
+
+static ssize_t store_sampling_rate(struct dbs_data *dbs_data, const char *buf,
+		size_t count)
+{
+	struct od_dbs_tuners *re_tuners = dbs_data->tuners;
+	unsigned int input;
+	int ret;
+
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1)
+		return -EINVAL;
+
+	re_tuners->sampling_rate = max(input, dbs_data->min_sampling_rate);
+	return count;
+}
+
+static ssize_t store_up_threshold(struct dbs_data *dbs_data, const char *buf,
+		size_t count)
+{
+	struct od_dbs_tuners *re_tuners = dbs_data->tuners;
+	unsigned int input;
+	int ret;
+
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1 || input > MAX_FREQUENCY_UP_THRESHOLD ||
+			input < MIN_FREQUENCY_UP_THRESHOLD)
+		return -EINVAL;
+
+	re_tuners->up_threshold = input;
+	return count;
+}
+
+static ssize_t store_sampling_down_factor(struct dbs_data *dbs_data,
+		const char *buf, size_t count)
+{
+	struct od_dbs_tuners *re_tuners = dbs_data->tuners;
+	unsigned int input;
+	int ret;
+
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1 || input > MAX_SAMPLING_DOWN_FACTOR || input < 1)
+		return -EINVAL;
+
+	re_tuners->sampling_down_factor = input;
+	return count;
+}
+
+show_store_one(od, sampling_rate);
+show_store_one(od, up_threshold);
+show_store_one(od, sampling_down_factor);
+declare_show_sampling_rate_min(od);
+
+gov_sys_pol_attr_rw(sampling_rate);
+gov_sys_pol_attr_rw(up_threshold);
+gov_sys_pol_attr_rw(sampling_down_factor);
+gov_sys_pol_attr_ro(sampling_rate_min);
+
+static struct attribute *re_attributes_gov_sys[] = {
+	&sampling_rate_min_gov_sys.attr,
+	&sampling_rate_gov_sys.attr,
+	&up_threshold_gov_sys.attr,
+	&sampling_down_factor_gov_sys.attr,
+	NULL
+};
+
+static struct attribute_group re_attr_group_gov_sys = {
+	.attrs = re_attributes_gov_sys,
+	.name = "reliability",
+};
+
+static struct attribute *re_attributes_gov_pol[] = {
+	&sampling_rate_min_gov_pol.attr,
+	&sampling_rate_gov_pol.attr,
+	&up_threshold_gov_pol.attr,
+	&sampling_down_factor_gov_pol.attr,
+	NULL
+};
+
+static struct attribute_group re_attr_group_gov_pol = {
+	.attrs = re_attributes_gov_pol,
+	.name = "reliability",
+};
+
+/************************** sysfs end ************************/
+
+static int re_init(struct dbs_data *dbs_data)
+{
+	struct od_dbs_tuners *tuners;
+	u64 idle_time;
+	int cpu;
+
+	tuners = kzalloc(sizeof(*tuners), GFP_KERNEL);
+	if (!tuners) {
+		pr_err("%s: kzalloc failed\n", __func__);
+		return -ENOMEM;
+	}
+
+	cpu = get_cpu();
+	idle_time = get_cpu_idle_time_us(cpu, NULL);
+	put_cpu();
+	if (idle_time != -1ULL) {
+		/* Idle micro accounting is supported. Use finer thresholds */
+		tuners->up_threshold = MICRO_FREQUENCY_UP_THRESHOLD;
+		dbs_data->min_sampling_rate = MICRO_FREQUENCY_MIN_SAMPLE_RATE;
+	} else {
+		tuners->up_threshold = DEF_FREQUENCY_UP_THRESHOLD;
+		dbs_data->min_sampling_rate = MIN_SAMPLING_RATE_RATIO *
+			jiffies_to_usecs(10);
+	}
+
+	tuners->sampling_down_factor = DEF_SAMPLING_DOWN_FACTOR;
+	// read by the GOV_ONDEMAND paths of dbs_check_cpu() and GOV_START
+	tuners->ignore_nice_load = 0;
+	tuners->powersave_bias = 0;
+	tuners->io_is_busy = 0;
+
+	dbs_data->tuners = tuners;
+	mutex_init(&dbs_data->mutex);
+	return 0;
+}
+
+static void re_exit(struct dbs_data *dbs_data)
+{
+	kfree(dbs_data->tuners);
+}
+
+define_get_cpu_dbs_routines(re_cpu_dbs_info);
+
+/*
+ * The common code treats us as ondemand (GOV_ONDEMAND): the governor
+ * type only picks the od_dbs_tuners/od_cpu_dbs_info_s layout, which
+ * re_init() and this fill completely, and the od_ops called on
+ * GOV_START. Nothing in cpufreq_governor.c compares against the
+ * ondemand governor itself. There is no powersave_bias, only the table
+ * is needed.
+ */
+static void re_init_cpu(int cpu)
+{
+	struct od_cpu_dbs_info_s *dbs_info = &per_cpu(re_cpu_dbs_info, cpu);
+
+	dbs_info->freq_table = cpufreq_frequency_get_table(cpu);
+	dbs_info->freq_lo = 0;
+}
+
+static unsigned int re_bias_target(struct cpufreq_policy *policy,
+		unsigned int freq_next, unsigned int relation)
+{
+	return freq_next;
+}
+
+static struct od_ops re_ops = {
+	.powersave_bias_init_cpu = re_init_cpu,
+	.powersave_bias_target = re_bias_target,
+	.freq_increase = NULL,
+};
+
+static struct common_dbs_data od_dbs_cdata = {
+	.governor = GOV_ONDEMAND,
+	.attr_group_gov_sys = &re_attr_group_gov_sys,
+	.attr_group_gov_pol = &re_attr_group_gov_pol,
+	.get_cpu_cdbs = get_cpu_cdbs,
+	.get_cpu_dbs_info_s = get_cpu_dbs_info_s,
+	.gov_dbs_timer = re_dbs_timer,
+	.gov_check_cpu = re_check_cpu,
+	.gov_ops = &re_ops,
+	.init = re_init,
+	.exit = re_exit,
+};
+
+static int re_cpufreq_governor_dbs(struct cpufreq_policy *policy,
+		unsigned int event)
+{
+	return cpufreq_governor_dbs(policy, &od_dbs_cdata, event);
+}
+
+static struct cpufreq_governor cpufreq_gov_reliability = {
+	.name			= "reliability",
+	.governor		= re_cpufreq_governor_dbs,
+	.max_transition_latency	= TRANSITION_LATENCY_LIMIT,
+	.owner			= THIS_MODULE,
+};
+
+static int __init cpufreq_gov_re_init(void)
+{
+	return cpufreq_register_governor(&cpufreq_gov_reliability);
+}
+
+static void __exit cpufreq_gov_re_exit(void)
+{
+	cpufreq_unregister_governor(&cpufreq_gov_reliability);
+}
+
+MODULE_DESCRIPTION("'cpufreq_reliability' - ondemand style governor "
+	"bounded by the cpufreq_re_stats FIT budget and energy cap");
+MODULE_LICENSE("GPL");
+
+fs_initcall(cpufreq_gov_re_init);
+module_exit(cpufreq_gov_re_exit);
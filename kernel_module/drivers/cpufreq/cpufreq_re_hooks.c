@@ -0,0 +1,62 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_hooks.c
+ *
+ * Hook registry between the built-in cpuidle / cpufreq paths and the
+ * reliability engine, so cpufreq_re_stats can be built as a module.
+ * Only one engine can be registered at a time.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/smp.h>
+#include <linux/rcupdate.h>
+#include <linux/cpufreq_re.h>
+
+struct static_key cpufreq_re_hooks_key = STATIC_KEY_INIT_FALSE;
+EXPORT_SYMBOL_GPL(cpufreq_re_hooks_key);
+
+const struct cpufreq_re_hooks *cpufreq_re_hooks __read_mostly;
+EXPORT_SYMBOL_GPL(cpufreq_re_hooks);
+
+static DEFINE_MUTEX(cpufreq_re_hooks_lock);
+
+int cpufreq_re_register_hooks(const struct cpufreq_re_hooks *hooks)
+{
+	int ret = 0;
+
+	mutex_lock(&cpufreq_re_hooks_lock);
+	if (cpufreq_re_hooks) {
+		ret = -EBUSY;
+		goto out;
+	}
+	cpufreq_re_hooks = hooks;
+	// the pointer must be visible before the branches are patched in
+	smp_wmb();
+	static_key_slow_inc(&cpufreq_re_hooks_key);
+out:
+	mutex_unlock(&cpufreq_re_hooks_lock);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(cpufreq_re_register_hooks);
+
+/*
+ * After this returns no cpu runs a hook any more and the engine can be
+ * freed. Idle cpus are outside of RCU, so like
+ * cpuidle_uninstall_idle_handler() they are kicked out of the idle
+ * path as well.
+ */
+void cpufreq_re_unregister_hooks(const struct cpufreq_re_hooks *hooks)
+{
+	mutex_lock(&cpufreq_re_hooks_lock);
+	if (cpufreq_re_hooks != hooks)
+		goto out;
+	static_key_slow_dec(&cpufreq_re_hooks_key);
+	kick_all_cpus_sync();
+	synchronize_sched();
+	cpufreq_re_hooks = NULL;
+out:
+	mutex_unlock(&cpufreq_re_hooks_lock);
+}
+EXPORT_SYMBOL_GPL(cpufreq_re_unregister_hooks);
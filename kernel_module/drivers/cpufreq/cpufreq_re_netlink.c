@@ -0,0 +1,152 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_netlink.c
+ *
+ * Generic netlink event channel for cpufreq_re_stats.
+ *
+ * Events are raised from the cpuidle and cpufreq paths, so they are
+ * only queued here and the multicast is done from a work item.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/kfifo.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <net/genetlink.h>
+
+#include "cpufreq_re_netlink.h"
+
+#define EVENT_FIFO_LENGTH 16
+
+static DEFINE_KFIFO(cpufreq_re_event_fifo, struct cpufreq_re_event,
+			EVENT_FIFO_LENGTH);
+static DEFINE_SPINLOCK(cpufreq_re_event_lock);
+static unsigned int cpufreq_re_event_dropped;
+static int cpufreq_re_genl_registered;
+
+static struct genl_family cpufreq_re_genl_family = {
+	.id = GENL_ID_GENERATE,
+	.hdrsize = 0,
+	.name = CPUFREQ_RE_GENL_NAME,
+	.version = CPUFREQ_RE_GENL_VERSION,
+	.maxattr = CPUFREQ_RE_A_MAX,
+};
+
+static struct genl_multicast_group cpufreq_re_genl_mcgrp = {
+	.name = CPUFREQ_RE_GENL_MCGRP_NAME,
+};
+
+static int cpufreq_re_event_send(const struct cpufreq_re_event *event,
+				unsigned int dropped)
+{
+	struct sk_buff *skb;
+	void *hdr;
+
+	skb = genlmsg_new(NLMSG_GOODSIZE, GFP_KERNEL);
+	if (!skb)
+		return -ENOMEM;
+
+	hdr = genlmsg_put(skb, 0, 0, &cpufreq_re_genl_family, 0,
+				CPUFREQ_RE_CMD_EVENT);
+	if (!hdr)
+		goto nla_put_failure;
+
+	if (nla_put_u32(skb, CPUFREQ_RE_A_TYPE, event->type) ||
+	    nla_put_u32(skb, CPUFREQ_RE_A_CPU, event->cpu) ||
+	    nla_put_u32(skb, CPUFREQ_RE_A_EPOCH, event->epoch) ||
+	    nla_put_u64(skb, CPUFREQ_RE_A_TIME, event->time) ||
+	    nla_put_u64(skb, CPUFREQ_RE_A_CORE_FIT, event->core_fit) ||
+	    nla_put_u64(skb, CPUFREQ_RE_A_MEM_FIT, event->mem_fit) ||
+	    nla_put_u64(skb, CPUFREQ_RE_A_CORE_ENERGY, event->core_energy) ||
+	    nla_put_u64(skb, CPUFREQ_RE_A_MEM_ENERGY, event->mem_energy) ||
+	    nla_put_u64(skb, CPUFREQ_RE_A_CORE_BALANCE, (u64)event->core_balance) ||
+	    nla_put_u64(skb, CPUFREQ_RE_A_MEM_BALANCE, (u64)event->mem_balance) ||
+	    nla_put_u64(skb, CPUFREQ_RE_A_CORE_BANK, (u64)event->core_bank) ||
+	    nla_put_u64(skb, CPUFREQ_RE_A_MEM_BANK, (u64)event->mem_bank) ||
+	    nla_put_u32(skb, CPUFREQ_RE_A_C_STATE, event->c_state) ||
+	    nla_put_u32(skb, CPUFREQ_RE_A_P_STATE, event->p_state) ||
+	    nla_put_u32(skb, CPUFREQ_RE_A_DROPPED, dropped))
+		goto nla_put_failure;
+
+	genlmsg_end(skb, hdr);
+	// -ESRCH only means nobody is listening
+	genlmsg_multicast(skb, 0, cpufreq_re_genl_mcgrp.id, GFP_KERNEL);
+	return 0;
+
+nla_put_failure:
+	nlmsg_free(skb);
+	return -EMSGSIZE;
+}
+
+static void cpufreq_re_event_work_fn(struct work_struct *work)
+{
+	struct cpufreq_re_event event;
+	unsigned long flags;
+	unsigned int dropped;
+
+	while (kfifo_out_spinlocked(&cpufreq_re_event_fifo, &event, 1,
+				&cpufreq_re_event_lock)) {
+		spin_lock_irqsave(&cpufreq_re_event_lock, flags);
+		dropped = cpufreq_re_event_dropped;
+		cpufreq_re_event_dropped = 0;
+		spin_unlock_irqrestore(&cpufreq_re_event_lock, flags);
+		cpufreq_re_event_send(&event, dropped);
+	}
+}
+
+static DECLARE_WORK(cpufreq_re_event_work, cpufreq_re_event_work_fn);
+
+/*
+ * Queue an event for multicast. Safe to call with interrupts disabled
+ * (idle path); events are dropped and counted when the fifo is full.
+ */
+void cpufreq_re_netlink_notify(const struct cpufreq_re_event *event)
+{
+	unsigned long flags;
+
+	// under the lock, so nothing is queued once exit cleared the flag
+	spin_lock_irqsave(&cpufreq_re_event_lock, flags);
+	if (cpufreq_re_genl_registered) {
+		if (!kfifo_in(&cpufreq_re_event_fifo, event, 1))
+			cpufreq_re_event_dropped++;
+		schedule_work(&cpufreq_re_event_work);
+	}
+	spin_unlock_irqrestore(&cpufreq_re_event_lock, flags);
+}
+
+int cpufreq_re_netlink_init(void)
+{
+	int ret;
+
+	ret = genl_register_family(&cpufreq_re_genl_family);
+	if (ret)
+		return ret;
+
+	ret = genl_register_mc_group(&cpufreq_re_genl_family,
+				&cpufreq_re_genl_mcgrp);
+	if (ret) {
+		genl_unregister_family(&cpufreq_re_genl_family);
+		return ret;
+	}
+	cpufreq_re_genl_registered = 1;
+	return 0;
+}
+
+/*
+ * The producers are stopped first, then the work is drained before the
+ * family goes away.
+ */
+void cpufreq_re_netlink_exit(void)
+{
+	unsigned long flags;
+	int registered;
+
+	spin_lock_irqsave(&cpufreq_re_event_lock, flags);
+	registered = cpufreq_re_genl_registered;
+	cpufreq_re_genl_registered = 0;
+	spin_unlock_irqrestore(&cpufreq_re_event_lock, flags);
+	if (!registered)
+		return;
+	cancel_work_sync(&cpufreq_re_event_work);
+	genl_unregister_family(&cpufreq_re_genl_family);
+}
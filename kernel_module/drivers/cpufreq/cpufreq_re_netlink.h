@@ -0,0 +1,42 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_netlink.h
+ *
+ * cpufreq_re_netlink.h : interface for pushing budget events
+ * of cpufreq_re_stats to user space through generic netlink
+ *
+ */
+
+#ifndef _CPUFREQ_RE_NETLINK_H
+#define _CPUFREQ_RE_NETLINK_H
+
+#include <linux/types.h>
+#include <linux/cpufreq_re_genl.h>
+
+struct cpufreq_re_event {
+	unsigned int type;
+	unsigned int cpu;
+	unsigned int epoch;
+	u64 time;
+	u64 core_fit;
+	u64 mem_fit;
+	u64 core_energy;
+	u64 mem_energy;
+	s64 core_balance;
+	s64 mem_balance;
+	s64 core_bank;
+	s64 mem_bank;
+	int c_state;
+	int p_state;
+};
+
+#ifdef CONFIG_NET
+int cpufreq_re_netlink_init(void);
+void cpufreq_re_netlink_exit(void);
+void cpufreq_re_netlink_notify(const struct cpufreq_re_event *event);
+#else
+static inline int cpufreq_re_netlink_init(void) { return 0; }
+static inline void cpufreq_re_netlink_exit(void) { }
+static inline void cpufreq_re_netlink_notify(const struct cpufreq_re_event *event) { }
+#endif
+
+#endif
@@ -0,0 +1,219 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_platform.c
+ *
+ * Maps the cpuidle and cpufreq driver states of a cpu onto the states
+ * of the reliability model, so cpufreq_re_stats accounts and enforces
+ * in model terms on any platform.
+ *
+ * Idle: a polling state (x86 "POLL") is busy time. The other states
+ * are ranked by exit latency and spread over the model classes, the
+ * shallowest becoming C0 (the WFI part of it) and the deepest C3. With
+ * four states, as am33xx_ddr3_states has, this is the identity.
+ *
+ * Frequency: when every entry is an OPP of re_opp_khz the fit_data
+ * index is taken as is. Otherwise an entry is placed at the OPP nearest
+ * to its share of the maximum frequency, e.g. 1.6 of 3.2 GHz at the
+ * 600 MHz point of a 1 GHz model.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "cpufreq_re_platform.h"
+
+void re_platform_map_idle(struct re_platform *plat,
+			struct cpuidle_driver *drv)
+{
+	int order[CPUIDLE_STATE_MAX];
+	int i, j, n = 0, tmp;
+
+	memset(plat->idle_class, 0, sizeof(plat->idle_class));
+	memset(plat->c_limit, 0, sizeof(plat->c_limit));
+	plat->idle_count = 0;
+	plat->idle_identity = 1;
+	if (!drv || !drv->state_count)
+		return;
+	plat->idle_count = min(drv->state_count, CPUIDLE_STATE_MAX);
+
+	for (i = 0; i < plat->idle_count; i++) {
+		if (!strncmp(drv->states[i].name, "POLL", CPUIDLE_NAME_LEN)) {
+			plat->idle_class[i] = RE_PLAT_BUSY;
+			continue;
+		}
+		order[n++] = i;
+	}
+	// by exit latency, drivers list them that way but need not
+	for (i = 1; i < n; i++)
+		for (j = i; j > 0 && drv->states[order[j]].exit_latency
+				< drv->states[order[j - 1]].exit_latency; j--) {
+			tmp = order[j];
+			order[j] = order[j - 1];
+			order[j - 1] = tmp;
+		}
+	for (i = 0; i < n; i++)
+		plat->idle_class[order[i]] = n == 1 ? 0
+			: (i * (RE_CORE_IDLE_STATES - 1) + (n - 1) / 2) / (n - 1);
+
+	for (i = 0; i < plat->idle_count; i++) {
+		if (plat->idle_class[i] != i)
+			plat->idle_identity = 0;
+		for (j = max_t(int, plat->idle_class[i], 0);
+				j < RE_CORE_IDLE_STATES; j++)
+			plat->c_limit[j] = i;
+	}
+	if (plat->idle_count != RE_CORE_IDLE_STATES)
+		plat->idle_identity = 0;
+}
+
+// fit_data index of khz, in the model scale when not an exact OPP
+static int re_platform_khz_opp(const struct re_platform *plat,
+			unsigned int khz)
+{
+	unsigned int model, diff, best_diff = UINT_MAX;
+	int i, best = 0;
+
+	if (plat->freq_identity)
+		return re_core_opp_index(khz);
+	model = re_platform_model_khz(plat, khz);
+	for (i = 0; i < RE_CORE_OPPS; i++) {
+		diff = abs((int)model - (int)re_opp_khz[i]);
+		if (diff < best_diff) {
+			best_diff = diff;
+			best = i;
+		}
+	}
+	return best;
+}
+
+/*
+ * Map the distinct frequencies khz[0..count-1] (stat->freq_table) and
+ * the driver table the governor indexes, which may be in any order and
+ * hold invalid entries.
+ */
+int re_platform_map_freq(struct re_platform *plat,
+			const unsigned int *khz, unsigned int count,
+			struct cpufreq_frequency_table *table)
+{
+	unsigned int i, f, lo_khz, hi_khz;
+	int p, mp, lo, hi;
+
+	kfree(plat->freq_opp);
+	plat->freq_opp = kcalloc(count ? count : 1, sizeof(u8), GFP_KERNEL);
+	plat->freq_count = 0;
+	if (!plat->freq_opp)
+		return -ENOMEM;
+
+	plat->max_khz = 0;
+	plat->freq_identity = 1;
+	for (i = 0; i < count; i++) {
+		if (khz[i] > plat->max_khz)
+			plat->max_khz = khz[i];
+		if (re_core_opp_index(khz[i]) < 0)
+			plat->freq_identity = 0;
+	}
+	for (i = 0; i < count; i++)
+		plat->freq_opp[i] = re_platform_khz_opp(plat, khz[i]);
+	plat->freq_count = count;
+
+	/*
+	 * The floor is the slowest entry at or above the model P-state,
+	 * the ceiling the fastest one at or below it; past either end of
+	 * the table the nearest entry.
+	 */
+	for (p = 0; p < RE_CORE_OPPS; p++) {
+		lo = hi = -1;
+		lo_khz = UINT_MAX;
+		hi_khz = 0;
+		plat->p_floor[p] = plat->p_ceiling[p] = 0;
+		for (i = 0; table && table[i].frequency != CPUFREQ_TABLE_END; i++) {
+			f = table[i].frequency;
+			if (f == CPUFREQ_ENTRY_INVALID)
+				continue;
+			mp = RE_CORE_OPPS - 1 - re_platform_khz_opp(plat, f);
+			if (mp >= p && (lo < 0 || f < table[lo].frequency))
+				lo = i;
+			if (mp <= p && (hi < 0 || f > table[hi].frequency))
+				hi = i;
+			if (f < lo_khz) {
+				lo_khz = f;
+				plat->p_ceiling[p] = i;
+			}
+			if (f > hi_khz) {
+				hi_khz = f;
+				plat->p_floor[p] = i;
+			}
+		}
+		if (lo >= 0)
+			plat->p_floor[p] = lo;
+		if (hi >= 0)
+			plat->p_ceiling[p] = hi;
+	}
+	return 0;
+}
+
+void re_platform_free(struct re_platform *plat)
+{
+	kfree(plat->freq_opp);
+	plat->freq_opp = NULL;
+	plat->freq_count = 0;
+}
+
+/*
+ * Per class sums of the cumulative driver state times, the polling
+ * state left out as it is busy time.
+ */
+void re_platform_idle_times(const struct re_platform *plat,
+			const unsigned long long *times,
+			unsigned long long out[RE_CORE_IDLE_STATES])
+{
+	int i;
+
+	memset(out, 0, RE_CORE_IDLE_STATES * sizeof(*out));
+	for (i = 0; i < plat->idle_count; i++)
+		if (plat->idle_class[i] != RE_PLAT_BUSY)
+			out[plat->idle_class[i]] += times[i];
+}
+
+/*
+ * Driver table index for a model P-state floor, or ceiling, as the
+ * cpufreq_re hooks hand them out. INT_MAX (no ceiling) passes through.
+ */
+int re_platform_P_index(const struct re_platform *plat, int p_state,
+			int ceiling)
+{
+	if (p_state == INT_MAX || !plat->freq_count)
+		return p_state;
+	p_state = clamp(p_state, 0, RE_CORE_OPPS - 1);
+	return ceiling ? plat->p_ceiling[p_state] : plat->p_floor[p_state];
+}
+
+// khz in the model scale, where the fastest entry is re_opp_khz[0]
+unsigned int re_platform_model_khz(const struct re_platform *plat,
+			unsigned int khz)
+{
+	if (plat->freq_identity || !plat->max_khz)
+		return khz;
+	return (unsigned int)div_u64((u64)khz * re_opp_khz[0], plat->max_khz);
+}
+
+ssize_t re_platform_show(const struct re_platform *plat,
+			const unsigned int *khz, char *buf)
+{
+	ssize_t len;
+	int i;
+
+	len = sprintf(buf, "idle %s\n", plat->idle_identity ? "identity"
+			: "mapped");
+	for (i = 0; i < plat->idle_count; i++)
+		len += sprintf(buf + len, "C %d %d\n", i, plat->idle_class[i]);
+	len += sprintf(buf + len, "freq %s\n", plat->freq_identity ? "identity"
+			: "mapped");
+	for (i = 0; i < plat->freq_count; i++)
+		len += sprintf(buf + len, "P %u %d %u\n", khz[i],
+			plat->freq_opp[i],
+			re_platform_model_khz(plat, khz[i]));
+	return len;
+}
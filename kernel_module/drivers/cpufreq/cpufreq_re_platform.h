@@ -0,0 +1,84 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_platform.h
+ *
+ * cpufreq_re_platform.h : interface for mapping the states of whatever
+ * cpuidle and cpufreq drivers a cpu has onto the reliability model
+ * (RE_CORE_IDLE_STATES idle classes, RE_CORE_OPPS operating points).
+ * On the AM335x the map is the identity; on other platforms, e.g. x86
+ * with intel_idle / acpi_idle and acpi-cpufreq, idle states are ranked
+ * by depth and frequencies are placed by their share of the maximum.
+ *
+ */
+
+#ifndef _CPUFREQ_RE_PLATFORM_H
+#define _CPUFREQ_RE_PLATFORM_H
+
+#include <linux/cpufreq.h>
+#include <linux/cpuidle.h>
+#include <linux/types.h>
+
+#include "cpufreq_re_core.h"
+
+#define RE_PLAT_BUSY -1		// idle class of a polling state
+
+struct re_platform {
+	// cpuidle driver state -> model idle class, RE_PLAT_BUSY for POLL
+	unsigned int idle_count;
+	s8 idle_class[CPUIDLE_STATE_MAX];
+	// model idle class -> deepest driver state of that class or below
+	int c_limit[RE_CORE_IDLE_STATES];
+	int idle_identity;
+	// stat->freq_table index -> fit_data index
+	unsigned int freq_count;
+	u8 *freq_opp;
+	unsigned int max_khz;
+	int freq_identity;
+	// model P-state -> index into the cpufreq driver table
+	int p_floor[RE_CORE_OPPS];
+	int p_ceiling[RE_CORE_OPPS];
+};
+
+void re_platform_map_idle(struct re_platform *plat,
+			struct cpuidle_driver *drv);
+int re_platform_map_freq(struct re_platform *plat,
+			const unsigned int *khz, unsigned int count,
+			struct cpufreq_frequency_table *table);
+void re_platform_free(struct re_platform *plat);
+void re_platform_idle_times(const struct re_platform *plat,
+			const unsigned long long *times,
+			unsigned long long out[RE_CORE_IDLE_STATES]);
+int re_platform_P_index(const struct re_platform *plat, int p_state,
+			int ceiling);
+unsigned int re_platform_model_khz(const struct re_platform *plat,
+			unsigned int khz);
+ssize_t re_platform_show(const struct re_platform *plat,
+			const unsigned int *khz, char *buf);
+
+// fit_data index of the stat->freq_table entry index
+static inline int re_platform_opp(const struct re_platform *plat,
+			unsigned int index)
+{
+	return index < plat->freq_count ? plat->freq_opp[index] : -1;
+}
+
+// model idle class of cpuidle driver state index
+static inline int re_platform_idle_class(const struct re_platform *plat,
+			int index)
+{
+	if (index < 0 || index >= plat->idle_count)
+		return 0;
+	return plat->idle_class[index] < 0 ? 0 : plat->idle_class[index];
+}
+
+// cpuidle driver state to use as ceiling for the model class ceiling
+static inline int re_platform_C_limit(const struct re_platform *plat,
+			int ceiling)
+{
+	if (!plat->idle_count || ceiling < 0)
+		return ceiling;
+	if (ceiling >= RE_CORE_IDLE_STATES)
+		ceiling = RE_CORE_IDLE_STATES - 1;
+	return plat->c_limit[ceiling];
+}
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_pmu.c
+ *
+ * Activity counters for cpufreq_re_stats.
+ *
+ * The CP15 backend programs the Cortex-A8 PMU directly so a sample is a
+ * handful of mrc instructions and can be taken from the idle path. It
+ * claims event counters 0-2 and the cycle counter and must not be used
+ * together with perf. The software backend produces the same samples
+ * from the busy time of the model and a fixed IPC and refill rate, so
+ * the vulnerability scaling can be exercised without the hardware.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <linux/smp.h>
+#include <linux/math64.h>
+
+#include "cpufreq_re_pmu.h"
+
+static DEFINE_PER_CPU(struct cpufreq_re_pmu_sample, cpufreq_re_pmu_sw);
+
+#ifdef CONFIG_CPU_V7
+#include <asm/barrier.h>
+
+// ARMv7 common events
+#define RE_PMU_EVT_L1I_REFILL	0x01
+#define RE_PMU_EVT_L1D_REFILL	0x03
+#define RE_PMU_EVT_INST		0x08
+
+#define RE_PMU_CNT_INST		0
+#define RE_PMU_CNT_L1D		1
+#define RE_PMU_CNT_L1I		2
+#define RE_PMU_CNT_MASK		((1 << RE_PMU_CNT_INST) | (1 << RE_PMU_CNT_L1D) \
+				| (1 << RE_PMU_CNT_L1I) | (1 << 31))
+
+#define RE_PMCR_E		(1 << 0)
+
+static inline void re_pmu_select(u32 idx)
+{
+	asm volatile("mcr p15, 0, %0, c9, c12, 5" : : "r" (idx));
+	isb();
+}
+
+static inline u32 re_pmu_read_counter(u32 idx)
+{
+	u32 val;
+
+	re_pmu_select(idx);
+	asm volatile("mrc p15, 0, %0, c9, c13, 2" : "=r" (val));
+	return val;
+}
+
+static void re_pmu_cp15_start(void *unused)
+{
+	u32 pmcr;
+
+	re_pmu_select(RE_PMU_CNT_INST);
+	asm volatile("mcr p15, 0, %0, c9, c13, 1" : : "r" (RE_PMU_EVT_INST));
+	re_pmu_select(RE_PMU_CNT_L1D);
+	asm volatile("mcr p15, 0, %0, c9, c13, 1" : : "r" (RE_PMU_EVT_L1D_REFILL));
+	re_pmu_select(RE_PMU_CNT_L1I);
+	asm volatile("mcr p15, 0, %0, c9, c13, 1" : : "r" (RE_PMU_EVT_L1I_REFILL));
+	asm volatile("mcr p15, 0, %0, c9, c12, 1" : : "r" (RE_PMU_CNT_MASK));
+	asm volatile("mrc p15, 0, %0, c9, c12, 0" : "=r" (pmcr));
+	asm volatile("mcr p15, 0, %0, c9, c12, 0" : : "r" (pmcr | RE_PMCR_E));
+	isb();
+}
+
+static void re_pmu_cp15_stop(void *unused)
+{
+	asm volatile("mcr p15, 0, %0, c9, c12, 2" : : "r" (RE_PMU_CNT_MASK));
+	isb();
+}
+
+static void re_pmu_cp15_read(struct cpufreq_re_pmu_sample *sample)
+{
+	u32 val;
+
+	asm volatile("mrc p15, 0, %0, c9, c13, 0" : "=r" (val));
+	sample->cycles = val;
+	sample->instructions = re_pmu_read_counter(RE_PMU_CNT_INST);
+	sample->refills = re_pmu_read_counter(RE_PMU_CNT_L1D)
+			+ re_pmu_read_counter(RE_PMU_CNT_L1I);
+}
+#endif
+
+int cpufreq_re_pmu_start(int mode)
+{
+	switch (mode) {
+	case RE_PMU_OFF:
+	case RE_PMU_SW:
+		return 0;
+#ifdef CONFIG_CPU_V7
+	case RE_PMU_CP15:
+		on_each_cpu(re_pmu_cp15_start, NULL, 1);
+		return 0;
+#endif
+	}
+	return -ENODEV;
+}
+
+void cpufreq_re_pmu_stop(int mode)
+{
+#ifdef CONFIG_CPU_V7
+	if (mode == RE_PMU_CP15)
+		on_each_cpu(re_pmu_cp15_stop, NULL, 1);
+#endif
+}
+
+/*
+ * Counters of cpu. The CP15 ones can only be read on the cpu itself,
+ * -EAGAIN tells the caller to keep its last factors.
+ */
+int cpufreq_re_pmu_read(int mode, unsigned int cpu,
+			struct cpufreq_re_pmu_sample *sample)
+{
+	switch (mode) {
+	case RE_PMU_SW:
+		*sample = per_cpu(cpufreq_re_pmu_sw, cpu);
+		return 0;
+#ifdef CONFIG_CPU_V7
+	case RE_PMU_CP15:
+		if (cpu != raw_smp_processor_id())
+			return -EAGAIN;
+		re_pmu_cp15_read(sample);
+		return 0;
+#endif
+	}
+	return -ENODEV;
+}
+
+/*
+ * Advance the software counters of cpu by busy_us at khz, with ipc in
+ * 1/1000 and refill in refills per 1000 instructions.
+ */
+void cpufreq_re_pmu_sw_account(unsigned int cpu, unsigned int busy_us,
+			unsigned int khz, unsigned int ipc,
+			unsigned int refill)
+{
+	struct cpufreq_re_pmu_sample *sw = &per_cpu(cpufreq_re_pmu_sw, cpu);
+	u64 cycles = div_u64((u64)busy_us * khz, 1000);
+	u64 inst = div_u64(cycles * ipc, 1000);
+
+	sw->cycles += (u32)cycles;
+	sw->instructions += (u32)inst;
+	sw->refills += (u32)div_u64(inst * refill, 1000);
+}
@@ -0,0 +1,33 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_pmu.h
+ *
+ * cpufreq_re_pmu.h : interface for sampling the activity counters
+ * cpufreq_re_stats derives vulnerability factors from
+ *
+ */
+
+#ifndef _CPUFREQ_RE_PMU_H
+#define _CPUFREQ_RE_PMU_H
+
+#include <linux/types.h>
+
+#define RE_PMU_OFF 0		// raw FIT rates in C0
+#define RE_PMU_CP15 1		// ARMv7 PMU, counters 0-2 and the cycle counter
+#define RE_PMU_SW 2		// software stand-in driven by the model
+
+// free running 32 bit counts, only deltas are meaningful
+struct cpufreq_re_pmu_sample {
+	u32 cycles;
+	u32 instructions;
+	u32 refills;		// L1 I + D refills
+};
+
+int cpufreq_re_pmu_start(int mode);
+void cpufreq_re_pmu_stop(int mode);
+int cpufreq_re_pmu_read(int mode, unsigned int cpu,
+			struct cpufreq_re_pmu_sample *sample);
+void cpufreq_re_pmu_sw_account(unsigned int cpu, unsigned int busy_us,
+			unsigned int khz, unsigned int ipc,
+			unsigned int refill);
+
+#endif
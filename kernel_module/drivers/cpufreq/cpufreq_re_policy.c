@@ -0,0 +1,263 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_policy.c
+ *
+ * Registry of reliability policies for cpufreq_re_stats. One policy is
+ * active at a time for all cpus; it can be switched at runtime and a
+ * policy module cannot be unloaded while it is selected.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/jiffies.h>
+
+#include "cpufreq_re_policy.h"
+
+static LIST_HEAD(re_policy_list);
+// protects the list, the active policy and its stats
+static DEFINE_SPINLOCK(re_policy_lock);
+static struct re_policy_ops *re_policy_active;
+static struct re_policy_ops *re_policy_default;
+static unsigned long long re_policy_since;
+
+static unsigned long long re_policy_now(void)
+{
+	return jiffies_to_usecs(get_jiffies_64());
+}
+
+static struct re_policy_ops *re_policy_find(const char *name)
+{
+	struct re_policy_ops *ops;
+
+	list_for_each_entry(ops, &re_policy_list, list)
+		if (!strncmp(ops->name, name, RE_POLICY_NAME_LEN))
+			return ops;
+	return NULL;
+}
+
+/*
+ * Switch to ops, called with re_policy_lock held. The reference on the
+ * new owner is taken by the caller.
+ */
+static void re_policy_switch(struct re_policy_ops *ops)
+{
+	unsigned long long now = re_policy_now();
+	struct re_policy_ops *old = re_policy_active;
+
+	if (old) {
+		old->stats.active_time += now - re_policy_since;
+		module_put(old->owner);
+	}
+	re_policy_active = ops;
+	re_policy_since = now;
+	if (ops && ops->enable)
+		ops->enable();
+}
+
+int cpufreq_re_register_policy(struct re_policy_ops *ops)
+{
+	int ret = 0;
+
+	if (!ops || !ops->c_ceiling || !ops->p_floor || !ops->name[0])
+		return -EINVAL;
+
+	spin_lock(&re_policy_lock);
+	if (re_policy_find(ops->name)) {
+		ret = -EBUSY;
+		goto out;
+	}
+	memset(&ops->stats, 0, sizeof(ops->stats));
+	list_add_tail(&ops->list, &re_policy_list);
+out:
+	spin_unlock(&re_policy_lock);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(cpufreq_re_register_policy);
+
+void cpufreq_re_unregister_policy(struct re_policy_ops *ops)
+{
+	spin_lock(&re_policy_lock);
+	if (re_policy_active == ops) {
+		// only built-in policies get here, modules hold a reference
+		if (re_policy_default && re_policy_default != ops)
+			__module_get(re_policy_default->owner);
+		re_policy_switch(re_policy_default != ops ?
+				re_policy_default : NULL);
+	}
+	if (re_policy_default == ops)
+		re_policy_default = NULL;
+	list_del(&ops->list);
+	spin_unlock(&re_policy_lock);
+}
+EXPORT_SYMBOL_GPL(cpufreq_re_unregister_policy);
+
+int cpufreq_re_select_policy(const char *name)
+{
+	struct re_policy_ops *ops;
+	int ret = 0;
+
+	spin_lock(&re_policy_lock);
+	ops = re_policy_find(name);
+	if (!ops) {
+		ret = -ENOENT;
+		goto out;
+	}
+	if (ops == re_policy_active)
+		goto out;
+	if (!try_module_get(ops->owner)) {
+		ret = -ENODEV;
+		goto out;
+	}
+	re_policy_switch(ops);
+out:
+	spin_unlock(&re_policy_lock);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(cpufreq_re_select_policy);
+
+/*
+ * The default policy is the fallback when the active one goes away and
+ * is selected right away if nothing is active yet.
+ */
+void cpufreq_re_policy_set_default(struct re_policy_ops *ops)
+{
+	spin_lock(&re_policy_lock);
+	re_policy_default = ops;
+	if (!re_policy_active && ops) {
+		__module_get(ops->owner);
+		re_policy_switch(ops);
+	}
+	spin_unlock(&re_policy_lock);
+}
+
+const char *cpufreq_re_policy_name(void)
+{
+	return re_policy_active ? re_policy_active->name : "";
+}
+
+void cpufreq_re_policy_epoch_start(struct re_policy_ctx *ctx)
+{
+	struct re_policy_ops *ops;
+
+	spin_lock(&re_policy_lock);
+	ops = re_policy_active;
+	if (ops) {
+		ops->stats.epochs++;
+		if (ctx->prev_overflow)
+			ops->stats.overflows++;
+		if (ops->epoch_start)
+			ops->epoch_start(ctx);
+	}
+	spin_unlock(&re_policy_lock);
+}
+
+int cpufreq_re_policy_c_ceiling(struct re_policy_ctx *ctx)
+{
+	struct re_policy_ops *ops;
+	int ret = 3;
+
+	spin_lock(&re_policy_lock);
+	ops = re_policy_active;
+	if (ops) {
+		ret = ops->c_ceiling(ctx);
+		if (ret < 0)
+			ret = 0;
+		if (ret > 3)
+			ret = 3;
+		ops->stats.c_hist[ret]++;
+	}
+	spin_unlock(&re_policy_lock);
+	return ret;
+}
+
+int cpufreq_re_policy_p_floor(struct re_policy_ctx *ctx)
+{
+	struct re_policy_ops *ops;
+	int ret = 0;
+
+	spin_lock(&re_policy_lock);
+	ops = re_policy_active;
+	if (ops) {
+		ret = ops->p_floor(ctx);
+		if (ret < 0)
+			ret = 0;
+		if (ret > 4)
+			ret = 4;
+		ops->stats.p_hist[ret]++;
+	}
+	spin_unlock(&re_policy_lock);
+	return ret;
+}
+
+void cpufreq_re_policy_transition(struct re_policy_ctx *ctx,
+			unsigned int old_freq, unsigned int new_freq)
+{
+	struct re_policy_ops *ops;
+
+	spin_lock(&re_policy_lock);
+	ops = re_policy_active;
+	if (ops && ops->on_transition)
+		ops->on_transition(ctx, old_freq, new_freq);
+	spin_unlock(&re_policy_lock);
+}
+
+void cpufreq_re_policy_idle_exit(struct re_policy_ctx *ctx, int state,
+			int residency)
+{
+	struct re_policy_ops *ops;
+
+	spin_lock(&re_policy_lock);
+	ops = re_policy_active;
+	if (ops && ops->on_idle_exit)
+		ops->on_idle_exit(ctx, state, residency);
+	spin_unlock(&re_policy_lock);
+}
+
+/*
+ * Registered policies, the active one in brackets
+ */
+ssize_t cpufreq_re_policy_show(char *buf)
+{
+	struct re_policy_ops *ops;
+	ssize_t len = 0;
+
+	spin_lock(&re_policy_lock);
+	list_for_each_entry(ops, &re_policy_list, list)
+		len += sprintf(buf + len, ops == re_policy_active ?
+				"[%s] " : "%s ", ops->name);
+	spin_unlock(&re_policy_lock);
+	if (len)
+		buf[len - 1] = '\n';
+	return len;
+}
+
+/*
+ * One line per policy:
+ * "name active_ms epochs overflows c0..c3 p0..p4"
+ */
+ssize_t cpufreq_re_policy_show_stats(char *buf)
+{
+	struct re_policy_ops *ops;
+	struct re_policy_stats *s;
+	unsigned long long active;
+	ssize_t len = 0;
+
+	spin_lock(&re_policy_lock);
+	list_for_each_entry(ops, &re_policy_list, list) {
+		s = &ops->stats;
+		active = s->active_time;
+		if (ops == re_policy_active)
+			active += re_policy_now() - re_policy_since;
+		len += sprintf(buf + len,
+			"%s %llu %u %u %u %u %u %u %u %u %u %u %u\n",
+			ops->name, active / 1000, s->epochs, s->overflows,
+			s->c_hist[0], s->c_hist[1], s->c_hist[2], s->c_hist[3],
+			s->p_hist[0], s->p_hist[1], s->p_hist[2], s->p_hist[3],
+			s->p_hist[4]);
+	}
+	spin_unlock(&re_policy_lock);
+	return len;
+}
@@ -0,0 +1,28 @@
+/*
+ *  drivers/cpufreq/cpufreq_re_policy.h
+ *
+ * cpufreq_re_policy.h : interface between cpufreq_re_stats and the
+ * policy registry
+ *
+ */
+
+#ifndef _CPUFREQ_RE_POLICY_H
+#define _CPUFREQ_RE_POLICY_H
+
+#include <linux/cpufreq_re_policy.h>
+
+void cpufreq_re_policy_set_default(struct re_policy_ops *ops);
+const char *cpufreq_re_policy_name(void);
+
+void cpufreq_re_policy_epoch_start(struct re_policy_ctx *ctx);
+int cpufreq_re_policy_c_ceiling(struct re_policy_ctx *ctx);
+int cpufreq_re_policy_p_floor(struct re_policy_ctx *ctx);
+void cpufreq_re_policy_transition(struct re_policy_ctx *ctx,
+			unsigned int old_freq, unsigned int new_freq);
+void cpufreq_re_policy_idle_exit(struct re_policy_ctx *ctx, int state,
+			int residency);
+
+ssize_t cpufreq_re_policy_show(char *buf);
+ssize_t cpufreq_re_policy_show_stats(char *buf);
+
+#endif
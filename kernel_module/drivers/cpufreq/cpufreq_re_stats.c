@@ -9,6 +9,7 @@
 #include <linux/cpu.h>
 #include <linux/io.h>
 #include <linux/cpufreq.h>
+#include <linux/cpufreq_re.h>
 #include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/cpuidle.h>
@@ -18,10 +19,23 @@
 #include <linux/timer.h>
 #include <linux/delay.h>
 #include <linux/export.h>
+#include <linux/crc32.h>
+#include <linux/math64.h>
+#include <linux/pm_qos.h>
+#include <linux/syscore_ops.h>
+#include <linux/workqueue.h>
 
 #include <asm/cputime.h>
 
 #include "cpufreq_re_fit_data.h"
+#include "cpufreq_re_core.h"
+#include "cpufreq_re_netlink.h"
+#include "cpufreq_re_cgroup.h"
+#include "cpufreq_re_policy.h"
+#include "cpufreq_re_pmu.h"
+#include "cpufreq_re_bench.h"
+#include "cpufreq_re_platform.h"
+#include "cpufreq_re_calib.h"
 
 #define LOG_LENGTH 40
 #define LOG_FREQ 10
@@ -30,6 +44,17 @@
 #define DYN_FREQ 3
 #define POLICY_ENABLE
 
+// controller_mode values, kept as aliases of the built-in policies
+#define RE_CTRL_THRESHOLD 0	// remaining budget / remaining time
+#define RE_CTRL_PI 1		// PI feedback on budget error
+#define RE_CTRL_PARETO 2	// joint C/P choice on a precomputed frontier
+#define PI_INTEGRAL_LIMIT 4	// |integral| <= limit * setpoint
+
+// energy cap modes
+#define RE_ENERGY_OFF 0
+#define RE_ENERGY_ONLY 1	// power cap replaces the FIT budget
+#define RE_ENERGY_JOINT 2	// power cap on top of the FIT budget
+
 struct cpufreq_re_log;
 struct cpufreq_re_stat;
 static spinlock_t cpufreq_re_stats_lock;
@@ -37,11 +62,76 @@ static int log_thread_init(unsigned int cpu);
 static int log_thread_exit(unsigned int cpu);
 static int thread_log_fn(void* cpu);
 static int cpufreq_re_report_FIT(unsigned int cpu);
+static void cpufreq_re_ctx_update(struct cpufreq_re_stats *stat,
+			unsigned long long cur_wall_time);
+static int cpufreq_re_builtin_policies_init(void);
+static void cpufreq_re_builtin_policies_exit(void);
+static const struct cpufreq_re_hooks cpufreq_re_stats_hooks;
+#ifndef STATIC_POLICY
+static u64 cpufreq_re_wear_allowed(u64 age);
+#endif
 static unsigned int mem_addr;
 static char log_name[32];
 extern int wkup_m3_ping_delay(int iteration);
 static int log_state;
 static int trace_state;
+static const char * const re_ctrl_policy[] = {
+	[RE_CTRL_THRESHOLD] = "threshold",
+	[RE_CTRL_PI] = "pi",
+	[RE_CTRL_PARETO] = "pareto",
+};
+static int pi_kp = 128;		// gains and smoothing, in 1/256
+static int pi_ki = 64;
+static int pi_alpha = 64;
+static int bank_cap;		// cycles of budget the bank may hold, 0 = off
+static int energy_cap_mode = RE_ENERGY_OFF;
+static int power_cap;		// average power cap, same unit as cur_core_pow
+static int dwell_time;		// usec a P-state floor is held at least
+static int dwell_cost;		// hold >= this * average transition time, 0 = off
+static int hysteresis;		// budget error band in %, 0 = off
+static int qos_publish;		// publish the C ceiling as cpu_dma_latency
+static int avf_mode = RE_PMU_OFF;	// PMU backend for vulnerability factors
+static int avf_floor = 256;	// factor of always live state, 1/1024
+static int avf_sw_ipc = 1000;	// software PMU: IPC in 1/1000
+static int avf_sw_refill = 10;	// software PMU: L1 refills per 1000 inst
+#define RE_AVF_IPC_PEAK 2000	// Cortex-A8 dual issue, 1/1000
+#define RE_AVF_REFILL_REF 50	// refills per 1000 inst for the L1 floor
+static int wear_life;		// service life in hours, 0 = no wear ceiling
+static int wear_target = 100;	// lifetime stress budget, % of OPP100 in C0
+static int wear_schedule;	// how the budget is released over the life
+#define RE_WEAR_LINEAR 0
+#define RE_WEAR_FRONT 1		// square root of the life fraction
+static struct pm_qos_request cpufreq_re_qos_req;
+
+/*
+ * State of one PI budget controller (core or mem). The output is a FIT
+ * rate allowance that replaces the instantaneous fit target.
+ */
+struct cpufreq_re_pi {
+	s64 integral;		// rate error summed over closed cycles
+	unsigned int output;	// smoothed allowance, 0 before first step
+	int saturated;		// -1 / +1 when clamped at min / max
+};
+
+/*
+ * One (P-state floor, C-state ceiling) pair of the joint optimizer with
+ * its expected FIT and power rates at a given utilization.
+ */
+#define RE_PARETO_BUCKETS 4	// utilization buckets, at 1GHz
+#define RE_PARETO_POINTS 15	// 5 OPPs x 3 C-state ceilings
+
+struct cpufreq_re_pareto_point {
+	unsigned char p_state;	// cpufreq_re_get_P_states() convention
+	unsigned char c_state;	// cpufreq_re_get_C_states() convention
+	unsigned int core_fit;
+	unsigned int mem_fit;
+	unsigned int pow;
+};
+
+struct cpufreq_re_pareto {
+	int count[RE_PARETO_BUCKETS];	// frontier size, sorted by pow
+	struct cpufreq_re_pareto_point point[RE_PARETO_BUCKETS][RE_PARETO_POINTS];
+};
 
 struct cpufreq_re_log {
 	unsigned int cpu;
@@ -66,29 +156,55 @@ struct cpufreq_re_stats {
 	unsigned int *freq_table;
 	unsigned long long *last_idle_state_usage;
 	unsigned long long *last_idle_state_time;	// last idle state usage time (us)
+	struct re_platform plat;		// driver states -> model states
 	unsigned int location_factor;
-	unsigned int cur_core_fit;
-	unsigned int cur_mem_fit;
-	unsigned int cpuidle_c1_fit;
-	unsigned int cpuidle_c2_fit;
-	unsigned int cpuidle_mem_ret_fit;
-	unsigned int cur_core_pow;
-	unsigned int cur_mem_pow;
-	unsigned int cur_mem_pow_l2_ret;
-	unsigned int cpuidle_c1_pow;
-	unsigned int cpuidle_mem_ret_pow;
-	unsigned int core_fit_target;
-	unsigned int mem_fit_target;
-	u64 core_pow_acc;
-	u64 mem_pow_acc;
-	u64 core_fit_acc;
-	u64 mem_fit_acc;
+	struct re_core_rates rates;		// at last_index
+	struct re_core_budget budget;		// targets, factors, running cycle
+	struct re_core_acc acc;
 	u64 cycle_max_core_fit;
 	u64 cycle_max_mem_fit;
+	int last_C_state;			// last C-state ceiling returned
+	int last_P_state;			// last P-state floor, model index
+	int last_P_ceiling;			// last P-state ceiling (energy cap)
+	struct re_policy_ctx ctx;		// what the active policy sees
+	unsigned int energy_conflicts;		// FIT floor cut by the energy cap
+	u64 busy_time;				// usec not spent in any idle state
+	unsigned int transitions;		// frequency changes done by the driver
+	u64 transition_time;			// usec spent in them
+	u64 transition_energy;			// at active power of the old OPP
+	unsigned int avg_transition_time;	// running average, usec
+	unsigned int qos_conflicts;		// idle entries QoS kept too shallow
+	int qos_state;				// QoS limit below the ceiling, or -1
+	int qos_alt_state;			// the ceiling it replaced
+	u64 qos_borrowed_fit;			// FIT charged because of QoS
+	s32 qos_constraint;			// latency implied by the ceiling
+	struct cpufreq_re_pmu_sample avf_last;	// counters at the last sample
+	int avf_primed;				// avf_last is valid
+	unsigned int avf_ipc;			// last interval, 1/1000
+	unsigned int avf_refill;		// refills per 1000 inst
+	unsigned int avf_samples;
+	u64 suspend_time;			// usec spent in system suspend
+	u64 wear_age;				// usec of life accounted
+	int last_wear_ceiling;			// P-state ceiling from acc.wear_acc
+	unsigned int wear_conflicts;		// FIT floor cut by the wear ceiling
+	unsigned int state_restored;		// history imported from user
 #ifndef STATIC_POLICY
-	unsigned long long budget_stop_time;		// in usec
-	u64 budget_target_core_fit_acc;
-	u64 budget_target_mem_fit_acc;
+	unsigned int epoch;			// control cycle sequence number
+	unsigned int epoch_overflow;		// overflow event sent this cycle
+	u64 epoch_core_fit_acc;			// accumulators at cycle start
+	u64 epoch_mem_fit_acc;
+	u64 epoch_core_pow_acc;
+	u64 epoch_mem_pow_acc;
+	struct cpufreq_re_pi core_pi;
+	struct cpufreq_re_pi mem_pi;
+	u64 epoch_busy_time;
+	int held_P_state;			// floor after dwell and hysteresis
+	unsigned long long held_since;
+	unsigned int floor_changes;
+	struct cpufreq_re_pareto pareto;
+	int pareto_bucket;			// utilization of the last cycle
+	int pareto_choice;			// frontier point, -1 = none yet
+	unsigned int pareto_epoch;		// cycle the choice was made in
 #endif
 };
 
@@ -124,46 +240,159 @@ static int update_cur_fit(unsigned int cpu) {
 		return -ENOMEM;
 	}
 
-	switch (stat->freq_table[stat->last_index]) {
-		case 1000*1000 :
-			index = 0;
-			break;
-		case 800*1000 :
-			index = 1;
-                        break;
-		case 720*1000 :
-			index = 2;
-                        break;
-		case 600*1000 :
-			index = 3;
-                        break;
-		case 300*1000 :
-			index = 4;
-                        break;
-		default :
-			printk("cpufreq_re_stats: unknown frequency %d\n", 
-				stat->freq_table[stat->last_index]);
-			return -EINVAL;
+	index = re_platform_opp(&stat->plat, stat->last_index);
+	if (index < 0) {
+		printk("cpufreq_re_stats: unknown frequency %d\n", 
+			stat->freq_table[stat->last_index]);
+		return -EINVAL;
 	}
-	stat->cur_core_fit = fit_data->core_fit[index]
-	                        * stat->location_factor / 100;
-	stat->cur_mem_fit = (fit_data->L1_mem_fit[index] + fit_data->L2_mem_fit)
-	                        * stat->location_factor / 100;
-	stat->cpuidle_c1_fit = fit_data->core_fit_c1[index]
-	                        * stat->location_factor / 100;
-	stat->cpuidle_c2_fit = fit_data->core_fit_c2
-	                        * stat->location_factor / 100;
-	stat->cpuidle_mem_ret_fit = (fit_data->L1_mem_fit_ret[index] + fit_data->L2_mem_fit_ret)
-	                        * stat->location_factor / 100;
-	stat->cur_core_pow = fit_data->core_pow[index];
-	stat->cur_mem_pow = fit_data->L1_mem_pow[index] + fit_data->L2_mem_pow;
-	stat->cur_mem_pow_l2_ret = fit_data->L1_mem_pow[index] + fit_data->L2_mem_fit_ret;
-	stat->cpuidle_c1_pow = fit_data->core_pow_c1[index];
-	stat->cpuidle_mem_ret_pow = fit_data->L1_mem_pow_ret[index]
-	                        + fit_data->L2_mem_pow_ret;
+	re_core_rates(fit_data, index, stat->location_factor, &stat->rates);
+	stat->ctx.c2_fit = stat->rates.cpuidle_c2_fit;
+	stat->ctx.mem_ret_fit = stat->rates.cpuidle_mem_ret_fit;
+	stat->ctx.location_factor = stat->location_factor;
 	return 0;
 }
 
+#ifndef STATIC_POLICY
+/*
+ * Precompute the Pareto frontier of (P-state floor, C-state ceiling)
+ * pairs for each utilization bucket. A pair costs its OPP rates while
+ * busy and the rates of its deepest allowed C-state while idle. On the
+ * shipped model faster OPPs have the lower FIT, so the tradeoff is FIT
+ * against power: a point stays if no other pair is at most as bad in
+ * core FIT, mem FIT and power. Called with cpufreq_re_stats_lock held.
+ */
+static void cpufreq_re_pareto_build(struct cpufreq_re_stats *stat,
+			struct cpufreq_re_fit_data *fit_data)
+{
+	struct cpufreq_re_pareto_point cand[RE_PARETO_POINTS];
+	struct cpufreq_re_pareto_point *a, *b, *frontier;
+	unsigned int util, util_i, idle_core, idle_mem, idle_pow;
+	int bucket, i, c, n, j, k, dominated;
+
+	for (bucket = 0; bucket < RE_PARETO_BUCKETS; bucket++) {
+		// rate at the upper edge of the bucket, in 1/1024
+		util = (bucket + 1) * 1024 / RE_PARETO_BUCKETS;
+		n = 0;
+		for (i = 0; i < 5; i++) {
+			util_i = util * 1000 / (re_opp_khz[i] / 1000);
+			if (util_i > 1024)
+				util_i = 1024;
+			for (c = 1; c <= 3; c++) {
+				switch (c) {
+				case 1:
+					idle_core = fit_data->core_fit_c1[i];
+					idle_mem = fit_data->L1_mem_fit[i]
+						+ fit_data->L2_mem_fit;
+					idle_pow = fit_data->core_pow_c1[i]
+						+ fit_data->L1_mem_pow[i]
+						+ fit_data->L2_mem_pow;
+					break;
+				case 2:
+					idle_core = fit_data->core_fit_c2;
+					idle_mem = fit_data->L1_mem_fit[i]
+						+ fit_data->L2_mem_fit;
+					idle_pow = fit_data->L1_mem_pow[i]
+						+ fit_data->L2_mem_pow_ret;
+					break;
+				default:
+					idle_core = fit_data->core_fit_c2;
+					idle_mem = fit_data->L1_mem_fit_ret[i]
+						+ fit_data->L2_mem_fit_ret;
+					idle_pow = fit_data->L1_mem_pow_ret[i]
+						+ fit_data->L2_mem_pow_ret;
+				}
+				cand[n].p_state = 4 - i;
+				cand[n].c_state = c;
+				cand[n].core_fit = ((util_i * fit_data->core_fit[i]
+					+ (1024 - util_i) * idle_core) >> 10)
+					* stat->location_factor / 100;
+				cand[n].mem_fit = ((util_i * (fit_data->L1_mem_fit[i]
+					+ fit_data->L2_mem_fit)
+					+ (1024 - util_i) * idle_mem) >> 10)
+					* stat->location_factor / 100;
+				cand[n].pow = (util_i * (fit_data->core_pow[i]
+					+ fit_data->L1_mem_pow[i]
+					+ fit_data->L2_mem_pow)
+					+ (1024 - util_i) * idle_pow) >> 10;
+				n++;
+			}
+		}
+
+		frontier = stat->pareto.point[bucket];
+		k = 0;
+		for (i = 0; i < n; i++) {
+			a = &cand[i];
+			dominated = 0;
+			for (j = 0; j < n && !dominated; j++) {
+				b = &cand[j];
+				if (j == i || b->core_fit > a->core_fit ||
+				    b->mem_fit > a->mem_fit || b->pow > a->pow)
+					continue;
+				// equal points keep the first one
+				if (b->core_fit < a->core_fit || b->mem_fit < a->mem_fit ||
+				    b->pow < a->pow || j < i)
+					dominated = 1;
+			}
+			if (dominated)
+				continue;
+			// insertion by increasing power
+			for (j = k; j > 0 && frontier[j - 1].pow > a->pow; j--)
+				frontier[j] = frontier[j - 1];
+			frontier[j] = *a;
+			k++;
+		}
+		stat->pareto.count[bucket] = k;
+	}
+	stat->pareto_choice = -1;
+}
+#endif
+
+/*
+ * Vulnerability factors of the last accounting interval from PMU
+ * activity. Core state only holds ACE bits while instructions flow, so
+ * the core factor follows IPC against the dual issue peak. L1 lines
+ * that are refilled often are evicted before reuse, so the L1 factor
+ * drops as the refill rate rises. Both keep avf_floor for state that is
+ * always live. Without new cycles the previous factors are kept.
+ * It should be called within cpufreq_re_stats_lock
+ */
+static void cpufreq_re_avf_sample(struct cpufreq_re_stats *stat,
+			int busy_diff)
+{
+	struct cpufreq_re_pmu_sample now;
+	u32 cycles, inst, refills;
+	unsigned int ipc, refill, act;
+
+	if (avf_mode == RE_PMU_SW && busy_diff > 0)
+		cpufreq_re_pmu_sw_account(stat->cpu, busy_diff,
+				stat->freq_table[stat->last_index],
+				avf_sw_ipc, avf_sw_refill);
+	if (cpufreq_re_pmu_read(avf_mode, stat->cpu, &now))
+		return;
+	cycles = now.cycles - stat->avf_last.cycles;
+	inst = now.instructions - stat->avf_last.instructions;
+	refills = now.refills - stat->avf_last.refills;
+	stat->avf_last = now;
+	if (!stat->avf_primed) {
+		stat->avf_primed = 1;
+		return;
+	}
+	if (!cycles)
+		return;
+
+	ipc = (unsigned int)div_u64((u64)inst * 1000, cycles);
+	refill = inst ? (unsigned int)div_u64((u64)refills * 1000, inst) : 0;
+	act = min_t(unsigned int, ipc, RE_AVF_IPC_PEAK) * 1024 / RE_AVF_IPC_PEAK;
+	stat->budget.avf_core = avf_floor + ((1024 - avf_floor) * act >> 10);
+	act = min_t(unsigned int, refill, RE_AVF_REFILL_REF) * 1024
+			/ RE_AVF_REFILL_REF;
+	stat->budget.avf_l1 = avf_floor + ((1024 - avf_floor) * (1024 - act) >> 10);
+	stat->avf_ipc = ipc;
+	stat->avf_refill = refill;
+	stat->avf_samples++;
+}
+
 /* 
  * This function updates all related data in struct cpufreq_re_stats
  * using all cur_###_fit. It should be called before cur_fit update.
@@ -173,7 +402,10 @@ static int cpufreq_re_stats_update(unsigned int cpu)
 	struct cpufreq_re_stats *stat;
         struct cpuidle_device *dev;
 	unsigned int cur_time;
-	int idle_time_diff[3], time_diff;
+	int idle_time_diff[4], time_diff, busy_diff, wfi_diff, diff, i;
+	int qos_time, qos_extra;
+	unsigned int c0_core_fit, c0_mem_fit;
+	u64 fit_delta, pow_delta;
 
 	stat = per_cpu(cpufreq_re_stats_table, cpu);
 	dev = per_cpu(cpuidle_devices, cpu);
@@ -181,88 +413,134 @@ static int cpufreq_re_stats_update(unsigned int cpu)
 	spin_lock(&cpufreq_re_stats_lock);
 
 	if (!dev || !stat) {
+		spin_unlock(&cpufreq_re_stats_lock);
 		printk("cpufreq_re_stats_update: error retrieving stat or dev\n");
 		return -1;
 	}
+	fit_delta = stat->acc.core_fit_acc + stat->acc.mem_fit_acc;
+	pow_delta = stat->acc.core_pow_acc + stat->acc.mem_pow_acc;
 	
 	// do necessary update here
 	time_diff = cur_time - stat->last_time;
-        idle_time_diff[1] = dev->states_usage[1].time
-                         - stat->last_idle_state_time[1];
-        idle_time_diff[2] = dev->states_usage[2].time
-                         - stat->last_idle_state_time[2];
-        idle_time_diff[3] = dev->states_usage[3].time
-                         - stat->last_idle_state_time[3];
+	// driver states summed per model class, a polling state is busy
+	wfi_diff = 0;
+	idle_time_diff[1] = idle_time_diff[2] = idle_time_diff[3] = 0;
+	for (i = 0; i < stat->cpuidle_state_num; i++) {
+		diff = dev->states_usage[i].time - stat->last_idle_state_time[i];
+		switch (stat->plat.idle_class[i]) {
+		case RE_PLAT_BUSY:
+			break;
+		case 0:
+			wfi_diff += diff;
+			break;
+		default:
+			idle_time_diff[stat->plat.idle_class[i]] += diff;
+		}
+	}
 	idle_time_diff[0] = time_diff - idle_time_diff[1]
 			- idle_time_diff[2] - idle_time_diff[3];
 	if (idle_time_diff[0] < 0) {
 		idle_time_diff[0] = 0;
 	}
+	// C0 in the model includes the WFI state, busy time does not
+	busy_diff = idle_time_diff[0] - wfi_diff;
+	if (busy_diff > 0)
+		stat->busy_time += busy_diff;
+	if (stat->qos_state >= 0 && stat->qos_state < 4) {
+		qos_time = stat->qos_state ? idle_time_diff[stat->qos_state]
+				: idle_time_diff[0] - max(busy_diff, 0);
+		qos_extra = (int)re_core_idle_fit(&stat->rates, stat->qos_state)
+			- (int)re_core_idle_fit(&stat->rates, stat->qos_alt_state);
+		if (qos_time > 0 && qos_extra > 0)
+			stat->qos_borrowed_fit += (u64)qos_time * qos_extra;
+	}
 #ifdef STATIC_POLICY
-	if (stat->cur_core_fit > stat->cycle_max_core_fit) {
-		stat->cycle_max_core_fit = stat->cur_core_fit;
+	if (stat->rates.cur_core_fit > stat->cycle_max_core_fit) {
+		stat->cycle_max_core_fit = stat->rates.cur_core_fit;
 	}
-	if (stat->cur_mem_fit > stat->cycle_max_mem_fit) {
-		stat->cycle_max_mem_fit = stat->cur_mem_fit;
+	if (stat->rates.cur_mem_fit > stat->cycle_max_mem_fit) {
+		stat->cycle_max_mem_fit = stat->rates.cur_mem_fit;
 	}
 	if (idle_time_diff[1] != 0) {
-		if (stat->cpuidle_c1_fit > stat->cycle_max_core_fit)
-			stat->cycle_max_core_fit = stat->cpuidle_c1_fit; 
+		if (stat->rates.cpuidle_c1_fit > stat->cycle_max_core_fit)
+			stat->cycle_max_core_fit = stat->rates.cpuidle_c1_fit; 
 	}
 	if (idle_time_diff[2] != 0) {
-		if (stat->cpuidle_c2_fit > stat->cycle_max_core_fit)
-			stat->cycle_max_core_fit = stat->cpuidle_c2_fit;
+		if (stat->rates.cpuidle_c2_fit > stat->cycle_max_core_fit)
+			stat->cycle_max_core_fit = stat->rates.cpuidle_c2_fit;
 	}
 	if (idle_time_diff[3] != 0) {
-		if (stat->cpuidle_c2_fit > stat->cycle_max_core_fit)
-                        stat->cycle_max_core_fit = stat->cpuidle_c2_fit;
-		if (stat->cpuidle_mem_ret_fit > stat->cycle_max_core_fit)
-			stat->cycle_max_core_fit = stat->cpuidle_mem_ret_fit;
+		if (stat->rates.cpuidle_c2_fit > stat->cycle_max_core_fit)
+                        stat->cycle_max_core_fit = stat->rates.cpuidle_c2_fit;
+		if (stat->rates.cpuidle_mem_ret_fit > stat->cycle_max_core_fit)
+			stat->cycle_max_core_fit = stat->rates.cpuidle_mem_ret_fit;
 	}
 #endif
 
-	stat->core_fit_acc += idle_time_diff[0] * stat->cur_core_fit
-			+ idle_time_diff[1] * stat->cpuidle_c1_fit
-			+ idle_time_diff[2] * stat->cpuidle_c2_fit
-			+ idle_time_diff[3] * stat->cpuidle_c2_fit;
-	stat->mem_fit_acc += idle_time_diff[0] * stat->cur_mem_fit
-			+ idle_time_diff[1] * stat->cur_mem_fit
-			+ idle_time_diff[2] * stat->cur_mem_fit
-			+ idle_time_diff[3] * stat->cpuidle_mem_ret_fit;
-
-	stat->core_pow_acc += idle_time_diff[0] * stat->cur_core_pow
-			+ idle_time_diff[1] * stat->cpuidle_c1_pow;
-	stat->mem_pow_acc += idle_time_diff[0] * stat->cur_mem_pow
-			+ idle_time_diff[1] * stat->cur_mem_pow
-			+ idle_time_diff[2] * stat->cur_mem_pow_l2_ret
-			+ idle_time_diff[3] * stat->cpuidle_mem_ret_pow;
+	// C0 rates scaled by the vulnerability factors
+	c0_core_fit = stat->rates.cur_core_fit;
+	c0_mem_fit = stat->rates.cur_mem_fit;
+	if (avf_mode != RE_PMU_OFF) {
+		cpufreq_re_avf_sample(stat, busy_diff);
+		c0_core_fit = (u64)c0_core_fit * stat->budget.avf_core >> 10;
+		c0_mem_fit -= stat->rates.cur_l1_fit
+			- ((u64)stat->rates.cur_l1_fit * stat->budget.avf_l1 >> 10);
+	}
+
+	re_core_account(&stat->acc, &stat->rates, idle_time_diff,
+			c0_core_fit, c0_mem_fit);
+	stat->wear_age += time_diff;
+	cpufreq_re_cgroup_set_rates(cpu, c0_core_fit + c0_mem_fit,
+			stat->rates.cur_core_pow + stat->rates.cur_mem_pow);
 
 	// C0 has no effect
-	stat->last_idle_state_time[0] = dev->states_usage[0].time;
-
-	// CORE FIT: cpuidle_c1_fit
-	// MEM FIT: cur_mem_fit
-	// CORE POW: cpuidle_c1_pow
-	// MEM POW: cur_mem_pow
-	stat->last_idle_state_time[1] = dev->states_usage[1].time;
-
-	// CORE FIT: 0
-	// MEM FIT: cur_mem_fit
-	// CORE POW: 0
-	// MEM POW: cur_mem_pow
-	stat->last_idle_state_time[2] = dev->states_usage[2].time;
-
-        // CORE FIT: 0
-        // MEM FIT: cpuidle_mem_ret_fit
-        // CORE POW: 0
-        // MEM POW: cpuidle_mem_ret_pow
-	stat->last_idle_state_time[3] = dev->states_usage[3].time;
+	// C1 CORE FIT: cpuidle_c1_fit
+	//    MEM FIT: cur_mem_fit
+	//    CORE POW: cpuidle_c1_pow
+	//    MEM POW: cur_mem_pow
+	// C2 CORE FIT: 0
+	//    MEM FIT: cur_mem_fit
+	//    CORE POW: 0
+	//    MEM POW: cur_mem_pow
+	// C3 CORE FIT: 0
+	//    MEM FIT: cpuidle_mem_ret_fit
+	//    CORE POW: 0
+	//    MEM POW: cpuidle_mem_ret_pow
+	for (i = 0; i < stat->cpuidle_state_num; i++)
+		stat->last_idle_state_time[i] = dev->states_usage[i].time;
 
 	stat->last_time = cur_time;
+	fit_delta = stat->acc.core_fit_acc + stat->acc.mem_fit_acc - fit_delta;
+	pow_delta = stat->acc.core_pow_acc + stat->acc.mem_pow_acc - pow_delta;
 	spin_unlock(&cpufreq_re_stats_lock);
+
+	cpufreq_re_cgroup_charge(cpu, fit_delta, pow_delta);
 	return 0;
 }
 
+/*
+ * Idle time per model class for the trace, polling time left out.
+ */
+static void cpufreq_re_trace_C_time(struct cpufreq_re_stats *stat)
+{
+	unsigned long long t[RE_CORE_IDLE_STATES];
+
+	re_platform_idle_times(&stat->plat, stat->last_idle_state_time, t);
+	pr_info("TR_LOG C_STATE TIME %s: %llu %llu %llu %llu\n", log_name,
+		t[0], t[1], t[2], t[3]);
+}
+
+/*
+ * Flush the accumulators of cpu, used by cpufreq_re_cgroup before
+ * reporting per-cgroup values.
+ */
+static int cpufreq_re_stats_sync(unsigned int cpu)
+{
+	if (!per_cpu(cpufreq_re_stats_table, cpu))
+		return 0;
+	return cpufreq_re_stats_update(cpu);
+}
+
 static ssize_t show_location_factor(struct cpufreq_policy *policy, char *buf)
 {
         struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, policy->cpu);
@@ -284,6 +562,9 @@ static ssize_t store_location_factor(struct cpufreq_policy *policy,
 	stat->location_factor = new_location_factor;
 	spin_lock(&cpufreq_re_stats_lock);
 	update_cur_fit(stat->cpu);
+#ifndef STATIC_POLICY
+	cpufreq_re_pareto_build(stat, per_cpu(cpufreq_re_fit_data_table, stat->cpu));
+#endif
 	cpufreq_re_report_FIT(stat->cpu);
         spin_unlock(&cpufreq_re_stats_lock);
 	return count;
@@ -294,7 +575,7 @@ static ssize_t show_cur_core_fit(struct cpufreq_policy *policy, char *buf)
         struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, policy->cpu);
         if (!stat)
                 return 0;
-        return sprintf(buf, "%d\n", stat->cur_core_fit);
+        return sprintf(buf, "%d\n", stat->rates.cur_core_fit);
 }
 
 static ssize_t show_cur_mem_fit(struct cpufreq_policy *policy, char *buf)
@@ -302,7 +583,7 @@ static ssize_t show_cur_mem_fit(struct cpufreq_policy *policy, char *buf)
         struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, policy->cpu);
         if (!stat)
                 return 0;
-        return sprintf(buf, "%d\n", stat->cur_mem_fit);
+        return sprintf(buf, "%d\n", stat->rates.cur_mem_fit);
 }
 
 static ssize_t show_core_fit_acc(struct cpufreq_policy *policy, char *buf)
@@ -311,7 +592,7 @@ static ssize_t show_core_fit_acc(struct cpufreq_policy *policy, char *buf)
         if (!stat)
                 return 0;
 	cpufreq_re_stats_update(stat->cpu);
-        return sprintf(buf, "%llu\n", stat->core_fit_acc);
+        return sprintf(buf, "%llu\n", stat->acc.core_fit_acc);
 }
 
 static ssize_t show_mem_fit_acc(struct cpufreq_policy *policy, char *buf)
@@ -320,7 +601,7 @@ static ssize_t show_mem_fit_acc(struct cpufreq_policy *policy, char *buf)
         if (!stat)
                 return 0;
 	cpufreq_re_stats_update(stat->cpu);
-        return sprintf(buf, "%llu\n", stat->mem_fit_acc);
+        return sprintf(buf, "%llu\n", stat->acc.mem_fit_acc);
 }
 
 static ssize_t show_core_pow_acc(struct cpufreq_policy *policy, char *buf)
@@ -329,7 +610,7 @@ static ssize_t show_core_pow_acc(struct cpufreq_policy *policy, char *buf)
         if (!stat)
                 return 0;
         cpufreq_re_stats_update(stat->cpu);
-        return sprintf(buf, "%llu\n", stat->core_pow_acc);
+        return sprintf(buf, "%llu\n", stat->acc.core_pow_acc);
 }
 
 static ssize_t show_mem_pow_acc(struct cpufreq_policy *policy, char *buf)
@@ -338,7 +619,7 @@ static ssize_t show_mem_pow_acc(struct cpufreq_policy *policy, char *buf)
         if (!stat)
                 return 0;
         cpufreq_re_stats_update(stat->cpu);
-        return sprintf(buf, "%llu\n", stat->mem_pow_acc);
+        return sprintf(buf, "%llu\n", stat->acc.mem_pow_acc);
 }
 
 static ssize_t show_cycle_max_core_fit(struct cpufreq_policy *policy, char *buf)
@@ -399,10 +680,38 @@ static ssize_t store_m3_iteration(struct cpufreq_policy *policy,
 static ssize_t show_m3_delay(struct cpufreq_policy *policy, char *buf)
 {
 	int ret;
+#if defined(CONFIG_SOC_AM33XX) || defined(CONFIG_ARCH_VEXPRESS)
 	ret = wkup_m3_ping_delay(mem_addr);
+#else
+	// no wkup_m3 on this platform
+	ret = -ENODEV;
+#endif
 	return sprintf(buf, "%d\n", ret);
 }
 
+// 0 off, 1 collect the wakeup histograms, 2 also apply them to cpuidle
+static ssize_t show_calib_mode(struct cpufreq_policy *policy, char *buf)
+{
+	return sprintf(buf, "%d\n", cpufreq_re_calib_get_mode());
+}
+
+static ssize_t store_calib_mode(struct cpufreq_policy *policy,
+					const char *buf, size_t count)
+{
+	int ret, mode;
+
+	ret = sscanf(buf, "%d", &mode);
+	if (ret != 1)
+		return -EINVAL;
+	ret = cpufreq_re_calib_set_mode(mode);
+	return ret ? ret : count;
+}
+
+static ssize_t show_calib_stats(struct cpufreq_policy *policy, char *buf)
+{
+	return cpufreq_re_calib_show(buf);
+}
+
 static ssize_t store_logging_state(struct cpufreq_policy *policy,
                                         const char *buf, size_t count)
 {
@@ -462,719 +771,1993 @@ static ssize_t show_logging_name(struct cpufreq_policy *policy, char *buf)
         return ret;
 }
 
-cpufreq_freq_attr_rw(location_factor);
-cpufreq_freq_attr_ro(cur_core_fit);
-cpufreq_freq_attr_ro(cur_mem_fit);
-cpufreq_freq_attr_ro(core_fit_acc);
-cpufreq_freq_attr_ro(mem_fit_acc);
-cpufreq_freq_attr_ro(core_pow_acc);
-cpufreq_freq_attr_ro(mem_pow_acc);
-cpufreq_freq_attr_ro(last_residency);
-cpufreq_freq_attr_rw(cycle_max_core_fit);
-cpufreq_freq_attr_rw(cycle_max_mem_fit);
-cpufreq_freq_attr_rw(m3_iteration);
-cpufreq_freq_attr_ro(m3_delay);
-cpufreq_freq_attr_rw(logging_state);
-cpufreq_freq_attr_rw(tracing_state);
-cpufreq_freq_attr_rw(logging_name);
-
-static struct attribute *default_attrs[] = {
-	&location_factor.attr,
-	&cur_core_fit.attr,
-	&cur_mem_fit.attr,
-	&core_fit_acc.attr,
-	&mem_fit_acc.attr,
-        &core_pow_acc.attr,
-        &mem_pow_acc.attr,
-	&cycle_max_core_fit.attr,
-	&cycle_max_mem_fit.attr,
-	&last_residency.attr,
-	&m3_iteration.attr,
-	&m3_delay.attr,
-	&logging_state.attr,
-	&tracing_state.attr,
-	&logging_name.attr,
-	NULL
-};
-static struct attribute_group stats_attr_group = {
-	.attrs = default_attrs,
-	.name = "re_stats"
-};
-
-static int freq_table_get_index(struct cpufreq_re_stats *stat, unsigned int freq)
+/*
+ * Accumulator state kept across cpu hotplug and exchanged with user
+ * space through the re_stats/state binary attribute, so that long
+ * horizon budgets survive hotplug, suspend and module reload.
+ */
+#define RE_STATE_MAGIC		0x53544652	/* "RFTS" */
+#define RE_STATE_VERSION	3
+
+struct cpufreq_re_state {
+	u32 magic;
+	u32 version;
+	u32 size;
+	u32 crc;			// crc32 of the fields below
+	u64 core_fit_acc;
+	u64 mem_fit_acc;
+	u64 core_pow_acc;
+	u64 mem_pow_acc;
+	u64 cycle_max_core_fit;
+	u64 cycle_max_mem_fit;
+	s64 core_budget_left;		// budget left in the running cycle
+	s64 mem_budget_left;
+	u64 budget_time_left;		// usec left in the running cycle
+	u64 suspend_time;		// usec spent in system suspend
+	s64 core_fit_bank;		// budget bank carried into the cycle
+	s64 mem_fit_bank;
+	u32 location_factor;
+	u32 epoch;
+	u64 wear_acc;			// lifetime aging stress
+	u64 wear_age;			// usec of life accounted
+} __packed;
+
+static DEFINE_PER_CPU(struct cpufreq_re_state, cpufreq_re_saved_state);
+static DEFINE_PER_CPU(int, cpufreq_re_saved_valid);
+
+static u32 cpufreq_re_state_crc(const struct cpufreq_re_state *state)
 {
-	int index;
-	for (index = 0; index < stat->max_state; index++)
-		if (stat->freq_table[index] == freq)
-			return index;
-	return -1;
+	return crc32_le(~0, (const u8 *)&state->core_fit_acc,
+			sizeof(*state) - offsetof(struct cpufreq_re_state,
+						core_fit_acc));
 }
 
-/* should be called late in the CPU removal sequence so that the stats
- * memory is still available in case someone tries to use it.
+/*
+ * Take a snapshot of stat. It should be called within
+ * cpufreq_re_stats_lock, after cpufreq_re_stats_update().
  */
-static void cpufreq_re_stats_free_table(unsigned int cpu)
+static void cpufreq_re_state_save(struct cpufreq_re_stats *stat,
+			struct cpufreq_re_state *state)
 {
-	struct cpufreq_re_fit_data * fit_data = per_cpu(cpufreq_re_fit_data_table, cpu);
-        struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, cpu);
-
-        if (stat) {
-                pr_debug("%s: Free stat table\n", __func__);
-                kfree(stat->freq_table);
-                kfree(stat);
-                per_cpu(cpufreq_re_stats_table, cpu) = NULL;
-        }
-
-	if (fit_data) {
-		pr_debug("%s: Free fit data table\n", __func__);
-		kfree(fit_data);
-		per_cpu(cpufreq_re_fit_data_table, cpu) = NULL;
-	}
+	unsigned long long cur_time = jiffies_to_usecs(get_jiffies_64());
+
+	memset(state, 0, sizeof(*state));
+	state->magic = RE_STATE_MAGIC;
+	state->version = RE_STATE_VERSION;
+	state->size = sizeof(*state);
+	state->core_fit_acc = stat->acc.core_fit_acc;
+	state->mem_fit_acc = stat->acc.mem_fit_acc;
+	state->core_pow_acc = stat->acc.core_pow_acc;
+	state->mem_pow_acc = stat->acc.mem_pow_acc;
+	state->cycle_max_core_fit = stat->cycle_max_core_fit;
+	state->cycle_max_mem_fit = stat->cycle_max_mem_fit;
+	state->suspend_time = stat->suspend_time;
+	state->location_factor = stat->location_factor;
+	state->wear_acc = stat->acc.wear_acc;
+	state->wear_age = stat->wear_age;
+#ifndef STATIC_POLICY
+	state->core_budget_left = (s64)(stat->budget.target_core_fit_acc
+				- stat->acc.core_fit_acc);
+	state->mem_budget_left = (s64)(stat->budget.target_mem_fit_acc
+				- stat->acc.mem_fit_acc);
+	if (stat->budget.stop_time > cur_time)
+		state->budget_time_left = stat->budget.stop_time - cur_time;
+	state->epoch = stat->epoch;
+	state->core_fit_bank = stat->budget.core_fit_bank;
+	state->mem_fit_bank = stat->budget.mem_fit_bank;
+#endif
+	state->crc = cpufreq_re_state_crc(state);
 }
 
-/* must be called early in the CPU removal sequence (before
- * cpufreq_remove_dev) so that policy is still valid.
+/*
+ * Add the history in state on top of what stat accumulated since it
+ * was created, shifting every baseline so that deltas stay intact.
+ * It should be called within cpufreq_re_stats_lock.
  */
-static void cpufreq_re_stats_free_sysfs(unsigned int cpu)
+static void cpufreq_re_state_restore(struct cpufreq_re_stats *stat,
+			const struct cpufreq_re_state *state)
 {
-	struct cpufreq_policy *policy = cpufreq_cpu_get(cpu);
+	struct cpufreq_re_log *log = per_cpu(cpufreq_re_log_table, stat->cpu);
+	unsigned long long cur_time = jiffies_to_usecs(get_jiffies_64());
+
+	stat->acc.core_fit_acc += state->core_fit_acc;
+	stat->acc.mem_fit_acc += state->mem_fit_acc;
+	stat->acc.core_pow_acc += state->core_pow_acc;
+	stat->acc.mem_pow_acc += state->mem_pow_acc;
+	if (state->cycle_max_core_fit > stat->cycle_max_core_fit)
+		stat->cycle_max_core_fit = state->cycle_max_core_fit;
+	if (state->cycle_max_mem_fit > stat->cycle_max_mem_fit)
+		stat->cycle_max_mem_fit = state->cycle_max_mem_fit;
+	stat->suspend_time += state->suspend_time;
+	stat->acc.wear_acc += state->wear_acc;
+	stat->wear_age += state->wear_age;
+	if (state->location_factor)
+		stat->location_factor = state->location_factor;
+#ifndef STATIC_POLICY
+	stat->epoch_core_fit_acc += state->core_fit_acc;
+	stat->epoch_mem_fit_acc += state->mem_fit_acc;
+	stat->epoch_core_pow_acc += state->core_pow_acc;
+	stat->epoch_mem_pow_acc += state->mem_pow_acc;
+	if (state->budget_time_left) {
+		// resume the interrupted cycle where it stopped
+		stat->budget.target_core_fit_acc = stat->acc.core_fit_acc
+				+ state->core_budget_left;
+		stat->budget.target_mem_fit_acc = stat->acc.mem_fit_acc
+				+ state->mem_budget_left;
+		stat->budget.stop_time = cur_time + state->budget_time_left;
+	} else {
+		stat->budget.target_core_fit_acc += state->core_fit_acc;
+		stat->budget.target_mem_fit_acc += state->mem_fit_acc;
+	}
+	stat->epoch += state->epoch;
+	if (!state->budget_time_left) {
+		stat->budget.target_core_fit_acc += state->core_fit_bank
+				- stat->budget.core_fit_bank;
+		stat->budget.target_mem_fit_acc += state->mem_fit_bank
+				- stat->budget.mem_fit_bank;
+	}
+	stat->budget.core_fit_bank = state->core_fit_bank;
+	stat->budget.mem_fit_bank = state->mem_fit_bank;
+#endif
+	if (log) {
+		log->last_pow += state->core_pow_acc + state->mem_pow_acc;
+		log->last_core_fit += state->core_fit_acc;
+		log->last_mem_fit += state->mem_fit_acc;
+	}
+}
 
-	if (!policy)
-		return;
+static int cpufreq_re_state_valid(const struct cpufreq_re_state *state)
+{
+	if (state->magic != RE_STATE_MAGIC ||
+	    state->version != RE_STATE_VERSION ||
+	    state->size != sizeof(*state))
+		return 0;
+	return state->crc == cpufreq_re_state_crc(state);
+}
 
-	if (!cpufreq_frequency_get_table(cpu))
-		goto put_ref;
+static ssize_t read_state(struct file *filp, struct kobject *kobj,
+			struct bin_attribute *attr, char *buf,
+			loff_t off, size_t count)
+{
+	struct cpufreq_policy *policy = container_of(kobj,
+				struct cpufreq_policy, kobj);
+	struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, policy->cpu);
+	struct cpufreq_re_state state;
 
-	if (!policy_is_shared(policy)) {
-		pr_debug("%s: Free sysfs stat\n", __func__);
-		sysfs_remove_group(&policy->kobj, &stats_attr_group);
-	}
+	if (!stat)
+		return -ENODEV;
+	if (off >= sizeof(state))
+		return 0;
+	if (count > sizeof(state) - off)
+		count = sizeof(state) - off;
 
-put_ref:
-	cpufreq_cpu_put(policy);
+	cpufreq_re_stats_update(stat->cpu);
+	spin_lock(&cpufreq_re_stats_lock);
+	cpufreq_re_state_save(stat, &state);
+	spin_unlock(&cpufreq_re_stats_lock);
+	memcpy(buf, (char *)&state + off, count);
+	return count;
 }
 
-static int cpufreq_re_stats_create_table(struct cpufreq_policy *policy,
-		struct cpufreq_frequency_table *table)
+static ssize_t write_state(struct file *filp, struct kobject *kobj,
+			struct bin_attribute *attr, char *buf,
+			loff_t off, size_t count)
 {
-	unsigned int i, j, count = 0, ret = 0, idle_state_count = 0;
-	struct cpufreq_re_stats *stat;
-	struct cpuidle_device *dev;
-	struct cpufreq_policy *current_policy;
-	struct cpufreq_re_fit_data * fit_data;
-	unsigned int alloc_size;
-	unsigned int cpu = policy->cpu;
+	struct cpufreq_policy *policy = container_of(kobj,
+				struct cpufreq_policy, kobj);
+	struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, policy->cpu);
+	struct cpufreq_re_state state;
 
-	// first obtain the fit rate data
-	if (per_cpu(cpufreq_re_fit_data_table, cpu))
+	if (!stat)
+		return -ENODEV;
+	// the blob has to be written in one go
+	if (off != 0 || count != sizeof(state))
+		return -EINVAL;
+	memcpy(&state, buf, sizeof(state));
+	if (!cpufreq_re_state_valid(&state))
+		return -EINVAL;
+	if (stat->state_restored)
 		return -EBUSY;
-	fit_data = kzalloc(sizeof(*fit_data), GFP_KERNEL);
-	if ((fit_data) == NULL)
-		return -ENOMEM;
-	import_fit_data(fit_data, cpu);
-	per_cpu(cpufreq_re_fit_data_table, cpu) = fit_data;
 
-	if (per_cpu(cpufreq_re_stats_table, cpu))
-		return -EBUSY;
-	stat = kzalloc(sizeof(*stat), GFP_KERNEL);
-	if ((stat) == NULL)
-		return -ENOMEM;
+	cpufreq_re_stats_update(stat->cpu);
+	spin_lock(&cpufreq_re_stats_lock);
+	cpufreq_re_state_restore(stat, &state);
+	stat->state_restored = 1;
+	update_cur_fit(stat->cpu);
+	spin_unlock(&cpufreq_re_stats_lock);
+	return count;
+}
 
-	current_policy = cpufreq_cpu_get(cpu);
-	if (current_policy == NULL) {
-		ret = -EINVAL;
-		goto error_get_fail;
+static struct bin_attribute state_attr = {
+	.attr = { .name = "state", .mode = 0600 },
+	.size = sizeof(struct cpufreq_re_state),
+	.read = read_state,
+	.write = write_state,
+};
+
+/*
+ * System suspend is invisible to jiffies and cpuidle, so the residency
+ * is measured from the boot time clock and charged at the deepest
+ * (retention) rates. The budget earned over the same time is added so
+ * that the running cycle is neither stretched nor cut.
+ */
+static struct timespec cpufreq_re_suspend_boottime;
+
+static int cpufreq_re_stats_suspend(void)
+{
+	unsigned int cpu;
+
+	for_each_online_cpu(cpu) {
+		if (per_cpu(cpufreq_re_stats_table, cpu))
+			cpufreq_re_stats_update(cpu);
 	}
+	get_monotonic_boottime(&cpufreq_re_suspend_boottime);
+	return 0;
+}
 
-	ret = sysfs_create_group(&current_policy->kobj, &stats_attr_group);
-	if (ret)
-		goto error_out;
+/*
+ * Only the boot cpu is online during syscore resume. The other cpus
+ * went down through the _FROZEN hotplug actions, which leave their
+ * tables in place, so every table is charged here. The time a cpu was
+ * down before and after the suspend is left to its first update once
+ * it is back.
+ */
+static void cpufreq_re_stats_resume(void)
+{
+	struct cpufreq_re_stats *stat;
+	struct timespec now, delta;
+	unsigned long long jiffies_time;
+	u64 suspend_time, t;
+	unsigned int cpu;
 
-	stat->cpu = cpu;
-	per_cpu(cpufreq_re_stats_table, cpu) = stat;
-	dev = per_cpu(cpuidle_devices, cpu);
+	get_monotonic_boottime(&now);
+	delta = timespec_sub(now, cpufreq_re_suspend_boottime);
+	if (delta.tv_sec < 0)
+		return;
+	suspend_time = (u64)delta.tv_sec * USEC_PER_SEC
+			+ delta.tv_nsec / NSEC_PER_USEC;
+	jiffies_time = jiffies_to_usecs(get_jiffies_64());
 
-	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
-		unsigned int freq = table[i].frequency;
-		if (freq == CPUFREQ_ENTRY_INVALID)
+	for_each_possible_cpu(cpu) {
+		stat = per_cpu(cpufreq_re_stats_table, cpu);
+		if (!stat)
 			continue;
-		count++;
+		spin_lock(&cpufreq_re_stats_lock);
+		// whatever jiffies saw is accounted as C0/idle by the next update
+		t = suspend_time;
+		if (jiffies_time > stat->last_time)
+			t -= min_t(u64, t, jiffies_time - stat->last_time);
+		stat->acc.core_fit_acc += t * stat->rates.cpuidle_c2_fit;
+		stat->acc.mem_fit_acc += t * stat->rates.cpuidle_mem_ret_fit;
+		stat->acc.mem_pow_acc += t * stat->rates.cpuidle_mem_ret_pow;
+		stat->acc.wear_acc += t * stat->rates.cpuidle_ret_wear;
+		stat->wear_age += t;
+		stat->suspend_time += t;
+#ifndef STATIC_POLICY
+		stat->budget.target_core_fit_acc += t * stat->budget.core_fit_target;
+		stat->budget.target_mem_fit_acc += t * stat->budget.mem_fit_target;
+#endif
+		spin_unlock(&cpufreq_re_stats_lock);
 	}
+}
 
-	if (dev) {
-		idle_state_count = dev->state_count;
-		stat->cpuidle_state_num = idle_state_count;
-	}
+static struct syscore_ops cpufreq_re_syscore_ops = {
+	.suspend = cpufreq_re_stats_suspend,
+	.resume = cpufreq_re_stats_resume,
+};
 
-	alloc_size = count * sizeof(int) + 
-			idle_state_count * sizeof(unsigned long long) + 
-			idle_state_count * sizeof(unsigned long long);
-	stat->max_state = count;
-	stat->freq_table = kzalloc(alloc_size, GFP_KERNEL);
-	if (!stat->freq_table) {
-		ret = -ENOMEM;
-		goto error_out;
-	}
-	stat->last_idle_state_usage = (unsigned long long*)(stat->freq_table + count);
-        stat->last_idle_state_time = (unsigned long long *)(stat->last_idle_state_usage + count);
+static ssize_t show_policy(struct cpufreq_policy *policy, char *buf)
+{
+	return cpufreq_re_policy_show(buf);
+}
 
-	j = 0;
-	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
-		unsigned int freq = table[i].frequency;
-		if (freq == CPUFREQ_ENTRY_INVALID)
-			continue;
-		if (freq_table_get_index(stat, freq) == -1)
-			stat->freq_table[j++] = freq;
-	}
-	stat->state_num = j;
-	spin_lock(&cpufreq_re_stats_lock);
-        for (i = 0; i < stat->cpuidle_state_num; i++) {
-                stat->last_idle_state_time[i] = dev->states_usage[i].time;
-		stat->last_idle_state_usage[i] = dev->states_usage[i].usage;
-        }
-	stat->last_time = jiffies_to_usecs(get_jiffies_64());
-	stat->last_index = freq_table_get_index(stat, policy->cur);
-	stat->location_factor = 100;
-	stat->core_fit_acc = 0;
-	stat->mem_fit_acc = 0;
-        stat->core_pow_acc = 0;
-        stat->mem_pow_acc = 0;
-	update_cur_fit(stat->cpu);
-	if (fit_data->core_fit_c2 > fit_data->core_fit[4])
-		stat->core_fit_target = fit_data->core_fit_c2 * TARGET_FACTOR / 10;
-	else
-		stat->core_fit_target = fit_data->core_fit[4] * TARGET_FACTOR / 10;
-        stat->mem_fit_target = (fit_data->L1_mem_fit_ret[4] + fit_data->L2_mem_fit_ret) 
-				* TARGET_FACTOR / 10;
-	printk("fit_target are: %d %d\n", stat->core_fit_target, stat->mem_fit_target);
+static ssize_t store_policy(struct cpufreq_policy *policy,
+                                        const char *buf, size_t count)
+{
+	char name[RE_POLICY_NAME_LEN];
+	int ret;
+
+	if (sscanf(buf, "%15s", name) != 1)
+		return -EINVAL;
+	ret = cpufreq_re_select_policy(name);
+	return ret ? ret : count;
+}
+
+static ssize_t show_policy_stats(struct cpufreq_policy *policy, char *buf)
+{
+	return cpufreq_re_policy_show_stats(buf);
+}
+
+/*
+ * controller_mode selects the threshold, pi or pareto policy by number,
+ * it reads -1 when another policy is active
+ */
+static ssize_t show_controller_mode(struct cpufreq_policy *policy, char *buf)
+{
+	const char *name = cpufreq_re_policy_name();
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(re_ctrl_policy); i++)
+		if (!strcmp(name, re_ctrl_policy[i]))
+			return sprintf(buf, "%d\n", i);
+	return sprintf(buf, "-1\n");
+}
+
+static ssize_t store_controller_mode(struct cpufreq_policy *policy,
+                                        const char *buf, size_t count)
+{
+	int new_mode, ret;
+
+	if (sscanf(buf, "%d", &new_mode) != 1 ||
+	    new_mode < RE_CTRL_THRESHOLD || new_mode > RE_CTRL_PARETO)
+		return -EINVAL;
+	ret = cpufreq_re_select_policy(re_ctrl_policy[new_mode]);
+	return ret ? ret : count;
+}
+
+/*
+ * energy_cap_mode 1 (energy only) is the "energy" policy with the cap
+ * on, 2 keeps the current policy under the cap
+ */
+static ssize_t show_energy_cap_mode(struct cpufreq_policy *policy, char *buf)
+{
+	return sprintf(buf, "%d\n", energy_cap_mode);
+}
+
+static ssize_t store_energy_cap_mode(struct cpufreq_policy *policy,
+                                        const char *buf, size_t count)
+{
+	int val, ret = 0;
+
+	if (sscanf(buf, "%d", &val) != 1 || val < RE_ENERGY_OFF ||
+	    val > RE_ENERGY_JOINT)
+		return -EINVAL;
+	if (val == RE_ENERGY_ONLY)
+		ret = cpufreq_re_select_policy("energy");
+	else if (energy_cap_mode == RE_ENERGY_ONLY &&
+		 !strcmp(cpufreq_re_policy_name(), "energy"))
+		ret = cpufreq_re_select_policy("threshold");
+	if (ret)
+		return ret;
+	energy_cap_mode = val;
+	return count;
+}
+
+#define re_stats_tunable(name, min, max)				\
+static ssize_t show_##name(struct cpufreq_policy *policy, char *buf)	\
+{									\
+	return sprintf(buf, "%d\n", name);				\
+}									\
+static ssize_t store_##name(struct cpufreq_policy *policy,		\
+				const char *buf, size_t count)		\
+{									\
+	int val;							\
+	if (sscanf(buf, "%d", &val) != 1 || val < (min) || val > (max))	\
+		return -EINVAL;						\
+	name = val;							\
+	return count;							\
+}
+
+re_stats_tunable(bank_cap, 0, 1000)
+re_stats_tunable(power_cap, 0, INT_MAX)
+re_stats_tunable(dwell_time, 0, 10000000)
+re_stats_tunable(dwell_cost, 0, 1000)
+re_stats_tunable(hysteresis, 0, 100)
+re_stats_tunable(avf_floor, 0, 1024)
+re_stats_tunable(wear_life, 0, 200000)
+re_stats_tunable(wear_target, 1, 1000)
+re_stats_tunable(wear_schedule, RE_WEAR_LINEAR, RE_WEAR_FRONT)
+re_stats_tunable(avf_sw_ipc, 0, RE_AVF_IPC_PEAK)
+re_stats_tunable(avf_sw_refill, 0, 1000)
+re_stats_tunable(pi_kp, 0, 4096)
+re_stats_tunable(pi_ki, 0, 4096)
+re_stats_tunable(pi_alpha, 1, 256)
+
+static ssize_t show_core_fit_bank(struct cpufreq_policy *policy, char *buf)
+{
+        struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, policy->cpu);
+        if (!stat)
+                return 0;
+#ifndef STATIC_POLICY
+        return sprintf(buf, "%lld\n", stat->budget.core_fit_bank);
+#else
+	return sprintf(buf, "0\n");
+#endif
+}
+
+static ssize_t show_mem_fit_bank(struct cpufreq_policy *policy, char *buf)
+{
+        struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, policy->cpu);
+        if (!stat)
+                return 0;
 #ifndef STATIC_POLICY
-        stat->budget_stop_time = jiffies_to_usecs(get_jiffies_64()) + ((int)(1000000/DYN_FREQ));
-	stat->budget_target_core_fit_acc = stat->core_fit_acc 
-			+ stat->core_fit_target * ((int)(1000000/DYN_FREQ));
-	stat->budget_target_mem_fit_acc = stat->mem_fit_acc
-			+ stat->mem_fit_target * ((int)(1000000/DYN_FREQ)); 
+        return sprintf(buf, "%lld\n", stat->budget.mem_fit_bank);
+#else
+	return sprintf(buf, "0\n");
 #endif
-	spin_unlock(&cpufreq_re_stats_lock);
-	log_thread_init(stat->cpu);
+}
 
-	if (stat->last_index == -1) {
-		pr_err("%s: No match for current freq %u in table. Disabled!\n",
-		       __func__, policy->cur);
-		ret = -EINVAL;
-		goto error_out;
+/*
+ * Frontier of the current utilization bucket, one point per line as
+ * "P-state C-state core_fit mem_fit pow", the active choice marked '*'
+ */
+static ssize_t show_pareto(struct cpufreq_policy *policy, char *buf)
+{
+	struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, policy->cpu);
+	ssize_t len = 0;
+#ifndef STATIC_POLICY
+	struct cpufreq_re_pareto_point *pt;
+	int i;
+#endif
+
+	if (!stat)
+		return 0;
+#ifndef STATIC_POLICY
+	spin_lock(&cpufreq_re_stats_lock);
+	len += sprintf(buf + len, "bucket %d\n", stat->pareto_bucket);
+	for (i = 0; i < stat->pareto.count[stat->pareto_bucket]; i++) {
+		pt = &stat->pareto.point[stat->pareto_bucket][i];
+		len += sprintf(buf + len, "%c%u %u %u %u %u\n",
+			(i == stat->pareto_choice) ? '*' : ' ',
+			pt->p_state, pt->c_state,
+			pt->core_fit, pt->mem_fit, pt->pow);
 	}
+	spin_unlock(&cpufreq_re_stats_lock);
+#endif
+	return len;
+}
 
-	cpufreq_cpu_put(current_policy);
-	return 0;
-error_out:
-	cpufreq_cpu_put(current_policy);
-error_get_fail:
-	kfree(stat);
-	per_cpu(cpufreq_re_stats_table, cpu) = NULL;
-	return ret;
+static ssize_t show_qos_publish(struct cpufreq_policy *policy, char *buf)
+{
+	return sprintf(buf, "%d\n", qos_publish);
 }
 
-static void cpufreq_re_stats_update_policy_cpu(struct cpufreq_policy *policy)
+static ssize_t store_qos_publish(struct cpufreq_policy *policy,
+				const char *buf, size_t count)
 {
-	struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table,
-			policy->last_cpu);
+	struct cpufreq_re_stats *stat;
+	unsigned int cpu;
+	int val;
 
-	pr_debug("Updating stats_table for new_cpu %u from last_cpu %u\n",
-			policy->cpu, policy->last_cpu);
-	per_cpu(cpufreq_re_stats_table, policy->cpu) = per_cpu(cpufreq_re_stats_table,
-			policy->last_cpu);
-	per_cpu(cpufreq_re_stats_table, policy->last_cpu) = NULL;
-	stat->cpu = policy->cpu;
+	if (sscanf(buf, "%d", &val) != 1 || val < 0 || val > 1)
+		return -EINVAL;
+	qos_publish = val;
+	// republish from scratch on the next idle entries
+	for_each_online_cpu(cpu) {
+		stat = per_cpu(cpufreq_re_stats_table, cpu);
+		if (stat)
+			stat->qos_constraint = PM_QOS_CPU_DMA_LAT_DEFAULT_VALUE;
+	}
+	schedule_work(&cpufreq_re_qos_work);
+	return count;
 }
 
-static int cpufreq_re_stat_notifier_policy(struct notifier_block *nb,
-		unsigned long val, void *data)
+// PMU backend of the vulnerability factors, see cpufreq_re_pmu.h
+static ssize_t show_avf_mode(struct cpufreq_policy *policy, char *buf)
 {
-	int ret;
-	struct cpufreq_policy *policy = data;
-	struct cpufreq_frequency_table *table;
-	unsigned int cpu = policy->cpu;
+	return sprintf(buf, "%d\n", avf_mode);
+}
 
-	if (val == CPUFREQ_UPDATE_POLICY_CPU) {
-		cpufreq_re_stats_update_policy_cpu(policy);
-		return 0;
+static ssize_t store_avf_mode(struct cpufreq_policy *policy,
+				const char *buf, size_t count)
+{
+	struct cpufreq_re_stats *stat;
+	unsigned int cpu;
+	int val, ret;
+
+	if (sscanf(buf, "%d", &val) != 1 || val < RE_PMU_OFF || val > RE_PMU_SW)
+		return -EINVAL;
+	if (val == avf_mode)
+		return count;
+	ret = cpufreq_re_pmu_start(val);
+	if (ret)
+		return ret;
+	cpufreq_re_pmu_stop(avf_mode);
+	spin_lock(&cpufreq_re_stats_lock);
+	avf_mode = val;
+	// new baseline on the next sample, raw rates until then
+	for_each_online_cpu(cpu) {
+		stat = per_cpu(cpufreq_re_stats_table, cpu);
+		if (!stat)
+			continue;
+		stat->avf_primed = 0;
+		stat->budget.avf_core = 1024;
+		stat->budget.avf_l1 = 1024;
 	}
+	spin_unlock(&cpufreq_re_stats_lock);
+	return count;
+}
 
-	if (val != CPUFREQ_NOTIFY)
+static ssize_t show_avf_stats(struct cpufreq_policy *policy, char *buf)
+{
+	struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, policy->cpu);
+
+	if (!stat)
 		return 0;
-	table = cpufreq_frequency_get_table(cpu);
-	if (!table)
+	return sprintf(buf, "%u %u %u %u %u\n", stat->budget.avf_core, stat->budget.avf_l1,
+			stat->avf_ipc, stat->avf_refill, stat->avf_samples);
+}
+
+static ssize_t show_wear_stats(struct cpufreq_policy *policy, char *buf)
+{
+	struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, policy->cpu);
+	u64 allowed = 0;
+
+	if (!stat)
 		return 0;
-	ret = cpufreq_re_stats_create_table(policy, table);
-	if (ret)
-		return ret;
-	return 0;
+	cpufreq_re_stats_update(stat->cpu);
+#ifndef STATIC_POLICY
+	if (wear_life)
+		allowed = cpufreq_re_wear_allowed(stat->wear_age);
+#endif
+	return sprintf(buf, "%llu %llu %llu %d %u\n", stat->acc.wear_acc, allowed,
+			div_u64(stat->wear_age, USEC_PER_SEC),
+			stat->last_wear_ceiling == INT_MAX ?
+				-1 : stat->last_wear_ceiling,
+			stat->wear_conflicts);
 }
 
-static int cpufreq_re_stat_notifier_trans(struct notifier_block *nb,
-		unsigned long val, void *data)
+/*
+ * "conflicts borrowed_fit published_latency_us"
+ */
+static ssize_t show_qos_stats(struct cpufreq_policy *policy, char *buf)
 {
-	struct cpufreq_freqs *freq = data;
-	struct cpufreq_re_stats *stat;
-	int old_index, new_index;
+	struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, policy->cpu);
 
-	if (val != CPUFREQ_POSTCHANGE)
+	if (!stat)
 		return 0;
+	return sprintf(buf, "%u %llu %d\n", stat->qos_conflicts,
+			stat->qos_borrowed_fit, stat->qos_constraint);
+}
+
+/*
+ * "transitions usec energy avg_usec floor_changes"
+ */
+static ssize_t show_transition_stats(struct cpufreq_policy *policy, char *buf)
+{
+	struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, policy->cpu);
+	unsigned int floor_changes = 0;
 
-	stat = per_cpu(cpufreq_re_stats_table, freq->cpu);
 	if (!stat)
 		return 0;
+#ifndef STATIC_POLICY
+	floor_changes = stat->floor_changes;
+#endif
+	return sprintf(buf, "%u %llu %llu %u %u\n", stat->transitions,
+			stat->transition_time, stat->transition_energy,
+			stat->avg_transition_time, floor_changes);
+}
 
-	old_index = stat->last_index;
-	new_index = freq_table_get_index(stat, freq->new);
+static ssize_t show_energy_conflicts(struct cpufreq_policy *policy, char *buf)
+{
+        struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, policy->cpu);
+        if (!stat)
+                return 0;
+        return sprintf(buf, "%u\n", stat->energy_conflicts);
+}
 
-	/* We can't do stat->time_in_state[-1]= .. */
-	if (old_index == -1 || new_index == -1)
+static ssize_t show_suspend_time(struct cpufreq_policy *policy, char *buf)
+{
+        struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, policy->cpu);
+        if (!stat)
+                return 0;
+        return sprintf(buf, "%llu\n", stat->suspend_time);
+}
+
+static ssize_t show_platform(struct cpufreq_policy *policy, char *buf)
+{
+	struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, policy->cpu);
+
+	if (!stat)
 		return 0;
+	return re_platform_show(&stat->plat, stat->freq_table, buf);
+}
 
-	cpufreq_re_stats_update(freq->cpu);
+cpufreq_freq_attr_rw(location_factor);
+cpufreq_freq_attr_ro(cur_core_fit);
+cpufreq_freq_attr_ro(cur_mem_fit);
+cpufreq_freq_attr_ro(core_fit_acc);
+cpufreq_freq_attr_ro(mem_fit_acc);
+cpufreq_freq_attr_ro(core_pow_acc);
+cpufreq_freq_attr_ro(mem_pow_acc);
+cpufreq_freq_attr_ro(last_residency);
+cpufreq_freq_attr_rw(cycle_max_core_fit);
+cpufreq_freq_attr_rw(cycle_max_mem_fit);
+cpufreq_freq_attr_rw(m3_iteration);
+cpufreq_freq_attr_ro(m3_delay);
+cpufreq_freq_attr_rw(calib_mode);
+cpufreq_freq_attr_ro(calib_stats);
+cpufreq_freq_attr_rw(logging_state);
+cpufreq_freq_attr_rw(tracing_state);
+cpufreq_freq_attr_rw(logging_name);
+cpufreq_freq_attr_ro(suspend_time);
+cpufreq_freq_attr_rw(controller_mode);
+cpufreq_freq_attr_rw(policy);
+cpufreq_freq_attr_ro(policy_stats);
+cpufreq_freq_attr_rw(bank_cap);
+cpufreq_freq_attr_ro(core_fit_bank);
+cpufreq_freq_attr_ro(mem_fit_bank);
+cpufreq_freq_attr_rw(energy_cap_mode);
+cpufreq_freq_attr_rw(power_cap);
+cpufreq_freq_attr_ro(energy_conflicts);
+cpufreq_freq_attr_rw(dwell_time);
+cpufreq_freq_attr_rw(dwell_cost);
+cpufreq_freq_attr_rw(hysteresis);
+cpufreq_freq_attr_ro(transition_stats);
+cpufreq_freq_attr_rw(qos_publish);
+cpufreq_freq_attr_ro(qos_stats);
+cpufreq_freq_attr_rw(avf_mode);
+cpufreq_freq_attr_rw(avf_floor);
+cpufreq_freq_attr_rw(avf_sw_ipc);
+cpufreq_freq_attr_rw(avf_sw_refill);
+cpufreq_freq_attr_ro(avf_stats);
+cpufreq_freq_attr_rw(wear_life);
+cpufreq_freq_attr_rw(wear_target);
+cpufreq_freq_attr_rw(wear_schedule);
+cpufreq_freq_attr_ro(wear_stats);
+cpufreq_freq_attr_ro(pareto);
+cpufreq_freq_attr_rw(pi_kp);
+cpufreq_freq_attr_rw(pi_ki);
+cpufreq_freq_attr_rw(pi_alpha);
+cpufreq_freq_attr_ro(platform);
+
+static struct attribute *default_attrs[] = {
+	&location_factor.attr,
+	&cur_core_fit.attr,
+	&cur_mem_fit.attr,
+	&core_fit_acc.attr,
+	&mem_fit_acc.attr,
+        &core_pow_acc.attr,
+        &mem_pow_acc.attr,
+	&cycle_max_core_fit.attr,
+	&cycle_max_mem_fit.attr,
+	&last_residency.attr,
+	&m3_iteration.attr,
+	&m3_delay.attr,
+	&calib_mode.attr,
+	&calib_stats.attr,
+	&logging_state.attr,
+	&tracing_state.attr,
+	&logging_name.attr,
+	&suspend_time.attr,
+	&controller_mode.attr,
+	&policy.attr,
+	&policy_stats.attr,
+	&bank_cap.attr,
+	&core_fit_bank.attr,
+	&mem_fit_bank.attr,
+	&energy_cap_mode.attr,
+	&power_cap.attr,
+	&energy_conflicts.attr,
+	&dwell_time.attr,
+	&dwell_cost.attr,
+	&hysteresis.attr,
+	&transition_stats.attr,
+	&qos_publish.attr,
+	&qos_stats.attr,
+	&avf_mode.attr,
+	&avf_floor.attr,
+	&avf_sw_ipc.attr,
+	&avf_sw_refill.attr,
+	&avf_stats.attr,
+	&wear_life.attr,
+	&wear_target.attr,
+	&wear_schedule.attr,
+	&wear_stats.attr,
+	&pareto.attr,
+	&pi_kp.attr,
+	&pi_ki.attr,
+	&pi_alpha.attr,
+	&platform.attr,
+	NULL
+};
+static struct bin_attribute *default_bin_attrs[] = {
+	&state_attr,
+	NULL
+};
+static struct attribute_group stats_attr_group = {
+	.attrs = default_attrs,
+	.bin_attrs = default_bin_attrs,
+	.name = "re_stats"
+};
+
+static int freq_table_get_index(struct cpufreq_re_stats *stat, unsigned int freq)
+{
+	int index;
+	for (index = 0; index < stat->max_state; index++)
+		if (stat->freq_table[index] == freq)
+			return index;
+	return -1;
+}
+
+/* should be called late in the CPU removal sequence so that the stats
+ * memory is still available in case someone tries to use it.
+ */
+static void cpufreq_re_stats_free_table(unsigned int cpu)
+{
+	struct cpufreq_re_fit_data * fit_data = per_cpu(cpufreq_re_fit_data_table, cpu);
+        struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, cpu);
+
+        if (stat) {
+		// keep the history for when the cpu comes back
+		cpufreq_re_stats_update(cpu);
+		spin_lock(&cpufreq_re_stats_lock);
+		cpufreq_re_state_save(stat, &per_cpu(cpufreq_re_saved_state, cpu));
+		per_cpu(cpufreq_re_saved_valid, cpu) = 1;
+		spin_unlock(&cpufreq_re_stats_lock);
+                pr_debug("%s: Free stat table\n", __func__);
+                kfree(stat->freq_table);
+		re_platform_free(&stat->plat);
+                kfree(stat);
+                per_cpu(cpufreq_re_stats_table, cpu) = NULL;
+        }
+
+	if (fit_data) {
+		pr_debug("%s: Free fit data table\n", __func__);
+		kfree(fit_data);
+		per_cpu(cpufreq_re_fit_data_table, cpu) = NULL;
+	}
+}
+
+/* must be called early in the CPU removal sequence (before
+ * cpufreq_remove_dev) so that policy is still valid.
+ */
+static void cpufreq_re_stats_free_sysfs(unsigned int cpu)
+{
+	struct cpufreq_policy *policy = cpufreq_cpu_get(cpu);
+
+	if (!policy)
+		return;
+
+	if (!cpufreq_frequency_get_table(cpu))
+		goto put_ref;
+
+	if (!policy_is_shared(policy)) {
+		pr_debug("%s: Free sysfs stat\n", __func__);
+		sysfs_remove_group(&policy->kobj, &stats_attr_group);
+	}
+
+put_ref:
+	cpufreq_cpu_put(policy);
+}
+
+static int cpufreq_re_stats_create_table(struct cpufreq_policy *policy,
+		struct cpufreq_frequency_table *table)
+{
+	unsigned int i, j, count = 0, ret = 0, idle_state_count = 0;
+	struct cpufreq_re_stats *stat;
+	struct cpuidle_device *dev;
+	struct cpufreq_policy *current_policy;
+	struct cpufreq_re_fit_data * fit_data;
+	unsigned int alloc_size;
+	unsigned int cpu = policy->cpu;
+
+	// first obtain the fit rate data
+	if (per_cpu(cpufreq_re_fit_data_table, cpu))
+		return -EBUSY;
+	fit_data = kzalloc(sizeof(*fit_data), GFP_KERNEL);
+	if ((fit_data) == NULL)
+		return -ENOMEM;
+	import_fit_data(fit_data, cpu);
+	per_cpu(cpufreq_re_fit_data_table, cpu) = fit_data;
+
+	if (per_cpu(cpufreq_re_stats_table, cpu))
+		return -EBUSY;
+	stat = kzalloc(sizeof(*stat), GFP_KERNEL);
+	if ((stat) == NULL)
+		return -ENOMEM;
+
+	current_policy = cpufreq_cpu_get(cpu);
+	if (current_policy == NULL) {
+		ret = -EINVAL;
+		goto error_get_fail;
+	}
+
+	ret = sysfs_create_group(&current_policy->kobj, &stats_attr_group);
+	if (ret)
+		goto error_out;
+
+	stat->cpu = cpu;
+	per_cpu(cpufreq_re_stats_table, cpu) = stat;
+	dev = per_cpu(cpuidle_devices, cpu);
+
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		unsigned int freq = table[i].frequency;
+		if (freq == CPUFREQ_ENTRY_INVALID)
+			continue;
+		count++;
+	}
+
+	if (dev) {
+		idle_state_count = dev->state_count;
+		stat->cpuidle_state_num = idle_state_count;
+	}
+
+	alloc_size = count * sizeof(int) + 
+			idle_state_count * sizeof(unsigned long long) + 
+			idle_state_count * sizeof(unsigned long long);
+	stat->max_state = count;
+	stat->freq_table = kzalloc(alloc_size, GFP_KERNEL);
+	if (!stat->freq_table) {
+		ret = -ENOMEM;
+		goto error_remove_group;
+	}
+	stat->last_idle_state_usage = (unsigned long long*)(stat->freq_table + count);
+	stat->last_idle_state_time = stat->last_idle_state_usage + idle_state_count;
+
+	j = 0;
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		unsigned int freq = table[i].frequency;
+		if (freq == CPUFREQ_ENTRY_INVALID)
+			continue;
+		if (freq_table_get_index(stat, freq) == -1)
+			stat->freq_table[j++] = freq;
+	}
+	stat->state_num = j;
+	ret = re_platform_map_freq(&stat->plat, stat->freq_table, j, table);
+	if (ret)
+		goto error_free_table;
+	if (dev)
+		re_platform_map_idle(&stat->plat, cpuidle_get_cpu_driver(dev));
+	spin_lock(&cpufreq_re_stats_lock);
+        for (i = 0; i < stat->cpuidle_state_num; i++) {
+                stat->last_idle_state_time[i] = dev->states_usage[i].time;
+		stat->last_idle_state_usage[i] = dev->states_usage[i].usage;
+        }
+	stat->last_time = jiffies_to_usecs(get_jiffies_64());
+	stat->last_index = freq_table_get_index(stat, policy->cur);
+	stat->location_factor = 100;
+	stat->ctx.cpu = stat->cpu;
+	stat->ctx.fit_data = fit_data;
+	stat->ctx.epoch_len = (int)(1000000/DYN_FREQ);
+	stat->acc.core_fit_acc = 0;
+	stat->acc.mem_fit_acc = 0;
+        stat->acc.core_pow_acc = 0;
+        stat->acc.mem_pow_acc = 0;
+	update_cur_fit(stat->cpu);
+	// targets, and full vulnerability until the PMU provides samples
+	re_core_budget_init(&stat->budget, fit_data, TARGET_FACTOR);
+	printk("fit_target are: %d %d\n", stat->budget.core_fit_target, stat->budget.mem_fit_target);
+#ifndef STATIC_POLICY
+	re_core_budget_open(&stat->budget, &stat->acc, (int)(1000000/DYN_FREQ),
+			jiffies_to_usecs(get_jiffies_64()));
+	stat->epoch = 0;
+	stat->epoch_overflow = 0;
+	stat->epoch_core_fit_acc = stat->acc.core_fit_acc;
+	stat->epoch_mem_fit_acc = stat->acc.mem_fit_acc;
+	stat->epoch_core_pow_acc = stat->acc.core_pow_acc;
+	stat->epoch_mem_pow_acc = stat->acc.mem_pow_acc;
+	stat->pareto_bucket = RE_PARETO_BUCKETS - 1;
+	cpufreq_re_pareto_build(stat, fit_data);
+#endif
+	stat->last_C_state = 3;
+	stat->last_P_state = 0;
+	stat->last_P_ceiling = INT_MAX;
+	stat->last_wear_ceiling = INT_MAX;
+	stat->qos_state = -1;
+	stat->qos_constraint = PM_QOS_CPU_DMA_LAT_DEFAULT_VALUE;
+	if (per_cpu(cpufreq_re_saved_valid, cpu)) {
+		cpufreq_re_state_restore(stat, &per_cpu(cpufreq_re_saved_state, cpu));
+		per_cpu(cpufreq_re_saved_valid, cpu) = 0;
+		update_cur_fit(stat->cpu);
+#ifndef STATIC_POLICY
+		cpufreq_re_pareto_build(stat, fit_data);
+#endif
+	}
+	spin_unlock(&cpufreq_re_stats_lock);
+	log_thread_init(stat->cpu);
+
+	if (stat->last_index == -1) {
+		pr_err("%s: No match for current freq %u in table. Disabled!\n",
+		       __func__, policy->cur);
+		ret = -EINVAL;
+		goto error_free_table;
+	}
+
+	cpufreq_cpu_put(current_policy);
+	return 0;
+error_free_table:
+	kfree(stat->freq_table);
+error_remove_group:
+	sysfs_remove_group(&current_policy->kobj, &stats_attr_group);
+error_out:
+	cpufreq_cpu_put(current_policy);
+error_get_fail:
+	re_platform_free(&stat->plat);
+	kfree(stat);
+	per_cpu(cpufreq_re_stats_table, cpu) = NULL;
+	return ret;
+}
+
+static void cpufreq_re_stats_update_policy_cpu(struct cpufreq_policy *policy)
+{
+	struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table,
+			policy->last_cpu);
+
+	pr_debug("Updating stats_table for new_cpu %u from last_cpu %u\n",
+			policy->cpu, policy->last_cpu);
+	per_cpu(cpufreq_re_stats_table, policy->cpu) = per_cpu(cpufreq_re_stats_table,
+			policy->last_cpu);
+	per_cpu(cpufreq_re_stats_table, policy->last_cpu) = NULL;
+	stat->cpu = policy->cpu;
+	stat->ctx.cpu = policy->cpu;
+}
+
+static int cpufreq_re_stat_notifier_policy(struct notifier_block *nb,
+		unsigned long val, void *data)
+{
+	int ret;
+	struct cpufreq_policy *policy = data;
+	struct cpufreq_frequency_table *table;
+	unsigned int cpu = policy->cpu;
+
+	if (val == CPUFREQ_UPDATE_POLICY_CPU) {
+		cpufreq_re_stats_update_policy_cpu(policy);
+		return 0;
+	}
+
+	if (val != CPUFREQ_NOTIFY)
+		return 0;
+	table = cpufreq_frequency_get_table(cpu);
+	if (!table)
+		return 0;
+	ret = cpufreq_re_stats_create_table(policy, table);
+	if (ret)
+		return ret;
+	return 0;
+}
+
+static int cpufreq_re_stat_notifier_trans(struct notifier_block *nb,
+		unsigned long val, void *data)
+{
+	struct cpufreq_freqs *freq = data;
+	struct cpufreq_re_stats *stat;
+	int old_index, new_index;
+
+	if (val != CPUFREQ_POSTCHANGE)
+		return 0;
+
+	stat = per_cpu(cpufreq_re_stats_table, freq->cpu);
+	if (!stat)
+		return 0;
+
+	old_index = stat->last_index;
+	new_index = freq_table_get_index(stat, freq->new);
+
+	/* We can't do stat->time_in_state[-1]= .. */
+	if (old_index == -1 || new_index == -1)
+		return 0;
+
+	cpufreq_re_stats_update(freq->cpu);
+
+	if (old_index == new_index)
+		return 0;
+
+	spin_lock(&cpufreq_re_stats_lock);
+	stat->last_index = new_index;
+	update_cur_fit(freq->cpu);
+	spin_unlock(&cpufreq_re_stats_lock);
+	cpufreq_re_policy_transition(&stat->ctx, freq->old, freq->new);
+	return 0;
+}
+
+static int cpufreq_re_stat_cpu_callback(struct notifier_block *nfb,
+					       unsigned long action,
+					       void *hcpu)
+{
+	unsigned int cpu = (unsigned long)hcpu;
+
+	switch (action) {
+	case CPU_DOWN_PREPARE:
+		cpufreq_re_stats_free_sysfs(cpu);
+		break;
+	case CPU_DEAD:
+		cpufreq_re_stats_free_table(cpu);
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+/* priority=1 so this will get called before cpufreq_remove_dev */
+static struct notifier_block cpufreq_re_stat_cpu_notifier __refdata = {
+	.notifier_call = cpufreq_re_stat_cpu_callback,
+	.priority = 1,
+};
+
+static struct notifier_block notifier_policy_block = {
+	.notifier_call = cpufreq_re_stat_notifier_policy
+};
+
+static struct notifier_block notifier_trans_block = {
+	.notifier_call = cpufreq_re_stat_notifier_trans
+};
+
+static int __init cpufreq_re_stats_init(void)
+{
+	int ret;
+	unsigned int cpu;
+
+	spin_lock_init(&cpufreq_re_stats_lock);
+	ret = cpufreq_register_notifier(&notifier_policy_block,
+				CPUFREQ_POLICY_NOTIFIER);
+	if (ret)
+		return ret;
+
+	// events are optional, keep collecting stats without them
+	if (cpufreq_re_netlink_init())
+		pr_warn("cpufreq_re_stats: netlink events unavailable\n");
+	if (cpufreq_re_cgroup_init())
+		pr_warn("cpufreq_re_stats: no context switch hook for cgroups\n");
+	register_syscore_ops(&cpufreq_re_syscore_ops);
+	pm_qos_add_request(&cpufreq_re_qos_req, PM_QOS_CPU_DMA_LATENCY,
+			PM_QOS_DEFAULT_VALUE);
+	if (cpufreq_re_builtin_policies_init())
+		pr_warn("cpufreq_re_stats: built-in policies unavailable\n");
+
+	register_hotcpu_notifier(&cpufreq_re_stat_cpu_notifier);
+
+	ret = cpufreq_register_notifier(&notifier_trans_block,
+				CPUFREQ_TRANSITION_NOTIFIER);
+	if (ret)
+		goto error_trans;
+
+	// from here on cpuidle and cpufreq call in
+	ret = cpufreq_re_register_hooks(&cpufreq_re_stats_hooks);
+	if (ret) {
+		pr_err("cpufreq_re_stats: hooks already taken\n");
+		cpufreq_unregister_notifier(&notifier_trans_block,
+				CPUFREQ_TRANSITION_NOTIFIER);
+		goto error_trans;
+	}
+
+	return 0;
+
+error_trans:
+	cpufreq_unregister_notifier(&notifier_policy_block,
+			CPUFREQ_POLICY_NOTIFIER);
+	unregister_hotcpu_notifier(&cpufreq_re_stat_cpu_notifier);
+	unregister_syscore_ops(&cpufreq_re_syscore_ops);
+	pm_qos_remove_request(&cpufreq_re_qos_req);
+	cpufreq_re_builtin_policies_exit();
+	cpufreq_re_cgroup_exit();
+	cpufreq_re_netlink_exit();
+	for_each_online_cpu(cpu)
+		cpufreq_re_stats_free_table(cpu);
+	return ret;
+}
+
+/*
+ * Undo the C-state ceiling cpuidle_idle_call() left in the driver, it
+ * is not refreshed once the hooks are gone.
+ */
+static void cpufreq_re_release_C_states(void)
+{
+	struct cpuidle_device *dev;
+	struct cpuidle_driver *drv;
+	unsigned int cpu;
+	int i;
+
+	for_each_online_cpu(cpu) {
+		dev = per_cpu(cpuidle_devices, cpu);
+		drv = dev ? cpuidle_get_cpu_driver(dev) : NULL;
+		if (!drv)
+			continue;
+		for (i = 0; i < drv->state_count; i++)
+			drv->states[i].disabled = false;
+	}
+}
+
+static void __exit cpufreq_re_stats_exit(void)
+{
+	unsigned int cpu;
+
+	cpufreq_re_unregister_hooks(&cpufreq_re_stats_hooks);
+	cpufreq_re_calib_exit();
+	cpufreq_re_release_C_states();
+	cpufreq_re_pmu_stop(avf_mode);
+	cpufreq_unregister_notifier(&notifier_policy_block,
+			CPUFREQ_POLICY_NOTIFIER);
+	cpufreq_unregister_notifier(&notifier_trans_block,
+			CPUFREQ_TRANSITION_NOTIFIER);
+	unregister_hotcpu_notifier(&cpufreq_re_stat_cpu_notifier);
+	unregister_syscore_ops(&cpufreq_re_syscore_ops);
+	cancel_work_sync(&cpufreq_re_qos_work);
+	pm_qos_remove_request(&cpufreq_re_qos_req);
+	cpufreq_re_builtin_policies_exit();
+	cpufreq_re_cgroup_exit();
+	cpufreq_re_netlink_exit();
+	for_each_online_cpu(cpu) {
+		log_thread_exit(cpu);
+		cpufreq_re_stats_free_table(cpu);
+		cpufreq_re_stats_free_sysfs(cpu);
+	}
+}
+
+static int log_thread_init(unsigned int cpu)
+{
+	struct cpufreq_re_log * log;
+	unsigned int alloc_size;
+	char thread_name[16] = "cpufreq_re_log";
+
+        if (per_cpu(cpufreq_re_log_table, cpu))
+                return -EBUSY;
+        log = kzalloc(sizeof(*log), GFP_KERNEL);
+
+	log->cpu = cpu;
+	log->cur_index = 0;
+	log->last_pow = 0;
+	log->last_core_fit = 0;
+	log->last_mem_fit = 0;
+
+	alloc_size = 4 * LOG_LENGTH * sizeof(u64);
+	log->pow_log_data = kzalloc(alloc_size, GFP_KERNEL);
+	log->core_fit_data = (u64 *)(log->pow_log_data + LOG_LENGTH);
+	log->mem_fit_data = (u64 *)(log->core_fit_data + LOG_LENGTH);
+	log->freq_data = (u64 *)(log->mem_fit_data + LOG_LENGTH);
+
+	per_cpu(cpufreq_re_log_table, cpu) = log;
+
+	log_state = 0;
+	trace_state = 0;
+
+	log->data_logging_thread = kthread_create(thread_log_fn, 
+					(void*)&cpu, thread_name);
+	if (log->data_logging_thread)
+	{
+		printk("re_log_thread created on cpu %d\n", cpu);
+		wake_up_process(log->data_logging_thread);
+	}
+	return 0;
+}
+
+static int log_thread_exit(unsigned int cpu)
+{
+	struct cpufreq_re_log *log = per_cpu(cpufreq_re_log_table, cpu);
+	if (log)
+	{
+		kfree(log->pow_log_data);
+		kfree(log);
+	}
+	return 0;
+}
+
+static void thread_collect_data(unsigned int cpu_id)
+{
+	int i;
+	u64 cur_pow, cur_core_fit, cur_mem_fit;
+	struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, cpu_id);
+	struct cpufreq_re_log *log = per_cpu(cpufreq_re_log_table, cpu_id);
+	if (!log || !stat)
+		return;
+	cpufreq_re_stats_update(log->cpu);
+	cur_pow = stat->acc.core_pow_acc + stat->acc.mem_pow_acc;
+	cur_core_fit = stat->acc.core_fit_acc;
+	cur_mem_fit = stat->acc.mem_fit_acc;
+
+	log->pow_log_data[log->cur_index] = cur_pow - log->last_pow;
+	log->core_fit_data[log->cur_index] = cur_core_fit - log->last_core_fit;
+	log->mem_fit_data[log->cur_index] = cur_mem_fit - log->last_mem_fit;
+	log->freq_data[log->cur_index] = stat->freq_table[stat->last_index]/1000;
+
+	log->last_pow = cur_pow;
+	log->last_core_fit = cur_core_fit;
+	log->last_mem_fit = cur_mem_fit;
+	
+	log->cur_index++;
+	if (log->cur_index>=LOG_LENGTH)
+	{
+		for(i=0;i<LOG_LENGTH;i++)
+		{
+			if (log_state)
+				pr_info("RE_LOG %s: %d %llu %llu %llu %llu\n",
+					log_name, i,
+					log->freq_data[i],
+					log->pow_log_data[i],
+					log->core_fit_data[i], 
+					log->mem_fit_data[i]);
+		}
+		log->cur_index = 0;
+	}
+	return;
+}
+
+static int thread_log_fn(void* cpu)
+{
+	unsigned int cpu_id = *(int *)cpu;
+
+	while(1) 
+	{
+		msleep(1000/LOG_FREQ);
+		thread_collect_data(cpu_id);
+	}
+
+	return 0;
+}
+
+#ifndef STATIC_POLICY
+/*
+ * One controller step: allowance = setpoint + kp * (setpoint - rate
+ * measured in this cycle) + ki * integral, clamped to the FIT range of
+ * the OPPs and smoothed. Unlike remaining budget / remaining time, the
+ * measured rate does not blow up when the cycle end approaches.
+ */
+static unsigned int cpufreq_re_pi_step(struct cpufreq_re_pi *pi,
+			unsigned int setpoint, unsigned int measured,
+			unsigned int out_min, unsigned int out_max)
+{
+	s64 u;
+
+	u = (s64)setpoint + (((s64)pi_kp * ((s64)setpoint - measured)
+			+ (s64)pi_ki * pi->integral) >> 8);
+	pi->saturated = 0;
+	if (u < out_min) {
+		u = out_min;
+		pi->saturated = -1;
+	} else if (u > out_max) {
+		u = out_max;
+		pi->saturated = 1;
+	}
+	if (!pi->output)
+		pi->output = (unsigned int)u;
+	else
+		pi->output = (unsigned int)((s64)pi->output
+				+ ((((s64)u - pi->output) * pi_alpha) >> 8));
+	return pi->output;
+}
+
+/*
+ * Target rate of the running cycle including the banked budget.
+ */
+static unsigned int cpufreq_re_cycle_setpoint(unsigned int fit_target,
+			s64 bank)
+{
+	s64 setpoint = (s64)fit_target + div_s64(bank, (int)(1000000/DYN_FREQ));
+
+	return setpoint > 0 ? (unsigned int)setpoint : 0;
+}
+
+/*
+ * Integrate the rate error of a closed cycle. Integration stops while
+ * the output is saturated in the same direction (anti-windup).
+ */
+static void cpufreq_re_pi_close(struct cpufreq_re_pi *pi,
+			unsigned int setpoint, unsigned int measured)
+{
+	s64 err = (s64)setpoint - measured;
+	s64 limit = (s64)setpoint * PI_INTEGRAL_LIMIT;
+
+	if ((pi->saturated > 0 && err > 0) || (pi->saturated < 0 && err < 0))
+		return;
+	pi->integral += err;
+	if (pi->integral > limit)
+		pi->integral = limit;
+	else if (pi->integral < -limit)
+		pi->integral = -limit;
+}
+
+/*
+ * Average FIT rate since the start of the running cycle.
+ */
+static unsigned int cpufreq_re_cycle_rate(u64 acc, u64 start_acc,
+			unsigned long long cur_wall_time,
+			unsigned long long budget_stop_time,
+			unsigned int fallback)
+{
+	unsigned long long start = budget_stop_time - (int)(1000000/DYN_FREQ);
+
+	if (cur_wall_time <= start)
+		return fallback;
+	return (unsigned int)div64_u64(acc - start_acc, cur_wall_time - start);
+}
+
+/*
+ * This function pushes the budget state of the running control cycle
+ * to user space through cpufreq_re_netlink.
+ */
+static void cpufreq_re_epoch_notify(struct cpufreq_re_stats *stat,
+			unsigned int type, unsigned long long cur_wall_time)
+{
+	struct cpufreq_re_event event;
+
+	event.type = type;
+	event.cpu = stat->cpu;
+	event.epoch = stat->epoch;
+	event.time = cur_wall_time;
+	event.core_fit = stat->acc.core_fit_acc - stat->epoch_core_fit_acc;
+	event.mem_fit = stat->acc.mem_fit_acc - stat->epoch_mem_fit_acc;
+	event.core_energy = stat->acc.core_pow_acc - stat->epoch_core_pow_acc;
+	event.mem_energy = stat->acc.mem_pow_acc - stat->epoch_mem_pow_acc;
+	event.core_balance = (s64)(stat->budget.target_core_fit_acc
+				- stat->acc.core_fit_acc);
+	event.mem_balance = (s64)(stat->budget.target_mem_fit_acc
+				- stat->acc.mem_fit_acc);
+	event.core_bank = stat->budget.core_fit_bank;
+	event.mem_bank = stat->budget.mem_fit_bank;
+	event.c_state = stat->last_C_state;
+	event.p_state = stat->last_P_state;
+	cpufreq_re_netlink_notify(&event);
+}
+
+/*
+ * Joint decision for both hooks: the cheapest frontier point whose FIT
+ * rates fit the remaining allowance. It is kept for the whole cycle
+ * unless the allowance drops below it. Without a fitting point the one
+ * with the lowest total FIT is used.
+ */
+static struct cpufreq_re_pareto_point *cpufreq_re_pareto_decide(
+			struct cpufreq_re_stats *stat,
+			unsigned int core_fit_target, unsigned int mem_fit_target)
+{
+	struct cpufreq_re_pareto_point *frontier =
+			stat->pareto.point[stat->pareto_bucket];
+	struct cpufreq_re_pareto_point *pt;
+	int i, best;
+
+	if (stat->pareto_choice >= 0 && stat->pareto_epoch == stat->epoch) {
+		pt = &frontier[stat->pareto_choice];
+		if (pt->core_fit <= core_fit_target && pt->mem_fit <= mem_fit_target)
+			return pt;
+	}
+	best = 0;
+	for (i = 0; i < stat->pareto.count[stat->pareto_bucket]; i++) {
+		pt = &frontier[i];
+		if (pt->core_fit <= core_fit_target && pt->mem_fit <= mem_fit_target) {
+			best = i;
+			break;
+		}
+		if (pt->core_fit + pt->mem_fit
+		    < frontier[best].core_fit + frontier[best].mem_fit)
+			best = i;
+	}
+	stat->pareto_choice = best;
+	stat->pareto_epoch = stat->epoch;
+	return &frontier[best];
+}
+
+/*
+ * This function closes the control cycle once budget.stop_time is
+ * reached and opens a new one. Inside a cycle it reports the first
+ * budget overflow. It should be called after cpufreq_re_stats_update().
+ */
+static void cpufreq_re_epoch_check(struct cpufreq_re_stats *stat,
+			unsigned long long cur_wall_time)
+{
+	struct re_policy_ctx *ctx = &stat->ctx;
+	u64 cycle_core_fit;
+	u64 cycle_mem_fit;
+	u64 len;
+	int delta;
+
+	if (cur_wall_time < stat->budget.stop_time) {
+		if (!stat->epoch_overflow &&
+		    re_core_budget_overflow(&stat->budget, &stat->acc)) {
+			stat->epoch_overflow = 1;
+			cpufreq_re_epoch_notify(stat, CPUFREQ_RE_EVENT_OVERFLOW,
+						cur_wall_time);
+		}
+		return;
+	}
+
+	// new control cycle, adjust values accordingly
+	cpufreq_re_epoch_notify(stat, CPUFREQ_RE_EVENT_EPOCH_CLOSE,
+				cur_wall_time);
+	ctx->prev_core_setpoint = cpufreq_re_cycle_setpoint(
+			stat->budget.core_fit_target, stat->budget.core_fit_bank);
+	ctx->prev_mem_setpoint = cpufreq_re_cycle_setpoint(
+			stat->budget.mem_fit_target, stat->budget.mem_fit_bank);
+	ctx->prev_core_fit_rate = cpufreq_re_cycle_rate(stat->acc.core_fit_acc,
+			stat->epoch_core_fit_acc, cur_wall_time,
+			stat->budget.stop_time, stat->budget.core_fit_target);
+	ctx->prev_mem_fit_rate = cpufreq_re_cycle_rate(stat->acc.mem_fit_acc,
+			stat->epoch_mem_fit_acc, cur_wall_time,
+			stat->budget.stop_time, stat->budget.mem_fit_target);
+	ctx->prev_overflow = stat->epoch_overflow ||
+			re_core_budget_overflow(&stat->budget, &stat->acc);
+	// busy share of the closing cycle, in 1/1000 at 1GHz
+	len = cur_wall_time + (int)(1000000/DYN_FREQ) - stat->budget.stop_time;
+	if (len)
+		ctx->prev_util = (unsigned int)div64_u64(
+				(stat->busy_time - stat->epoch_busy_time)
+				* (re_platform_model_khz(&stat->plat,
+				stat->freq_table[stat->last_index]) / 1000), len);
+
+	delta = (int)(cur_wall_time - stat->budget.stop_time) / 1000;
+	if (delta<0)
+		delta = 0;
+	// FIT of the closing cycle; target_*_fit_acc also holds the bank
+	cycle_core_fit = stat->acc.core_fit_acc - stat->epoch_core_fit_acc;
+	cycle_core_fit = cycle_core_fit 
+		* ( 1000 - delta );
+	if (cycle_core_fit > stat->cycle_max_core_fit)
+		stat->cycle_max_core_fit = cycle_core_fit;
+	cycle_mem_fit = stat->acc.mem_fit_acc - stat->epoch_mem_fit_acc;
+	cycle_mem_fit = cycle_mem_fit 
+		* ( 1000 - delta );
+	if (cycle_mem_fit > stat->cycle_max_mem_fit)
+		stat->cycle_max_mem_fit = cycle_mem_fit;
+	if (trace_state) {
+		cpufreq_re_trace_C_time(stat);
+		// acc, allowed acc (target + bank), cycle target, core then mem
+		pr_info("TR_LOG CYCLE %s: %llu %llu %llu %llu %llu %llu %llu %u %llu\n",
+			log_name,
+			stat->acc.core_fit_acc>>6,
+			stat->budget.target_core_fit_acc>>6,
+			(unsigned long long)stat->budget.core_fit_target * (int)(1000000/DYN_FREQ)>>6,
+			stat->acc.mem_fit_acc>>6, 
+			stat->budget.target_mem_fit_acc>>6,
+			(unsigned long long)stat->budget.mem_fit_target * (int)(1000000/DYN_FREQ)>>6,
+			cur_wall_time - stat->budget.stop_time,
+			jiffies_to_usecs(get_jiffies_64()),
+			stat->acc.core_pow_acc + stat->acc.mem_pow_acc
+			);
+	}
+
+	re_core_budget_close(&stat->budget, &stat->acc, (int)(1000000/DYN_FREQ),
+			bank_cap);
+	re_core_budget_open(&stat->budget, &stat->acc, (int)(1000000/DYN_FREQ),
+			jiffies_to_usecs(get_jiffies_64()));
+	stat->epoch++;
+	stat->epoch_overflow = 0;
+	stat->epoch_core_fit_acc = stat->acc.core_fit_acc;
+	stat->epoch_mem_fit_acc = stat->acc.mem_fit_acc;
+	stat->epoch_core_pow_acc = stat->acc.core_pow_acc;
+	stat->epoch_mem_pow_acc = stat->acc.mem_pow_acc;
+	stat->epoch_busy_time = stat->busy_time;
+
+	cpufreq_re_ctx_update(stat, cur_wall_time);
+	cpufreq_re_policy_epoch_start(ctx);
+}
+
+/*
+ * Busy fraction of the running cycle in 1/1024, assume fully busy at
+ * cycle start
+ */
+static unsigned int cpufreq_re_cycle_util(struct cpufreq_re_stats *stat,
+			unsigned long long cur_wall_time)
+{
+	unsigned long long start = stat->budget.stop_time - (int)(1000000/DYN_FREQ);
+	unsigned int util;
+
+	if (cur_wall_time <= start)
+		return 1024;
+	util = (unsigned int)div64_u64((stat->busy_time
+			- stat->epoch_busy_time) * 1024, cur_wall_time - start);
+	return util > 1024 ? 1024 : util;
+}
+
+/*
+ * Highest P-state whose expected power fits in what is left of the
+ * cycle energy budget (power_cap * cycle length). The busy fraction
+ * seen so far in the cycle is scaled to each OPP frequency and idle
+ * time is charged at memory retention power.
+ */
+static int cpufreq_re_energy_P_ceiling(struct cpufreq_re_stats *stat,
+			struct cpufreq_re_fit_data *fit_data,
+			unsigned long long cur_wall_time)
+{
+	unsigned int pow_target, util, util_i, pow_i, cur_khz;
+	int i;
+
+	pow_target = re_core_remaining_rate(stat->epoch_core_pow_acc
+				+ stat->epoch_mem_pow_acc
+				+ (u64)power_cap * (int)(1000000/DYN_FREQ),
+			stat->acc.core_pow_acc + stat->acc.mem_pow_acc,
+			stat->budget.stop_time, cur_wall_time);
+
+	util = cpufreq_re_cycle_util(stat, cur_wall_time);
+	cur_khz = re_platform_model_khz(&stat->plat,
+			stat->freq_table[stat->last_index]);
+
+	for (i = 0; i < 5; i++) {
+		util_i = util * (cur_khz / 1000) / (re_opp_khz[i] / 1000);
+		if (util_i > 1024)
+			util_i = 1024;
+		pow_i = (util_i * (fit_data->core_pow[i] + fit_data->L1_mem_pow[i]
+				+ fit_data->L2_mem_pow)
+			+ (1024 - util_i) * stat->rates.cpuidle_mem_ret_pow) >> 10;
+		if (pow_i <= pow_target)
+			return 4 - i;
+	}
+	return 0;
+}
+#endif
+
+/*
+ * Refresh the budget view handed to the policy callbacks.
+ */
+static void cpufreq_re_ctx_update(struct cpufreq_re_stats *stat,
+			unsigned long long cur_wall_time)
+{
+	struct re_policy_ctx *ctx = &stat->ctx;
+
+	ctx->now = cur_wall_time;
+	ctx->avf_core = stat->budget.avf_core;
+	ctx->avf_l1 = stat->budget.avf_l1;
+	ctx->core_fit_target = stat->budget.core_fit_target;
+	ctx->mem_fit_target = stat->budget.mem_fit_target;
+#ifdef STATIC_POLICY
+	ctx->core_fit_rate = stat->budget.core_fit_target;
+	ctx->mem_fit_rate = stat->budget.mem_fit_target;
+#else
+	ctx->epoch = stat->epoch;
+	ctx->core_fit_bank = stat->budget.core_fit_bank;
+	ctx->mem_fit_bank = stat->budget.mem_fit_bank;
+	re_core_budget_rates(&stat->budget, &stat->acc, cur_wall_time,
+			&ctx->core_fit_rate, &ctx->mem_fit_rate);
+#endif
+}
+
+#ifndef STATIC_POLICY
+/*
+ * Lifetime wear the schedule allows at age (usec). With RE_WEAR_FRONT
+ * the budget is released with the square root of the life fraction,
+ * so a young part may run hot and slows down as it ages.
+ */
+static u64 cpufreq_re_wear_allowed(u64 age)
+{
+	u64 life = (u64)wear_life * 3600 * USEC_PER_SEC;
+	u64 budget = life * wear_target * 10;
+	u32 frac;
+
+	if (age >= life)
+		return budget;
+	// life fraction in 1/2^20
+	frac = (u32)div64_u64(age, life >> 20);
+	if (frac > (1 << 20))
+		frac = 1 << 20;
+	if (wear_schedule == RE_WEAR_FRONT)
+		frac = int_sqrt(frac) << 10;
+	return (budget >> 20) * frac;
+}
+
+/*
+ * Highest P-state whose expected aging stress over the next cycle stays
+ * within what the lifetime schedule allows by then. Idle time is
+ * charged at the clock gated rate of each OPP.
+ */
+static int cpufreq_re_wear_P_ceiling(struct cpufreq_re_stats *stat,
+			struct cpufreq_re_fit_data *fit_data,
+			unsigned long long cur_wall_time)
+{
+	unsigned int horizon = (int)(1000000/DYN_FREQ);
+	u64 allowed = cpufreq_re_wear_allowed(stat->wear_age + horizon);
+	u64 rate_target = 0;
+	unsigned int util, util_i, cur_khz;
+	u64 rate_i;
+	int i;
+
+	if (allowed > stat->acc.wear_acc)
+		rate_target = div64_u64(allowed - stat->acc.wear_acc, horizon);
+	util = cpufreq_re_cycle_util(stat, cur_wall_time);
+	cur_khz = re_platform_model_khz(&stat->plat,
+			stat->freq_table[stat->last_index]);
+
+	for (i = 0; i < 5; i++) {
+		util_i = util * (cur_khz / 1000) / (re_opp_khz[i] / 1000);
+		if (util_i > 1024)
+			util_i = 1024;
+		rate_i = ((u64)util_i * fit_data->wear_rate[i]
+			+ (u64)(1024 - util_i) * fit_data->wear_rate_c1[i]) >> 10;
+		if (rate_i <= rate_target)
+			return 4 - i;
+	}
+	return 0;
+}
+#endif
+
+static void cpufreq_re_qos_work_fn(struct work_struct *work)
+{
+	struct cpufreq_re_stats *stat;
+	s32 value = PM_QOS_CPU_DMA_LAT_DEFAULT_VALUE;
+	unsigned int cpu;
+
+	for_each_online_cpu(cpu) {
+		stat = per_cpu(cpufreq_re_stats_table, cpu);
+		if (stat && stat->qos_constraint < value)
+			value = stat->qos_constraint;
+	}
+	if (!qos_publish || value == PM_QOS_CPU_DMA_LAT_DEFAULT_VALUE)
+		value = PM_QOS_DEFAULT_VALUE;
+	pm_qos_update_request(&cpufreq_re_qos_req, value);
+}
+
+static DECLARE_WORK(cpufreq_re_qos_work, cpufreq_re_qos_work_fn);
+
+/*
+ * Reconcile the C-state ceiling with cpu_dma_latency. The governor
+ * honours QoS on its own; when QoS only leaves states shallower than
+ * the ceiling that cost more FIT, the idle entry counts as a conflict
+ * and the extra FIT of the next idle period is booked as borrowed.
+ * With qos_publish set, the ceiling is also published as our own
+ * latency constraint, so it never shows up as a conflict itself.
+ * ceiling is a model class, qos_state and qos_alt_state are too.
+ */
+static void cpufreq_re_qos_check(struct cpufreq_re_stats *stat, int ceiling)
+{
+	struct cpuidle_device *dev = per_cpu(cpuidle_devices, stat->cpu);
+	struct cpuidle_driver *drv;
+	s32 latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	s32 constraint;
+	int i, limit = 0, model_limit, drv_ceiling;
+
+	stat->qos_state = -1;
+	if (!dev)
+		return;
+	drv = cpuidle_get_cpu_driver(dev);
+	if (!drv || !drv->state_count)
+		return;
+	if (ceiling >= RE_CORE_IDLE_STATES)
+		ceiling = RE_CORE_IDLE_STATES - 1;
+	ceiling = re_platform_idle_class(&stat->plat,
+			re_platform_C_limit(&stat->plat, ceiling));
+	drv_ceiling = re_platform_C_limit(&stat->plat, ceiling);
+	if (drv_ceiling >= drv->state_count)
+		drv_ceiling = drv->state_count - 1;
+
+	for (i = 1; i <= drv_ceiling; i++)
+		if (drv->states[i].exit_latency <= latency_req)
+			limit = i;
+	model_limit = re_platform_idle_class(&stat->plat, limit);
+	if (model_limit < ceiling && re_core_idle_fit(&stat->rates, model_limit)
+			> re_core_idle_fit(&stat->rates, ceiling)) {
+		stat->qos_conflicts++;
+		stat->qos_state = model_limit;
+		stat->qos_alt_state = ceiling;
+	}
+
+	if (!qos_publish)
+		return;
+	if (drv_ceiling == drv->state_count - 1)
+		constraint = PM_QOS_CPU_DMA_LAT_DEFAULT_VALUE;
+	else
+		constraint = drv->states[drv_ceiling].exit_latency;
+	if (constraint != stat->qos_constraint) {
+		stat->qos_constraint = constraint;
+		schedule_work(&cpufreq_re_qos_work);
+	}
+}
+
+static int cpufreq_re_get_C_states(unsigned int cpu)
+{
+	struct cpufreq_re_stats *stat;
+	unsigned long long cur_wall_time;
+	int ret;
+
+	stat = per_cpu(cpufreq_re_stats_table, cpu);	
+	if (!stat)
+		return INT_MAX;
+#ifndef POLICY_ENABLE
+	return INT_MAX;
+#endif
+	cur_wall_time = jiffies_to_usecs(get_jiffies_64());
+#ifndef STATIC_POLICY
+	cpufreq_re_stats_update(cpu);
+	cpufreq_re_epoch_check(stat, cur_wall_time);
+#endif
+	cpufreq_re_ctx_update(stat, cur_wall_time);
+	ret = cpufreq_re_policy_c_ceiling(&stat->ctx);
+	stat->last_C_state = ret;
+	cpufreq_re_qos_check(stat, ret);
+	// cpuidle compares the ceiling with its own state indices
+	return re_platform_C_limit(&stat->plat, ret);
+}
 
-	if (old_index == new_index)
-		return 0;
+/*
+ * Lowest P-state whose total (core + mem) FIT rate fits in fit_target,
+ * using the same index convention as cpufreq_re_get_P_states().
+ */
+static int cpufreq_re_total_fit_P_state(struct cpufreq_re_stats *stat,
+			struct cpufreq_re_fit_data *fit_data,
+			unsigned int fit_target)
+{
+	int i;
 
-	spin_lock(&cpufreq_re_stats_lock);
-	stat->last_index = new_index;
-	update_cur_fit(freq->cpu);
-	spin_unlock(&cpufreq_re_stats_lock);
+	for (i = 4; i >= 0; i--) {
+		if (fit_target >= (fit_data->core_fit[i] + fit_data->L1_mem_fit[i]
+				+ fit_data->L2_mem_fit) * stat->location_factor / 100)
+			return 4 - i;
+	}
 	return 0;
 }
 
-static int cpufreq_re_stat_cpu_callback(struct notifier_block *nfb,
-					       unsigned long action,
-					       void *hcpu)
+#ifndef STATIC_POLICY
+/*
+ * Dwell time and hysteresis on the P-state floor. A new floor is only
+ * taken once the held one is older than the dwell time, and with
+ * dwell_cost set at least that many average transition times, so the
+ * transition overhead stays bounded. With a band set, a higher floor
+ * is only taken when the held one overshoots the remaining allowance
+ * by more than the band, a lower one when it fits with the band to
+ * spare. An overflowed cycle skips the dwell.
+ */
+static int cpufreq_re_P_hold(struct cpufreq_re_stats *stat,
+			struct cpufreq_re_fit_data *fit_data, int candidate,
+			unsigned int core_fit_target, unsigned int mem_fit_target,
+			unsigned long long cur_wall_time)
 {
-	unsigned int cpu = (unsigned long)hcpu;
+	unsigned int hold, core_rate, mem_rate;
+	int held = stat->held_P_state;
+	int i;
 
-	switch (action) {
-	case CPU_DOWN_PREPARE:
-		cpufreq_re_stats_free_sysfs(cpu);
-		break;
-	case CPU_DEAD:
-		cpufreq_re_stats_free_table(cpu);
-		break;
+	if (candidate == held)
+		return held;
+	hold = max_t(unsigned int, dwell_time,
+			dwell_cost * stat->avg_transition_time);
+	if (cur_wall_time < stat->held_since + hold && !stat->epoch_overflow)
+		return held;
+	if (hysteresis) {
+		// rates of the slower of the two floors
+		i = 4 - (candidate > held ? held : candidate);
+		core_rate = fit_data->core_fit[i] * stat->location_factor / 100;
+		mem_rate = (fit_data->L1_mem_fit[i] + fit_data->L2_mem_fit)
+				* stat->location_factor / 100;
+		if (candidate > held) {
+			if ((u64)core_rate * 100 <= (u64)core_fit_target * (100 + hysteresis) &&
+			    (u64)mem_rate * 100 <= (u64)mem_fit_target * (100 + hysteresis))
+				return held;
+		} else {
+			if ((u64)core_rate * (100 + hysteresis) > (u64)core_fit_target * 100 ||
+			    (u64)mem_rate * (100 + hysteresis) > (u64)mem_fit_target * 100)
+				return held;
+		}
 	}
-	return NOTIFY_OK;
+	stat->held_P_state = candidate;
+	stat->held_since = cur_wall_time;
+	stat->floor_changes++;
+	return candidate;
 }
+#endif
 
-/* priority=1 so this will get called before cpufreq_remove_dev */
-static struct notifier_block cpufreq_re_stat_cpu_notifier __refdata = {
-	.notifier_call = cpufreq_re_stat_cpu_callback,
-	.priority = 1,
-};
-
-static struct notifier_block notifier_policy_block = {
-	.notifier_call = cpufreq_re_stat_notifier_policy
-};
+/*
+ * Built-in policies. "threshold" is the original remaining budget /
+ * remaining time rule and the default one.
+ */
+#define ctx_to_stat(c) container_of(c, struct cpufreq_re_stats, ctx)
 
-static struct notifier_block notifier_trans_block = {
-	.notifier_call = cpufreq_re_stat_notifier_trans
-};
+// re_core_fit_floor() with the model and factors of ctx
+static int re_fit_floor(struct re_policy_ctx *ctx, unsigned int core_rate,
+			unsigned int mem_rate)
+{
+	return re_core_fit_floor(ctx->fit_data, ctx->location_factor,
+			ctx->avf_core, ctx->avf_l1, core_rate, mem_rate);
+}
 
-static int __init cpufreq_re_stats_init(void)
+static int re_threshold_c_ceiling(struct re_policy_ctx *ctx)
 {
-	int ret;
-	unsigned int cpu;
+	return re_core_c_ceiling(ctx->core_fit_rate, ctx->mem_fit_rate,
+			ctx->c2_fit, ctx->mem_ret_fit);
+}
 
-	spin_lock_init(&cpufreq_re_stats_lock);
-	ret = cpufreq_register_notifier(&notifier_policy_block,
-				CPUFREQ_POLICY_NOTIFIER);
-	if (ret)
-		return ret;
+static int re_threshold_p_floor(struct re_policy_ctx *ctx)
+{
+	return re_fit_floor(ctx, ctx->core_fit_rate, ctx->mem_fit_rate);
+}
 
-	register_hotcpu_notifier(&cpufreq_re_stat_cpu_notifier);
+static struct re_policy_ops re_threshold_policy = {
+	.name = "threshold",
+	.c_ceiling = re_threshold_c_ceiling,
+	.p_floor = re_threshold_p_floor,
+};
 
-	ret = cpufreq_register_notifier(&notifier_trans_block,
-				CPUFREQ_TRANSITION_NOTIFIER);
-	if (ret) {
-		cpufreq_unregister_notifier(&notifier_policy_block,
-				CPUFREQ_POLICY_NOTIFIER);
-		unregister_hotcpu_notifier(&cpufreq_re_stat_cpu_notifier);
-		for_each_online_cpu(cpu)
-			cpufreq_re_stats_free_table(cpu);
-		return ret;
-	}
+// deeper idle and lower OPPs only ever save energy, the cap does the rest
+static int re_energy_c_ceiling(struct re_policy_ctx *ctx)
+{
+	return 3;
+}
 
+static int re_energy_p_floor(struct re_policy_ctx *ctx)
+{
 	return 0;
 }
-static void __exit cpufreq_re_stats_exit(void)
+
+static struct re_policy_ops re_energy_policy = {
+	.name = "energy",
+	.c_ceiling = re_energy_c_ceiling,
+	.p_floor = re_energy_p_floor,
+};
+
+#ifndef STATIC_POLICY
+static void re_pi_enable(void)
 {
+	struct cpufreq_re_stats *stat;
 	unsigned int cpu;
 
-	cpufreq_unregister_notifier(&notifier_policy_block,
-			CPUFREQ_POLICY_NOTIFIER);
-	cpufreq_unregister_notifier(&notifier_trans_block,
-			CPUFREQ_TRANSITION_NOTIFIER);
-	unregister_hotcpu_notifier(&cpufreq_re_stat_cpu_notifier);
+	spin_lock(&cpufreq_re_stats_lock);
 	for_each_online_cpu(cpu) {
-		log_thread_exit(cpu);
-		cpufreq_re_stats_free_table(cpu);
-		cpufreq_re_stats_free_sysfs(cpu);
+		stat = per_cpu(cpufreq_re_stats_table, cpu);
+		if (!stat)
+			continue;
+		memset(&stat->core_pi, 0, sizeof(stat->core_pi));
+		memset(&stat->mem_pi, 0, sizeof(stat->mem_pi));
 	}
+	spin_unlock(&cpufreq_re_stats_lock);
 }
 
-static int log_thread_init(unsigned int cpu)
+static void re_pi_epoch_start(struct re_policy_ctx *ctx)
 {
-	struct cpufreq_re_log * log;
-	unsigned int alloc_size;
-	char thread_name[16] = "cpufreq_re_log";
+	struct cpufreq_re_stats *stat = ctx_to_stat(ctx);
 
-        if (per_cpu(cpufreq_re_log_table, cpu))
-                return -EBUSY;
-        log = kzalloc(sizeof(*log), GFP_KERNEL);
+	cpufreq_re_pi_close(&stat->core_pi, ctx->prev_core_setpoint,
+			ctx->prev_core_fit_rate);
+	cpufreq_re_pi_close(&stat->mem_pi, ctx->prev_mem_setpoint,
+			ctx->prev_mem_fit_rate);
+}
 
-	log->cpu = cpu;
-	log->cur_index = 0;
-	log->last_pow = 0;
-	log->last_core_fit = 0;
-	log->last_mem_fit = 0;
+static int re_pi_c_ceiling(struct re_policy_ctx *ctx)
+{
+	return re_threshold_c_ceiling(ctx);
+}
 
-	alloc_size = 4 * LOG_LENGTH * sizeof(u64);
-	log->pow_log_data = kzalloc(alloc_size, GFP_KERNEL);
-	log->core_fit_data = (u64 *)(log->pow_log_data + LOG_LENGTH);
-	log->mem_fit_data = (u64 *)(log->core_fit_data + LOG_LENGTH);
-	log->freq_data = (u64 *)(log->mem_fit_data + LOG_LENGTH);
+static int re_pi_p_floor(struct re_policy_ctx *ctx)
+{
+	struct cpufreq_re_stats *stat = ctx_to_stat(ctx);
+	const struct cpufreq_re_fit_data *fit_data = ctx->fit_data;
+	unsigned int core_rate, mem_rate;
+
+	core_rate = cpufreq_re_pi_step(&stat->core_pi,
+			cpufreq_re_cycle_setpoint(ctx->core_fit_target,
+				ctx->core_fit_bank),
+			cpufreq_re_cycle_rate(stat->acc.core_fit_acc,
+				stat->epoch_core_fit_acc, ctx->now,
+				stat->budget.stop_time, ctx->core_fit_target),
+			fit_data->core_fit[0] * ctx->location_factor / 100,
+			fit_data->core_fit[4] * ctx->location_factor / 100);
+	mem_rate = cpufreq_re_pi_step(&stat->mem_pi,
+			cpufreq_re_cycle_setpoint(ctx->mem_fit_target,
+				ctx->mem_fit_bank),
+			cpufreq_re_cycle_rate(stat->acc.mem_fit_acc,
+				stat->epoch_mem_fit_acc, ctx->now,
+				stat->budget.stop_time, ctx->mem_fit_target),
+			(fit_data->L1_mem_fit[0] + fit_data->L2_mem_fit)
+				* ctx->location_factor / 100,
+			(fit_data->L1_mem_fit[4] + fit_data->L2_mem_fit)
+				* ctx->location_factor / 100);
+	return re_fit_floor(ctx, core_rate, mem_rate);
+}
 
-	per_cpu(cpufreq_re_log_table, cpu) = log;
+static struct re_policy_ops re_pi_policy = {
+	.name = "pi",
+	.enable = re_pi_enable,
+	.epoch_start = re_pi_epoch_start,
+	.c_ceiling = re_pi_c_ceiling,
+	.p_floor = re_pi_p_floor,
+};
 
-	log_state = 0;
-	trace_state = 0;
+// utilization bucket of the next cycle from the one that just closed
+static void re_pareto_epoch_start(struct re_policy_ctx *ctx)
+{
+	struct cpufreq_re_stats *stat = ctx_to_stat(ctx);
 
-	log->data_logging_thread = kthread_create(thread_log_fn, 
-					(void*)&cpu, thread_name);
-	if (log->data_logging_thread)
-	{
-		printk("re_log_thread created on cpu %d\n", cpu);
-		wake_up_process(log->data_logging_thread);
-	}
-	return 0;
+	stat->pareto_bucket = ctx->prev_util * RE_PARETO_BUCKETS / 1000;
+	if (stat->pareto_bucket >= RE_PARETO_BUCKETS)
+		stat->pareto_bucket = RE_PARETO_BUCKETS - 1;
 }
 
-static int log_thread_exit(unsigned int cpu)
+static int re_pareto_c_ceiling(struct re_policy_ctx *ctx)
 {
-	struct cpufreq_re_log *log = per_cpu(cpufreq_re_log_table, cpu);
-	if (log)
-	{
-		kfree(log->pow_log_data);
-		kfree(log);
-	}
-	return 0;
+	return cpufreq_re_pareto_decide(ctx_to_stat(ctx), ctx->core_fit_rate,
+			ctx->mem_fit_rate)->c_state;
 }
 
-static void thread_collect_data(unsigned int cpu_id)
+static int re_pareto_p_floor(struct re_policy_ctx *ctx)
 {
-	int i;
-	u64 cur_pow, cur_core_fit, cur_mem_fit;
-	struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, cpu_id);
-	struct cpufreq_re_log *log = per_cpu(cpufreq_re_log_table, cpu_id);
-	if (!log)
-		return;
-	cpufreq_re_stats_update(log->cpu);
-	cur_pow = stat->core_pow_acc + stat->mem_pow_acc;
-	cur_core_fit = stat->core_fit_acc;
-	cur_mem_fit = stat->mem_fit_acc;
+	return cpufreq_re_pareto_decide(ctx_to_stat(ctx), ctx->core_fit_rate,
+			ctx->mem_fit_rate)->p_state;
+}
 
-	log->pow_log_data[log->cur_index] = cur_pow - log->last_pow;
-	log->core_fit_data[log->cur_index] = cur_core_fit - log->last_core_fit;
-	log->mem_fit_data[log->cur_index] = cur_mem_fit - log->last_mem_fit;
-	log->freq_data[log->cur_index] = stat->freq_table[stat->last_index]/1000;
+static struct re_policy_ops re_pareto_policy = {
+	.name = "pareto",
+	.epoch_start = re_pareto_epoch_start,
+	.c_ceiling = re_pareto_c_ceiling,
+	.p_floor = re_pareto_p_floor,
+};
+#endif
 
-	log->last_pow = cur_pow;
-	log->last_core_fit = cur_core_fit;
-	log->last_mem_fit = cur_mem_fit;
-	
-	log->cur_index++;
-	if (log->cur_index>=LOG_LENGTH)
-	{
-		for(i=0;i<LOG_LENGTH;i++)
-		{
-			if (log_state)
-				pr_info("RE_LOG %s: %d %llu %llu %llu %llu\n",
-					log_name, i,
-					log->freq_data[i],
-					log->pow_log_data[i],
-					log->core_fit_data[i], 
-					log->mem_fit_data[i]);
-		}
-		log->cur_index = 0;
-	}
-	return;
-}
+static struct re_policy_ops *re_builtin_policies[] = {
+	&re_threshold_policy,
+#ifndef STATIC_POLICY
+	&re_pi_policy,
+	&re_pareto_policy,
+#endif
+	&re_energy_policy,
+};
 
-static int thread_log_fn(void* cpu)
+static int cpufreq_re_builtin_policies_init(void)
 {
-	unsigned int cpu_id = *(int *)cpu;
-
-	while(1) 
-	{
-		msleep(1000/LOG_FREQ);
-		thread_collect_data(cpu_id);
+	int i, ret;
+
+	for (i = 0; i < ARRAY_SIZE(re_builtin_policies); i++) {
+		ret = cpufreq_re_register_policy(re_builtin_policies[i]);
+		if (ret) {
+			while (--i >= 0)
+				cpufreq_re_unregister_policy(re_builtin_policies[i]);
+			return ret;
+		}
 	}
-
+	cpufreq_re_policy_set_default(&re_threshold_policy);
 	return 0;
 }
 
-int cpufreq_re_get_C_states(unsigned int cpu)
+static void cpufreq_re_builtin_policies_exit(void)
 {
-	struct cpufreq_re_stats *stat;
-	unsigned int core_fit_target, mem_fit_target;
-#ifndef STATIC_POLICY
-	unsigned long long cur_wall_time;
-	u64 cycle_core_fit;
-	u64 cycle_mem_fit;
-	int delta;
-#endif
-	stat = per_cpu(cpufreq_re_stats_table, cpu);	
-	if (!stat)
-		return 3;
-#ifndef POLICY_ENABLE
-	return 3;
-#endif
-#ifdef STATIC_POLICY
-	core_fit_target = stat->core_fit_target;
-	mem_fit_target = stat->mem_fit_target;
-#else
-	cpufreq_re_stats_update(cpu);
-	cur_wall_time = jiffies_to_usecs(get_jiffies_64());
-	if (cur_wall_time >= stat->budget_stop_time) {
-		// new control cycle, adjust values accordingly
-		if (stat->budget_target_core_fit_acc < stat->core_fit_acc) {
-			//printk("FIT overflow detected: %llu\n", 
-			//stat->core_fit_acc - stat->budget_target_core_fit_acc);
-		} else {
-			//printk("FIT budget leftover: %llu\n",
-			//stat->budget_target_core_fit_acc - stat->core_fit_acc);
-		}
-#ifndef STATIC_POLICY
-                delta = (int)(cur_wall_time - stat->budget_stop_time) / 1000;
-                if (delta<0)
-                        delta = 0;
-		cycle_core_fit = stat->core_fit_acc + 
-			(unsigned long long)stat->core_fit_target 
-			* (int)(1000000/DYN_FREQ) - stat->budget_target_core_fit_acc;
-                cycle_core_fit = cycle_core_fit 
-                        * ( 1000 - delta );
-		if (cycle_core_fit > stat->cycle_max_core_fit)
-			stat->cycle_max_core_fit = cycle_core_fit;
-		cycle_mem_fit = stat->mem_fit_acc +
-			(unsigned long long)stat->mem_fit_target 
-			* (int)(1000000/DYN_FREQ) - stat->budget_target_mem_fit_acc;
-                cycle_mem_fit = cycle_mem_fit 
-                        * ( 1000 - delta );
-		if (cycle_mem_fit > stat->cycle_max_mem_fit)
-			stat->cycle_max_mem_fit = cycle_mem_fit;
-                if (trace_state) {
-        	        pr_info("TR_LOG C_STATE TIME %s: %llu %llu %llu %llu\n",
-	                        log_name,
-                        	stat->last_idle_state_time[0],
-                	        stat->last_idle_state_time[1],
-        	                stat->last_idle_state_time[2],
-	                        stat->last_idle_state_time[3]
-	                        );
-                        pr_info("TR_LOG CYCLE %s: %llu %llu %llu %llu %llu %llu %llu %u %llu\n",
-                                log_name,
-                                stat->core_fit_acc>>6,
-                                stat->budget_target_core_fit_acc>>6,
-                                (unsigned long long)stat->core_fit_target * (int)(1000000/DYN_FREQ)>>6,
-                                stat->mem_fit_acc>>6, 
-				stat->budget_target_mem_fit_acc>>6,
-                                (unsigned long long)stat->mem_fit_target * (int)(1000000/DYN_FREQ)>>6,
-				cur_wall_time - stat->budget_stop_time,
-				jiffies_to_usecs(get_jiffies_64()),
-				stat->core_pow_acc + stat->mem_pow_acc
-                                );
-                }
-#endif
-		stat->budget_stop_time = jiffies_to_usecs(get_jiffies_64()) + (int)(1000000/DYN_FREQ);
-	        stat->budget_target_core_fit_acc = stat->core_fit_acc 
-        	                + stat->core_fit_target * (int)(1000000/DYN_FREQ);
-	        stat->budget_target_mem_fit_acc = stat->mem_fit_acc
-        	                + stat->mem_fit_target * (int)(1000000/DYN_FREQ); 
-	}
-	// first calculate the fit_budget
-	core_fit_target = (unsigned int)((stat->budget_target_core_fit_acc - stat->core_fit_acc)>>8)
-			/ (unsigned int)((stat->budget_stop_time - cur_wall_time)>>8);
-	mem_fit_target = (unsigned int)((stat->budget_target_mem_fit_acc - stat->mem_fit_acc)>>8)
-			/ (unsigned int)((stat->budget_stop_time - cur_wall_time)>>8);
-#endif
-        if (core_fit_target < stat->cpuidle_c2_fit) {
-                // C1 only
-                return 1;
-        } else if (mem_fit_target < stat->cpuidle_mem_ret_fit) {
-                // C1 or C2
-                return 2;
-        } else {
-                return 3;
-        }
+	int i;
+
+	for (i = ARRAY_SIZE(re_builtin_policies) - 1; i >= 0; i--)
+		cpufreq_re_unregister_policy(re_builtin_policies[i]);
 }
-EXPORT_SYMBOL(cpufreq_re_get_C_states);
 
-int cpufreq_re_get_P_states(unsigned int cpu)
+static int cpufreq_re_get_P_states(unsigned int cpu)
 {
 	struct cpufreq_re_stats *stat;
 	struct cpufreq_re_fit_data * fit_data;
-        unsigned int core_fit_target, mem_fit_target;
-	unsigned int ret;
-#ifndef STATIC_POLICY
         unsigned long long cur_wall_time;
-	u64 cycle_core_fit, cycle_mem_fit;
-	int delta;
+#ifndef STATIC_POLICY
+	unsigned int group_fit_target;
 #endif
 #ifndef POLICY_ENABLE
 	return 0;
 #endif 
 	stat = per_cpu(cpufreq_re_stats_table, cpu);
 	fit_data = per_cpu(cpufreq_re_fit_data_table, cpu);
-	ret = 0x1F;
-	/*
-	printk("%d %d %d %d %d %d\n", stat->core_fit_target, 
-				fit_data->core_fit[4]* stat->location_factor / 100,
-				fit_data->core_fit[3]* stat->location_factor / 100,
-				fit_data->core_fit[2]* stat->location_factor / 100,
-				fit_data->core_fit[1]* stat->location_factor / 100,
-				fit_data->core_fit[0]* stat->location_factor / 100
-		);
-	*/
 	if (!stat || !fit_data)
 		return 0;
-#ifdef STATIC_POLICY
-	core_fit_target = stat->core_fit_target;
-	mem_fit_target = stat->mem_fit_target;
-#else
-        cpufreq_re_stats_update(cpu);
         cur_wall_time = jiffies_to_usecs(get_jiffies_64());
-        if (cur_wall_time >= stat->budget_stop_time) {
-                // new control cycle, adjust values accordingly
-                if (stat->budget_target_core_fit_acc < stat->core_fit_acc) {
-                        //printk("FIT overflow detected: %llu\n",
-                        //stat->core_fit_acc - stat->budget_target_core_fit_acc);
-                } else {
-                        //printk("FIT budget leftover: %llu\n",
-                        //stat->budget_target_core_fit_acc - stat->core_fit_acc);
-                }
 #ifndef STATIC_POLICY
-		delta = (int)(cur_wall_time - stat->budget_stop_time) / 1000;
-		if (delta<0) 
-			delta = 0;
-                cycle_core_fit = stat->core_fit_acc + 
-                        (unsigned long long)stat->core_fit_target 
-                        * (int)(1000000/DYN_FREQ) - stat->budget_target_core_fit_acc;
-		cycle_core_fit = cycle_core_fit 
-			* ( 1000 - delta );
-                if (cycle_core_fit > stat->cycle_max_core_fit)
-                        stat->cycle_max_core_fit = cycle_core_fit;
-                cycle_mem_fit = stat->mem_fit_acc +
-                        (unsigned long long)stat->mem_fit_target 
-                        * (int)(1000000/DYN_FREQ) - stat->budget_target_mem_fit_acc;
-		cycle_mem_fit = cycle_mem_fit 
-			* ( 1000 - delta );
-                if (cycle_mem_fit > stat->cycle_max_mem_fit)
-                        stat->cycle_max_mem_fit = cycle_mem_fit;
-                if (trace_state) {
-	                pr_info("TR_LOG C_STATE TIME %s: %llu %llu %llu %llu\n",
-        	                log_name,
-                	        stat->last_idle_state_time[0],
-                        	stat->last_idle_state_time[1],
-	                        stat->last_idle_state_time[2],
-        	                stat->last_idle_state_time[3]
-                	);
-                        pr_info("TR_LOG CYCLE %s: %llu %llu %llu %llu %llu %llu %llu %u %llu\n",
-                                log_name,
-                                stat->core_fit_acc>>6,
-                                stat->budget_target_core_fit_acc>>6,
-                                (unsigned long long)stat->core_fit_target * (int)(1000000/DYN_FREQ)>>6,
-                                stat->mem_fit_acc>>6,
-                                stat->budget_target_mem_fit_acc>>6,
-                                (unsigned long long)stat->mem_fit_target * (int)(1000000/DYN_FREQ)>>6,
-                                cur_wall_time - stat->budget_stop_time,
-				jiffies_to_usecs(get_jiffies_64()),
-				stat->mem_pow_acc + stat->core_pow_acc
-                                );
-                }
+        cpufreq_re_stats_update(cpu);
+        cpufreq_re_epoch_check(stat, cur_wall_time);
+        if (trace_state)
+		cpufreq_re_trace_C_time(stat);
 #endif
-                stat->budget_stop_time = jiffies_to_usecs(get_jiffies_64()) + (int)(1000000/DYN_FREQ);
-                stat->budget_target_core_fit_acc = stat->core_fit_acc
-                                + stat->core_fit_target * (int)(1000000/DYN_FREQ);
-                stat->budget_target_mem_fit_acc = stat->mem_fit_acc
-                                + stat->mem_fit_target * (int)(1000000/DYN_FREQ);
-        }
-        if (trace_state) {
-                pr_info("TR_LOG C_STATE TIME %s: %llu %llu %llu %llu\n",
-                        log_name,
-                        stat->last_idle_state_time[0],
-                        stat->last_idle_state_time[1],
-                        stat->last_idle_state_time[2],
-                        stat->last_idle_state_time[3]
-                        );
-        }
-        // first calculate the fit_budget
-        core_fit_target = (unsigned int)((stat->budget_target_core_fit_acc - stat->core_fit_acc)>>8)
-                        / (unsigned int)((stat->budget_stop_time - cur_wall_time)>>8);
-        mem_fit_target = (unsigned int)((stat->budget_target_mem_fit_acc - stat->mem_fit_acc)>>8)
-                        / (unsigned int)((stat->budget_stop_time - cur_wall_time)>>8);
+	cpufreq_re_ctx_update(stat, cur_wall_time);
+	stat->last_P_state = cpufreq_re_policy_p_floor(&stat->ctx);
+#ifndef STATIC_POLICY
+	// a cgroup with its own budget can only raise the cpu wide floor
+	if (!cpufreq_re_cgroup_fit_target(cpu, cur_wall_time,
+				(int)(1000000/DYN_FREQ), &group_fit_target))
+		stat->last_P_state = max(stat->last_P_state,
+				cpufreq_re_total_fit_P_state(stat, fit_data,
+					group_fit_target));
+	stat->last_P_state = cpufreq_re_P_hold(stat, fit_data,
+			stat->last_P_state, stat->ctx.core_fit_rate,
+			stat->ctx.mem_fit_rate, cur_wall_time);
+
+	stat->last_P_ceiling = INT_MAX;
+	if (energy_cap_mode != RE_ENERGY_OFF && power_cap) {
+		stat->last_P_ceiling = cpufreq_re_energy_P_ceiling(stat,
+				fit_data, cur_wall_time);
+		if (stat->last_P_state > stat->last_P_ceiling)
+			stat->energy_conflicts++;
+	}
+	// lifetime wear caps the OPP like the energy budget does
+	stat->last_wear_ceiling = INT_MAX;
+	if (wear_life) {
+		stat->last_wear_ceiling = cpufreq_re_wear_P_ceiling(stat,
+				fit_data, cur_wall_time);
+		if (stat->last_P_state > stat->last_wear_ceiling)
+			stat->wear_conflicts++;
+		if (stat->last_wear_ceiling < stat->last_P_ceiling)
+			stat->last_P_ceiling = stat->last_wear_ceiling;
+	}
 #endif
-	if (core_fit_target >= fit_data->core_fit[4]
-                                * stat->location_factor / 100)
-		ret &= 0x1F;
-	else if (core_fit_target >= fit_data->core_fit[3]
-                                * stat->location_factor / 100)
-		ret &= 0xF;
-        else if (core_fit_target >= fit_data->core_fit[2]
-                                * stat->location_factor / 100)
-                ret &= 0x7;
-        else if (core_fit_target >= fit_data->core_fit[1]
-                                * stat->location_factor / 100)
-                ret &= 0x3;
-        else if (core_fit_target >= fit_data->core_fit[0]
-                                * stat->location_factor / 100)
-                ret &= 0x1;
-	else
-		ret &= 0x0;
-	if (mem_fit_target >= (fit_data->L1_mem_fit[4] + fit_data->L2_mem_fit)
-                                * stat->location_factor / 100)
-                ret &= 0x1F;
-        else if (mem_fit_target >= (fit_data->L1_mem_fit[3] + fit_data->L2_mem_fit)
-                                * stat->location_factor / 100)
-		ret &= 0xF;
-        else if (mem_fit_target >= (fit_data->L1_mem_fit[2] + fit_data->L2_mem_fit)
-                                * stat->location_factor / 100)
-                ret &= 0x7;
-        else if (mem_fit_target >= (fit_data->L1_mem_fit[1] + fit_data->L2_mem_fit)
-                                * stat->location_factor / 100)
-                ret &= 0x3;
-        else if (mem_fit_target >= (fit_data->L1_mem_fit[0] + fit_data->L2_mem_fit)
-                                * stat->location_factor / 100)
-                ret &= 0x1;
-	else
-		ret &= 0x0;
+	// model P-state to an index into the driver table
+	return re_platform_P_index(&stat->plat, stat->last_P_state, 0);
+}
 
-	switch(ret) {
-		case 0x1F:
-			return 0;
-			break;
-		case 0xF:
-			return 1;
-			break;
-		case 0x7:
-			return 2;
-			break;
-		case 0x3:
-			return 3;
-			break;
-		case 0x1:
-			return 4;
-			break;
-		default:
-			return 0;
-	}
+/*
+ * Highest P-state allowed by the energy cap and the wear budget, as
+ * decided by the last cpufreq_re_get_P_states() call. Both win over
+ * the FIT floor.
+ */
+static int cpufreq_re_get_P_ceiling(unsigned int cpu)
+{
+	struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, cpu);
+
+	if (!stat)
+		return INT_MAX;
+	return re_platform_P_index(&stat->plat, stat->last_P_ceiling, 1);
 }
-EXPORT_SYMBOL_GPL(cpufreq_re_get_P_states);
 
-int cpufreq_re_report_C_states(int entered_state, int C_state_flag, 
+static int cpufreq_re_report_C_states(int entered_state, int C_state_flag, 
 				int residency) {
 	if (trace_state) {
 		pr_info("TR_LOG C %s: %d %d %d\n", log_name,
@@ -1182,9 +2765,21 @@ int cpufreq_re_report_C_states(int entered_state, int C_state_flag,
 	}
 	return 0;
 }
-EXPORT_SYMBOL_GPL(cpufreq_re_report_C_states);
 
-int cpufreq_re_report_P_states(int actual_state, int ideal_state)
+/*
+ * Called by cpuidle after every idle period, hands it to the active
+ * policy.
+ */
+static void cpufreq_re_report_idle_exit(unsigned int cpu, int state, int residency)
+{
+	struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, cpu);
+
+	if (stat)
+		cpufreq_re_policy_idle_exit(&stat->ctx,
+				re_platform_idle_class(&stat->plat, state), residency);
+}
+
+static int cpufreq_re_report_P_states(int actual_state, int ideal_state)
 {
         if (trace_state) {
                 pr_info("TR_LOG P %s: %d %d %u\n", log_name,
@@ -1192,7 +2787,56 @@ int cpufreq_re_report_P_states(int actual_state, int ideal_state)
         }
         return 0;
 }
-EXPORT_SYMBOL_GPL(cpufreq_re_report_P_states);
+
+/*
+ * Called by the cpufreq driver after a completed frequency change with
+ * the time spent in regulator and clock calls.
+ */
+static int cpufreq_re_report_transition(unsigned int cpu, unsigned int usec)
+{
+	struct cpufreq_re_stats *stat = per_cpu(cpufreq_re_stats_table, cpu);
+
+	if (!stat)
+		return -ENODEV;
+	spin_lock(&cpufreq_re_stats_lock);
+	stat->transitions++;
+	stat->transition_time += usec;
+	stat->ctx.last_transition_time = usec;
+	stat->transition_energy += (u64)usec
+			* (stat->rates.cur_core_pow + stat->rates.cur_mem_pow);
+	if (stat->avg_transition_time)
+		stat->avg_transition_time = (stat->avg_transition_time * 7
+				+ usec) / 8;
+	else
+		stat->avg_transition_time = usec;
+	spin_unlock(&cpufreq_re_stats_lock);
+	if (trace_state)
+		pr_info("TR_LOG TRANSITION %s: %u %u\n", log_name, usec,
+			jiffies_to_usecs(get_jiffies_64()));
+	return 0;
+}
+
+static const struct cpufreq_re_hooks cpufreq_re_stats_hooks = {
+	.get_C_states = cpufreq_re_get_C_states,
+	.report_C_states = cpufreq_re_report_C_states,
+	.report_idle_exit = cpufreq_re_report_idle_exit,
+	.report_idle_late = cpufreq_re_calib_late,
+	.get_P_states = cpufreq_re_get_P_states,
+	.get_P_ceiling = cpufreq_re_get_P_ceiling,
+	.report_P_states = cpufreq_re_report_P_states,
+	.report_transition = cpufreq_re_report_transition,
+	.stats_sync = cpufreq_re_stats_sync,
+};
+
+// the static entry points, for cpufreq_re_bench only
+const struct cpufreq_re_bench_ops cpufreq_re_bench_ops = {
+	.get_C_states = cpufreq_re_get_C_states,
+	.get_P_states = cpufreq_re_get_P_states,
+	.stats_update = cpufreq_re_stats_update,
+	.notifier_trans = cpufreq_re_stat_notifier_trans,
+	.show_core_fit_acc = show_core_fit_acc,
+};
+EXPORT_SYMBOL_GPL(cpufreq_re_bench_ops);
 
 static int cpufreq_re_report_FIT(unsigned int cpu)
 {
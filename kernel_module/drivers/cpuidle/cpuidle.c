@@ -22,11 +22,14 @@
 #include <linux/ktime.h>
 #include <linux/hrtimer.h>
 #include <linux/module.h>
+#include <linux/tick.h>
+#include <linux/cpufreq_re.h>
 #include <trace/events/power.h>
 
 #include "cpuidle.h"
 
 DEFINE_PER_CPU(struct cpuidle_device *, cpuidle_devices);
+EXPORT_PER_CPU_SYMBOL_GPL(cpuidle_devices);
 DEFINE_PER_CPU(struct cpuidle_device, cpuidle_dev);
 
 DEFINE_MUTEX(cpuidle_lock);
@@ -67,6 +70,21 @@ int cpuidle_play_dead(void)
 	return -ENODEV;
 }
 
+/*
+ * When the per cpu clock event is due, the end of the idle period
+ * unless another interrupt comes first. KTIME_MAX when unknown.
+ */
+static ktime_t cpuidle_next_wakeup(void)
+{
+#ifdef CONFIG_GENERIC_CLOCKEVENTS
+	struct clock_event_device *evt = __this_cpu_read(tick_cpu_device.evtdev);
+
+	if (evt)
+		return evt->next_event;
+#endif
+	return ktime_set(KTIME_SEC_MAX, 0);
+}
+
 /**
  * cpuidle_enter_state - enter the state and update stats
  * @dev: cpuidle device for this cpu
@@ -79,9 +97,12 @@ int cpuidle_enter_state(struct cpuidle_device *dev, struct cpuidle_driver *drv,
 	int entered_state;
 
 	struct cpuidle_state *target_state = &drv->states[index];
-	ktime_t time_start, time_end;
+	ktime_t time_start, time_end, wakeup;
 	s64 diff;
 
+	// only the cpufreq_re exit latency calibration looks at it
+	wakeup = cpufreq_re_hooks_active() ? cpuidle_next_wakeup()
+			: ktime_set(KTIME_SEC_MAX, 0);
 	time_start = ktime_get();
 
 	entered_state = target_state->enter(dev, drv, index);
@@ -103,6 +124,13 @@ int cpuidle_enter_state(struct cpuidle_device *dev, struct cpuidle_driver *drv,
 		 */
 		dev->states_usage[entered_state].time += dev->last_residency;
 		dev->states_usage[entered_state].usage++;
+		// woken by the timer: the lateness is the exit overhead
+		if (ktime_to_ns(wakeup) > ktime_to_ns(time_start) &&
+		    ktime_to_ns(time_end) >= ktime_to_ns(wakeup)) {
+			diff = ktime_to_us(ktime_sub(time_end, wakeup));
+			cpufreq_re_hook_report_idle_late(dev->cpu, entered_state,
+					diff > INT_MAX ? INT_MAX : (int)diff);
+		}
 	} else {
 		dev->last_residency = 0;
 	}
@@ -116,9 +144,8 @@ int cpuidle_enter_state(struct cpuidle_device *dev, struct cpuidle_driver *drv,
  * NOTE: no locks or semaphores should be used here
  * return non-zero on failure
  */
-extern int cpufreq_re_get_C_states(unsigned int cpu);
-extern int cpufreq_re_report_C_states(int entered_state, int C_state_flag,
-                                int residency);
+// set on each cpu whose device the re_menu governor has enabled
+DEFINE_PER_CPU(int, cpuidle_re_governor);
 
 int cpuidle_idle_call(void)
 {
@@ -139,8 +166,15 @@ int cpuidle_idle_call(void)
 
 	drv = cpuidle_get_cpu_driver(dev);
 
+	if (!cpufreq_re_hooks_active() || __this_cpu_read(cpuidle_re_governor)) {
+		/* single pass, no ceiling or the governor applies it */
+		next_state = cpuidle_curr_governor->select(drv, dev);
+		ideal_next_state = next_state;
+		goto selected;
+	}
+
 	// cpufreq_re reflect the available state here
-	cpufreq_re_C_states = cpufreq_re_get_C_states(dev->cpu);
+	cpufreq_re_C_states = cpufreq_re_hook_get_C_states(dev->cpu);
 
 	ideal_next_state = cpuidle_curr_governor->select(drv, dev);
 
@@ -154,6 +188,7 @@ int cpuidle_idle_call(void)
 	}
 	/* ask the governor for the next state */
 	next_state = cpuidle_curr_governor->select(drv, dev);
+selected:
 	if (need_resched()) {
 		dev->last_residency = 0;
 		/* give the governor an opportunity to reflect on the outcome */
@@ -181,10 +216,16 @@ int cpuidle_idle_call(void)
 
 	trace_cpu_idle_rcuidle(PWR_EVENT_EXIT, dev->cpu);
 
-	if (ideal_next_state != entered_state) {
-		// trace recording here
-		cpufreq_re_report_C_states(entered_state, ideal_next_state,
-			dev->last_residency);
+	if (cpufreq_re_hooks_active()) {
+		if (!__this_cpu_read(cpuidle_re_governor) &&
+		    ideal_next_state != entered_state) {
+			// trace recording here
+			cpufreq_re_hook_report_C_states(entered_state,
+				ideal_next_state, dev->last_residency);
+		}
+		if (entered_state >= 0)
+			cpufreq_re_hook_report_idle_exit(dev->cpu,
+				entered_state, dev->last_residency);
 	}
 
 	/* give the governor an opportunity to reflect on the outcome */
@@ -0,0 +1,419 @@
+/*
+ * re_menu.c - reliability aware variant of the menu idle governor
+ *
+ * Derived from drivers/cpuidle/governors/menu.c
+ * Copyright (C) 2006-2007 Adam Belay <abelay@novell.com>
+ * Copyright (C) 2009 Intel Corporation
+ *
+ * The menu heuristics are unchanged. The C-state ceiling from
+ * cpufreq_re_stats is applied inside the single selection pass instead
+ * of rewriting drv->states[i].disabled around a second select() call,
+ * and the unconstrained choice is kept for cpufreq_re_report_C_states().
+ *
+ * This code is licenced under the GPL version 2 as described
+ * in the COPYING file that acompanies the Linux Kernel.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuidle.h>
+#include <linux/pm_qos.h>
+#include <linux/time.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/tick.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/cpufreq_re.h>
+
+#define BUCKETS 12
+#define INTERVALS 8
+#define RESOLUTION 1024
+#define DECAY 8
+#define MAX_INTERESTING 50000
+
+DECLARE_PER_CPU(int, cpuidle_re_governor);
+
+struct re_menu_device {
+	int		last_state_idx;
+	int		ideal_state_idx;	// choice without the ceiling
+	int		needs_update;
+
+	unsigned int	expected_us;
+	unsigned int	predicted_us;
+	unsigned int	exit_us;
+	unsigned int	bucket;
+	unsigned int	correction_factor[BUCKETS];
+	unsigned int	intervals[INTERVALS];
+	int		interval_ptr;
+};
+
+#define LOAD_INT(x) ((x) >> FSHIFT)
+#define LOAD_FRAC(x) LOAD_INT(((x) & (FIXED_1-1)) * 100)
+
+static int get_loadavg(void)
+{
+	unsigned long this = this_cpu_load();
+
+	return LOAD_INT(this) * 10 + LOAD_FRAC(this) / 10;
+}
+
+static inline int which_bucket(unsigned int duration)
+{
+	int bucket = 0;
+
+	/*
+	 * We keep two groups of stats; one with no
+	 * IO pending, one without.
+	 * This allows us to calculate
+	 * E(duration)|iowait
+	 */
+	if (nr_iowait_cpu(smp_processor_id()))
+		bucket = BUCKETS/2;
+
+	if (duration < 10)
+		return bucket;
+	if (duration < 100)
+		return bucket + 1;
+	if (duration < 1000)
+		return bucket + 2;
+	if (duration < 10000)
+		return bucket + 3;
+	if (duration < 100000)
+		return bucket + 4;
+	return bucket + 5;
+}
+
+/*
+ * Return a multiplier for the exit latency that is intended
+ * to take performance requirements into account.
+ * The more performance critical we estimate the system
+ * to be, the higher this multiplier, and thus the higher
+ * the barrier to go to an expensive C state.
+ */
+static inline int performance_multiplier(void)
+{
+	int mult = 1;
+
+	/* for higher loadavg, we are more reluctant */
+	mult += 2 * get_loadavg();
+
+	/* for IO wait tasks (per cpu!) we add 5x each */
+	mult += 10 * nr_iowait_cpu(smp_processor_id());
+
+	return mult;
+}
+
+static DEFINE_PER_CPU(struct re_menu_device, re_menu_devices);
+
+static void re_menu_update(struct cpuidle_driver *drv, struct cpuidle_device *dev);
+
+/* This implements DIV_ROUND_CLOSEST but avoids 64 bit division */
+static u64 div_round64(u64 dividend, u32 divisor)
+{
+	return div_u64(dividend + (divisor / 2), divisor);
+}
+
+/*
+ * Try detecting repeating patterns by keeping track of the last 8
+ * intervals, and checking if the standard deviation of that set
+ * of points is below a threshold. If it is... then use the
+ * average of these 8 points as the estimated value.
+ */
+static void get_typical_interval(struct re_menu_device *data)
+{
+	int i, divisor;
+	unsigned int max, thresh;
+	uint64_t avg, stddev;
+
+	thresh = UINT_MAX; /* Discard outliers above this value */
+
+again:
+
+	/* First calculate the average of past intervals */
+	max = 0;
+	avg = 0;
+	divisor = 0;
+	for (i = 0; i < INTERVALS; i++) {
+		unsigned int value = data->intervals[i];
+		if (value <= thresh) {
+			avg += value;
+			divisor++;
+			if (value > max)
+				max = value;
+		}
+	}
+	do_div(avg, divisor);
+
+	/* Then try to determine standard deviation */
+	stddev = 0;
+	for (i = 0; i < INTERVALS; i++) {
+		unsigned int value = data->intervals[i];
+		if (value <= thresh) {
+			int64_t diff = value - avg;
+			stddev += diff * diff;
+		}
+	}
+	do_div(stddev, divisor);
+	/*
+	 * The typical interval is obtained when standard deviation is small
+	 * or standard deviation is small compared to the average interval.
+	 *
+	 * int_sqrt() formal parameter type is unsigned long. When the
+	 * greatest difference to an outlier exceeds ~65 ms * sqrt(divisor)
+	 * the resulting squared standard deviation exceeds the input domain
+	 * of int_sqrt on platforms where unsigned long is 32 bits in size.
+	 * In such case reject the candidate average.
+	 *
+	 * Use this result only if there is no timer to wake us up sooner.
+	 */
+	if (likely(stddev <= ULONG_MAX)) {
+		stddev = int_sqrt(stddev);
+		if (((avg > stddev * 6) && (divisor * 4 >= INTERVALS * 3))
+							|| stddev <= 20) {
+			if (data->expected_us > avg)
+				data->predicted_us = avg;
+			return;
+		}
+	}
+
+	/*
+	 * If we have outliers to the upside in our distribution, discard
+	 * those by setting the threshold to exclude these outliers, then
+	 * calculate the average and standard deviation again. Once we get
+	 * down to the bottom 3/4 of our samples, stop excluding samples.
+	 *
+	 * This can deal with workloads that have long pauses interspersed
+	 * with sporadic activity with a bunch of short pauses.
+	 */
+	if ((divisor * 4) <= INTERVALS * 3)
+		return;
+
+	thresh = max - 1;
+	goto again;
+}
+
+/**
+ * re_menu_select - selects the next idle state to enter
+ * @drv: cpuidle driver containing state data
+ * @dev: the CPU
+ */
+static int re_menu_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
+{
+	struct re_menu_device *data = &__get_cpu_var(re_menu_devices);
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	int i;
+	int multiplier;
+	int ceiling;
+	struct timespec t;
+
+	if (data->needs_update) {
+		re_menu_update(drv, dev);
+		data->needs_update = 0;
+	}
+
+	// reliability ceiling, also advances the cpufreq_re accounting
+	ceiling = cpufreq_re_hook_get_C_states(dev->cpu);
+
+	data->last_state_idx = 0;
+	data->ideal_state_idx = 0;
+	data->exit_us = 0;
+
+	/* Special case when user has set very strict latency requirement */
+	if (unlikely(latency_req == 0))
+		return 0;
+
+	/* determine the expected residency time, round up */
+	t = ktime_to_timespec(tick_nohz_get_sleep_length());
+	data->expected_us =
+		t.tv_sec * USEC_PER_SEC + t.tv_nsec / NSEC_PER_USEC;
+
+
+	data->bucket = which_bucket(data->expected_us);
+
+	multiplier = performance_multiplier();
+
+	/*
+	 * if the correction factor is 0 (eg first time init or cpu hotplug
+	 * etc), we actually want to start out with a unity factor.
+	 */
+	if (data->correction_factor[data->bucket] == 0)
+		data->correction_factor[data->bucket] = RESOLUTION * DECAY;
+
+	/* Make sure to round up for half microseconds */
+	data->predicted_us = div_round64(data->expected_us * data->correction_factor[data->bucket],
+					 RESOLUTION * DECAY);
+
+	get_typical_interval(data);
+
+	/*
+	 * We want to default to C1 (hlt), not to busy polling
+	 * unless the timer is happening really really soon.
+	 */
+	if (data->expected_us > 5 &&
+	    !drv->states[CPUIDLE_DRIVER_STATE_START].disabled &&
+		dev->states_usage[CPUIDLE_DRIVER_STATE_START].disable == 0) {
+		data->ideal_state_idx = CPUIDLE_DRIVER_STATE_START;
+		if (CPUIDLE_DRIVER_STATE_START <= ceiling)
+			data->last_state_idx = CPUIDLE_DRIVER_STATE_START;
+	}
+
+	/*
+	 * Find the idle state with the lowest power while satisfying
+	 * our constraints. States above the ceiling only count for the
+	 * ideal choice.
+	 */
+	for (i = CPUIDLE_DRIVER_STATE_START; i < drv->state_count; i++) {
+		struct cpuidle_state *s = &drv->states[i];
+		struct cpuidle_state_usage *su = &dev->states_usage[i];
+
+		if (s->disabled || su->disable)
+			continue;
+		if (s->target_residency > data->predicted_us)
+			continue;
+		if (s->exit_latency > latency_req)
+			continue;
+		if (s->exit_latency * multiplier > data->predicted_us)
+			continue;
+
+		data->ideal_state_idx = i;
+		if (i > ceiling)
+			continue;
+		data->last_state_idx = i;
+		data->exit_us = s->exit_latency;
+	}
+
+	return data->last_state_idx;
+}
+
+/**
+ * re_menu_reflect - records that data structures need update
+ * @dev: the CPU
+ * @index: the index of actual entered state
+ *
+ * NOTE: it's important to be fast here because this operation will add to
+ *       the overall exit latency.
+ */
+static void re_menu_reflect(struct cpuidle_device *dev, int index)
+{
+	struct re_menu_device *data = &__get_cpu_var(re_menu_devices);
+
+	data->last_state_idx = index;
+	if (index >= 0)
+		data->needs_update = 1;
+
+	// last_residency is 0 when the entry was aborted by need_resched()
+	if (index >= 0 && dev->last_residency &&
+	    data->ideal_state_idx != index)
+		cpufreq_re_hook_report_C_states(index, data->ideal_state_idx,
+				dev->last_residency);
+}
+
+/**
+ * re_menu_update - attempts to guess what happened after entry
+ * @drv: cpuidle driver containing state data
+ * @dev: the CPU
+ */
+static void re_menu_update(struct cpuidle_driver *drv, struct cpuidle_device *dev)
+{
+	struct re_menu_device *data = &__get_cpu_var(re_menu_devices);
+	int last_idx = data->last_state_idx;
+	unsigned int last_idle_us = cpuidle_get_last_residency(dev);
+	struct cpuidle_state *target = &drv->states[last_idx];
+	unsigned int measured_us;
+	unsigned int new_factor;
+
+	/*
+	 * Ugh, this idle state doesn't support residency measurements, so we
+	 * are basically lost in the dark.  As a compromise, assume we slept
+	 * for the whole expected time.
+	 */
+	if (unlikely(!(target->flags & CPUIDLE_FLAG_TIME_VALID)))
+		last_idle_us = data->expected_us;
+
+
+	measured_us = last_idle_us;
+
+	/*
+	 * We correct for the exit latency; we are assuming here that the
+	 * exit latency happens after the event that we're interested in.
+	 */
+	if (measured_us > data->exit_us)
+		measured_us -= data->exit_us;
+
+
+	/* update our correction ratio */
+
+	new_factor = data->correction_factor[data->bucket];
+	new_factor -= new_factor / DECAY;
+
+	if (data->expected_us > 0 && measured_us < MAX_INTERESTING)
+		new_factor += RESOLUTION * measured_us / data->expected_us;
+	else
+		/*
+		 * we were idle so long that we count it as a perfect
+		 * prediction
+		 */
+		new_factor += RESOLUTION;
+
+	/*
+	 * We don't want 0 as factor; we always want at least
+	 * a tiny bit of estimated time.
+	 */
+	if (new_factor == 0)
+		new_factor = 1;
+
+	data->correction_factor[data->bucket] = new_factor;
+
+	/* update the repeating-pattern data */
+	data->intervals[data->interval_ptr++] = last_idle_us;
+	if (data->interval_ptr >= INTERVALS)
+		data->interval_ptr = 0;
+}
+
+/**
+ * re_menu_enable_device - scans a CPU's states and does setup
+ * @drv: cpuidle driver
+ * @dev: the CPU
+ */
+static int re_menu_enable_device(struct cpuidle_driver *drv,
+				struct cpuidle_device *dev)
+{
+	struct re_menu_device *data = &per_cpu(re_menu_devices, dev->cpu);
+	int i;
+
+	memset(data, 0, sizeof(struct re_menu_device));
+
+	// undo the ceiling cpuidle_idle_call() left behind for other governors
+	for (i = 0; i < drv->state_count; i++)
+		drv->states[i].disabled = false;
+	per_cpu(cpuidle_re_governor, dev->cpu) = 1;
+
+	return 0;
+}
+
+static void re_menu_disable_device(struct cpuidle_driver *drv,
+				struct cpuidle_device *dev)
+{
+	per_cpu(cpuidle_re_governor, dev->cpu) = 0;
+}
+
+static struct cpuidle_governor re_menu_governor = {
+	.name =		"re_menu",
+	.rating =	19,		// below menu, selected through sysfs
+	.enable =	re_menu_enable_device,
+	.disable =	re_menu_disable_device,
+	.select =	re_menu_select,
+	.reflect =	re_menu_reflect,
+	.owner =	THIS_MODULE,
+};
+
+/**
+ * init_re_menu - initializes the governor
+ */
+static int __init init_re_menu(void)
+{
+	return cpuidle_register_governor(&re_menu_governor);
+}
+
+postcore_initcall(init_re_menu);
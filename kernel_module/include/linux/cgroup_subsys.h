@@ -0,0 +1,88 @@
+/* Add subsystem definitions of the form SUBSYS(<name>) in this
+ * file. Surround each one by a line of comment markers so that
+ * patches don't collide
+ */
+
+/* */
+
+/* */
+
+#if IS_SUBSYS_ENABLED(CONFIG_CPUSETS)
+SUBSYS(cpuset)
+#endif
+
+/* */
+
+#if IS_SUBSYS_ENABLED(CONFIG_CGROUP_DEBUG)
+SUBSYS(debug)
+#endif
+
+/* */
+
+#if IS_SUBSYS_ENABLED(CONFIG_CGROUP_SCHED)
+SUBSYS(cpu_cgroup)
+#endif
+
+/* */
+
+#if IS_SUBSYS_ENABLED(CONFIG_CGROUP_CPUACCT)
+SUBSYS(cpuacct)
+#endif
+
+/* */
+
+#if IS_SUBSYS_ENABLED(CONFIG_MEMCG)
+SUBSYS(mem_cgroup)
+#endif
+
+/* */
+
+#if IS_SUBSYS_ENABLED(CONFIG_CGROUP_DEVICE)
+SUBSYS(devices)
+#endif
+
+/* */
+
+#if IS_SUBSYS_ENABLED(CONFIG_CGROUP_FREEZER)
+SUBSYS(freezer)
+#endif
+
+/* */
+
+#if IS_SUBSYS_ENABLED(CONFIG_NET_CLS_CGROUP)
+SUBSYS(net_cls)
+#endif
+
+/* */
+
+#if IS_SUBSYS_ENABLED(CONFIG_BLK_CGROUP)
+SUBSYS(blkio)
+#endif
+
+/* */
+
+#if IS_SUBSYS_ENABLED(CONFIG_CGROUP_PERF)
+SUBSYS(perf)
+#endif
+
+/* */
+
+#if IS_SUBSYS_ENABLED(CONFIG_NETPRIO_CGROUP)
+SUBSYS(net_prio)
+#endif
+
+/* */
+
+#if IS_SUBSYS_ENABLED(CONFIG_CGROUP_HUGETLB)
+SUBSYS(hugetlb)
+#endif
+
+/* */
+
+/* reliability accounting, drivers/cpufreq/cpufreq_re_cgroup.c,
+ * built in even when cpufreq_re_stats is a module */
+#if IS_ENABLED(CONFIG_CPU_FREQ_STAT) && IS_SUBSYS_ENABLED(CONFIG_CPU_FREQ)
+SUBSYS(re)
+#endif
+
+/* */
@@ -0,0 +1,145 @@
+/*
+ *  include/linux/cpufreq_re.h
+ *
+ * cpufreq_re.h : interface between the cpuidle / cpufreq paths and the
+ * reliability engine (cpufreq_re_stats). The engine registers its hooks
+ * when it is loaded; until then each call site is a static key branch
+ * patched to a NOP and returns the "no constraint" value.
+ *
+ */
+
+#ifndef _LINUX_CPUFREQ_RE_H
+#define _LINUX_CPUFREQ_RE_H
+
+#include <linux/compiler.h>
+#include <linux/jump_label.h>
+#include <linux/kernel.h>
+
+struct cpufreq_re_hooks {
+	// cpuidle
+	int (*get_C_states)(unsigned int cpu);
+	int (*report_C_states)(int entered_state, int C_state_flag,
+			int residency);
+	void (*report_idle_exit)(unsigned int cpu, int state, int residency);
+	void (*report_idle_late)(unsigned int cpu, int state, int late_us);
+	// cpufreq
+	int (*get_P_states)(unsigned int cpu);
+	int (*get_P_ceiling)(unsigned int cpu);
+	int (*report_P_states)(int actual_state, int ideal_state);
+	int (*report_transition)(unsigned int cpu, unsigned int usec);
+	// cgroup accounting
+	int (*stats_sync)(unsigned int cpu);
+};
+
+#ifdef CONFIG_CPU_FREQ
+extern struct static_key cpufreq_re_hooks_key;
+extern const struct cpufreq_re_hooks *cpufreq_re_hooks;
+
+int cpufreq_re_register_hooks(const struct cpufreq_re_hooks *hooks);
+void cpufreq_re_unregister_hooks(const struct cpufreq_re_hooks *hooks);
+
+static inline bool cpufreq_re_hooks_active(void)
+{
+	return static_key_false(&cpufreq_re_hooks_key);
+}
+
+static inline const struct cpufreq_re_hooks *cpufreq_re_hooks_get(void)
+{
+	return ACCESS_ONCE(cpufreq_re_hooks);
+}
+#else
+static inline bool cpufreq_re_hooks_active(void)
+{
+	return false;
+}
+
+static inline const struct cpufreq_re_hooks *cpufreq_re_hooks_get(void)
+{
+	return NULL;
+}
+#endif
+
+/*
+ * Call sites. The defaults are what the callers did before the engine
+ * existed: all C-states, no P-state floor or ceiling.
+ */
+#define CPUFREQ_RE_HOOK(name, dflt, args...)				\
+({									\
+	const struct cpufreq_re_hooks *__h;				\
+	typeof(dflt) __ret = (dflt);					\
+									\
+	if (cpufreq_re_hooks_active()) {				\
+		__h = cpufreq_re_hooks_get();				\
+		if (__h && __h->name)					\
+			__ret = __h->name(args);			\
+	}								\
+	__ret;								\
+})
+
+#define CPUFREQ_RE_HOOK_VOID(name, args...)				\
+do {									\
+	const struct cpufreq_re_hooks *__h;				\
+									\
+	if (cpufreq_re_hooks_active()) {				\
+		__h = cpufreq_re_hooks_get();				\
+		if (__h && __h->name)					\
+			__h->name(args);				\
+	}								\
+} while (0)
+
+static inline int cpufreq_re_hook_get_C_states(unsigned int cpu)
+{
+	return CPUFREQ_RE_HOOK(get_C_states, INT_MAX, cpu);
+}
+
+static inline int cpufreq_re_hook_report_C_states(int entered_state,
+			int C_state_flag, int residency)
+{
+	return CPUFREQ_RE_HOOK(report_C_states, 0, entered_state,
+			C_state_flag, residency);
+}
+
+static inline void cpufreq_re_hook_report_idle_exit(unsigned int cpu,
+			int state, int residency)
+{
+	CPUFREQ_RE_HOOK_VOID(report_idle_exit, cpu, state, residency);
+}
+
+/*
+ * An idle period ended by the timer it was programmed for, late_us
+ * after that timer expired.
+ */
+static inline void cpufreq_re_hook_report_idle_late(unsigned int cpu,
+			int state, int late_us)
+{
+	CPUFREQ_RE_HOOK_VOID(report_idle_late, cpu, state, late_us);
+}
+
+static inline int cpufreq_re_hook_get_P_states(unsigned int cpu)
+{
+	return CPUFREQ_RE_HOOK(get_P_states, 0, cpu);
+}
+
+static inline int cpufreq_re_hook_get_P_ceiling(unsigned int cpu)
+{
+	return CPUFREQ_RE_HOOK(get_P_ceiling, INT_MAX, cpu);
+}
+
+static inline int cpufreq_re_hook_report_P_states(int actual_state,
+			int ideal_state)
+{
+	return CPUFREQ_RE_HOOK(report_P_states, 0, actual_state, ideal_state);
+}
+
+static inline int cpufreq_re_hook_report_transition(unsigned int cpu,
+			unsigned int usec)
+{
+	return CPUFREQ_RE_HOOK(report_transition, 0, cpu, usec);
+}
+
+static inline int cpufreq_re_hook_stats_sync(unsigned int cpu)
+{
+	return CPUFREQ_RE_HOOK(stats_sync, 0, cpu);
+}
+
+#endif
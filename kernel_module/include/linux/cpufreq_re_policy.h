@@ -0,0 +1,90 @@
+/*
+ *  include/linux/cpufreq_re_policy.h
+ *
+ * cpufreq_re_policy.h : interface for reliability policies plugged
+ * into cpufreq_re_stats. A policy turns the budget state of a cpu into
+ * the C-state ceiling and P-state floor; accounting, epochs, cgroups,
+ * the energy cap and PM QoS stay in cpufreq_re_stats.
+ *
+ */
+
+#ifndef _LINUX_CPUFREQ_RE_POLICY_H
+#define _LINUX_CPUFREQ_RE_POLICY_H
+
+#include <linux/list.h>
+#include <linux/types.h>
+
+#define RE_POLICY_NAME_LEN 16
+
+struct module;
+struct cpufreq_re_fit_data;
+
+/*
+ * Per cpu view handed to the callbacks. FIT values are rates (per usec),
+ * already scaled by location_factor. Callbacks run with interrupts
+ * possibly disabled (idle path) and must not sleep.
+ */
+struct re_policy_ctx {
+	unsigned int cpu;
+	unsigned int epoch;
+	unsigned long long now;			// usec
+	unsigned int epoch_len;			// usec
+	// remaining allowance of the running cycle
+	unsigned int core_fit_rate;
+	unsigned int mem_fit_rate;
+	// per cycle targets and the bank carried into the cycle
+	unsigned int core_fit_target;
+	unsigned int mem_fit_target;
+	s64 core_fit_bank;
+	s64 mem_fit_bank;
+	// the cycle that just closed, valid in epoch_start()
+	unsigned int prev_core_setpoint;
+	unsigned int prev_mem_setpoint;
+	unsigned int prev_core_fit_rate;
+	unsigned int prev_mem_fit_rate;
+	unsigned int prev_util;			// busy share at 1GHz, 1/1000
+	int prev_overflow;
+	// model at the current OPP
+	unsigned int c2_fit;			// core FIT in C2 and C3
+	unsigned int mem_ret_fit;		// mem FIT in C3
+	unsigned int location_factor;
+	unsigned int avf_core;			// C0 vulnerability factors,
+	unsigned int avf_l1;			// 1/1024, 1024 without PMU
+	const struct cpufreq_re_fit_data *fit_data;
+	unsigned int last_transition_time;	// usec
+};
+
+struct re_policy_stats {
+	u64 active_time;			// usec selected
+	unsigned int epochs;
+	unsigned int overflows;			// closed cycles over budget
+	unsigned int c_hist[4];			// ceilings returned
+	unsigned int p_hist[5];			// floors returned
+};
+
+/*
+ * c_ceiling and p_floor are mandatory and return the values of
+ * cpufreq_re_get_C_states() / cpufreq_re_get_P_states(). enable is
+ * called when the policy gets selected. stats belong to the core.
+ */
+struct re_policy_ops {
+	char name[RE_POLICY_NAME_LEN];
+	struct module *owner;
+	void (*enable)(void);
+	void (*epoch_start)(struct re_policy_ctx *ctx);
+	int (*c_ceiling)(struct re_policy_ctx *ctx);
+	int (*p_floor)(struct re_policy_ctx *ctx);
+	void (*on_transition)(struct re_policy_ctx *ctx,
+			unsigned int old_freq, unsigned int new_freq);
+	void (*on_idle_exit)(struct re_policy_ctx *ctx, int state,
+			int residency);
+
+	struct list_head list;
+	struct re_policy_stats stats;
+};
+
+int cpufreq_re_register_policy(struct re_policy_ops *ops);
+void cpufreq_re_unregister_policy(struct re_policy_ops *ops);
+int cpufreq_re_select_policy(const char *name);
+
+#endif
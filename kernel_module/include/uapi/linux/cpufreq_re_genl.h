@@ -0,0 +1,57 @@
+/*
+ *  include/uapi/linux/cpufreq_re_genl.h
+ *
+ * Generic netlink interface of the cpufreq_re_stats module.
+ * Events are multicast on CPUFREQ_RE_GENL_MCGRP_NAME whenever a
+ * budget control cycle (epoch) closes or the FIT budget of the
+ * running epoch is exceeded.
+ *
+ */
+
+#ifndef _UAPI_LINUX_CPUFREQ_RE_GENL_H
+#define _UAPI_LINUX_CPUFREQ_RE_GENL_H
+
+#define CPUFREQ_RE_GENL_NAME		"cpufreq_re"
+#define CPUFREQ_RE_GENL_VERSION		1
+#define CPUFREQ_RE_GENL_MCGRP_NAME	"events"
+
+enum cpufreq_re_genl_cmd {
+	CPUFREQ_RE_CMD_UNSPEC,
+	CPUFREQ_RE_CMD_EVENT,		/* kernel -> user multicast */
+	__CPUFREQ_RE_CMD_MAX,
+};
+#define CPUFREQ_RE_CMD_MAX (__CPUFREQ_RE_CMD_MAX - 1)
+
+enum cpufreq_re_event_type {
+	CPUFREQ_RE_EVENT_EPOCH_CLOSE,	/* epoch finished, final values */
+	CPUFREQ_RE_EVENT_OVERFLOW,	/* budget exceeded inside the epoch */
+};
+
+/*
+ * FIT and energy values are in the fixed point units of re_stats
+ * (rate * usec). The balance and bank attributes are signed 64 bit
+ * values carried as u64: positive means budget leftover (credit),
+ * negative overflow (debt).
+ */
+enum cpufreq_re_genl_attr {
+	CPUFREQ_RE_A_UNSPEC,
+	CPUFREQ_RE_A_TYPE,		/* u32, enum cpufreq_re_event_type */
+	CPUFREQ_RE_A_CPU,		/* u32 */
+	CPUFREQ_RE_A_EPOCH,		/* u32, epoch sequence number */
+	CPUFREQ_RE_A_TIME,		/* u64, usec */
+	CPUFREQ_RE_A_CORE_FIT,		/* u64, core FIT spent in epoch */
+	CPUFREQ_RE_A_MEM_FIT,		/* u64, mem FIT spent in epoch */
+	CPUFREQ_RE_A_CORE_ENERGY,	/* u64, core energy spent in epoch */
+	CPUFREQ_RE_A_MEM_ENERGY,	/* u64, mem energy spent in epoch */
+	CPUFREQ_RE_A_CORE_BALANCE,	/* s64 as u64 */
+	CPUFREQ_RE_A_MEM_BALANCE,	/* s64 as u64 */
+	CPUFREQ_RE_A_C_STATE,		/* u32, last C-state ceiling */
+	CPUFREQ_RE_A_P_STATE,		/* u32, last P-state floor */
+	CPUFREQ_RE_A_DROPPED,		/* u32, events lost before this one */
+	CPUFREQ_RE_A_CORE_BANK,		/* s64 as u64, banked budget */
+	CPUFREQ_RE_A_MEM_BANK,		/* s64 as u64 */
+	__CPUFREQ_RE_A_MAX,
+};
+#define CPUFREQ_RE_A_MAX (__CPUFREQ_RE_A_MAX - 1)
+
+#endif
@@ -0,0 +1,30 @@
+#!/bin/sh
+# Build and boot JIT-RFTS on QEMU vexpress-a9, from the kernel source root.
+#   ./qemu.sh build
+#   ./qemu.sh run rootfs.ext2 [extra qemu options]
+# The rootfs needs tools/jit-rfts/re_stress.sh and the modules from
+# "make modules_install INSTALL_MOD_PATH=<rootfs>".
+MAKE="make ARCH=arm CROSS_COMPILE=arm-linux-gnueabihf- -j4"
+
+case "$1" in
+build)
+	scripts/kconfig/merge_config.sh -m config_default config_qemu || exit 1
+	$MAKE olddefconfig || exit 1
+	$MAKE zImage modules vexpress-v2p-ca9-re.dtb
+	;;
+run)
+	[ -n "$2" ] || { echo "usage: $0 run rootfs [qemu options]"; exit 1; }
+	ROOTFS=$2
+	shift 2
+	qemu-system-arm -M vexpress-a9 -smp 1 -m 256 \
+		-kernel arch/arm/boot/zImage \
+		-dtb arch/arm/boot/dts/vexpress-v2p-ca9-re.dtb \
+		-drive if=sd,format=raw,file="$ROOTFS" \
+		-append "console=ttyAMA0 root=/dev/mmcblk0 rw rootwait" \
+		-nographic "$@"
+	;;
+*)
+	echo "usage: $0 build | run rootfs [qemu options]"
+	exit 1
+	;;
+esac
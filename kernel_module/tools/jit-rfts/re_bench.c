@@ -0,0 +1,194 @@
+/*
+ *  tools/jit-rfts/re_bench.c
+ *
+ * Host counterpart of drivers/cpufreq/cpufreq_re_bench.c: times the
+ * engine calls that stand in for the kernel hooks (get_C_states,
+ * get_P_states, stats_update, the transition notifier), warm and cold,
+ * with and without threads polling the accumulators the way a sysfs
+ * reader of core_fit_acc does. Output lines match the module:
+ *
+ *   RE_BENCH <function> <warm|cold> <readers>: calls mean p50 p99 max
+ *
+ * usage: re_bench [-n iterations] [-r readers] [-c cold_kb]
+ *
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "re_engine.h"
+
+enum bench_func {
+	BENCH_GET_C,
+	BENCH_GET_P,
+	BENCH_UPDATE,
+	BENCH_TRANS,
+	BENCH_FUNCS,
+};
+
+static const char * const bench_names[BENCH_FUNCS] = {
+	"get_C_states", "get_P_states", "stats_update", "notifier_trans",
+};
+
+static unsigned int iterations = 200000;
+static unsigned int cold_kb = 4096;
+static uint32_t *samples;
+static volatile unsigned char *thrash;
+static volatile int readers_stop;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *bench_reader(void *unused)
+{
+	struct re_engine_stats st;
+
+	while (!readers_stop)
+		re_engine_read(0, &st);
+	return NULL;
+}
+
+static void bench_call(int func)
+{
+	switch (func) {
+	case BENCH_GET_C:
+		re_engine_get_C_states(0);
+		break;
+	case BENCH_GET_P:
+		re_engine_get_P_states(0);
+		break;
+	case BENCH_UPDATE:
+		re_engine_update(0);
+		break;
+	case BENCH_TRANS:
+		re_engine_set_freq(0, re_opp_khz[0]);
+		break;
+	}
+}
+
+static void bench_cold(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < cold_kb * 1024; i += 64)
+		thrash[i]++;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static uint32_t bench_overhead(void)
+{
+	uint32_t best = ~0U;
+	uint64_t t0, ns;
+	int i;
+
+	for (i = 0; i < 1000; i++) {
+		t0 = now_ns();
+		ns = now_ns() - t0;
+		if (ns < best)
+			best = ns;
+	}
+	return best;
+}
+
+static void bench_case(int func, int cold, unsigned int readers,
+			uint32_t overhead)
+{
+	unsigned int calls = cold ? (iterations / 100 ? iterations / 100 : 1)
+			: iterations;
+	uint64_t sum = 0, t0, ns;
+	unsigned int i;
+
+	for (i = 0; i < calls; i++) {
+		if (cold)
+			bench_cold();
+		t0 = now_ns();
+		bench_call(func);
+		ns = now_ns() - t0;
+		samples[i] = ns > overhead ? ns - overhead : 0;
+		sum += samples[i];
+	}
+	qsort(samples, calls, sizeof(*samples), cmp_u32);
+	printf("RE_BENCH %s %s %u: %u %llu %u %u %u\n", bench_names[func],
+		cold ? "cold" : "warm", readers, calls,
+		(unsigned long long)(sum / calls), samples[calls / 2],
+		samples[(uint64_t)calls * 99 / 100], samples[calls - 1]);
+}
+
+int main(int argc, char **argv)
+{
+	struct re_engine_config cfg;
+	unsigned int readers = 1, i, loaded;
+	pthread_t *tids;
+	uint32_t overhead;
+	int opt, func, cold;
+
+	while ((opt = getopt(argc, argv, "n:r:c:")) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			readers = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			cold_kb = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n iterations] [-r readers] "
+					"[-c cold_kb]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (!iterations)
+		return 1;
+	samples = calloc(iterations, sizeof(*samples));
+	thrash = calloc(cold_kb ? cold_kb : 1, 1024);
+	tids = calloc(readers ? readers : 1, sizeof(*tids));
+	if (!samples || !thrash || !tids)
+		return 1;
+
+	re_engine_default_config(&cfg);
+	re_host_tick_us = 1;
+	if (re_engine_init(&cfg)) {
+		fprintf(stderr, "engine init failed\n");
+		return 1;
+	}
+	overhead = bench_overhead();
+	printf("RE_BENCH overhead: %u\n", overhead);
+	for (loaded = 0; loaded <= 1; loaded++) {
+		if (loaded) {
+			if (!readers)
+				break;
+			readers_stop = 0;
+			for (i = 0; i < readers; i++)
+				if (pthread_create(&tids[i], NULL, bench_reader, NULL))
+					return 1;
+		}
+		for (func = 0; func < BENCH_FUNCS; func++)
+			for (cold = 0; cold <= 1; cold++)
+				bench_case(func, cold, loaded ? readers : 0,
+						overhead);
+		if (loaded) {
+			readers_stop = 1;
+			for (i = 0; i < readers; i++)
+				pthread_join(tids[i], NULL);
+		}
+	}
+	re_engine_exit();
+	return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ *  tools/jit-rfts/re_cols.c
+ *
+ * Schema and reader of the re_logcols columnar files.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "re_cols.h"
+
+#define RE_COLS_HEAD { "ts", 8 }, { "name", 2 }
+
+/*
+ * Columns in the order the values are printed by cpufreq_re_stats.c,
+ * ts is the dmesg time stamp in usec (0 without one)
+ */
+const struct re_cols_schema re_cols_schema[RE_COLS_TABLES] = {
+	[RE_COLS_RE_LOG] = { "RE_LOG", 7, {
+		RE_COLS_HEAD, { "index", 1 }, { "mhz", 2 }, { "pow", 8 },
+		{ "core_fit", 8 }, { "mem_fit", 8 } } },
+	[RE_COLS_TR_C] = { "C", 5, {
+		RE_COLS_HEAD, { "entered", 1 }, { "ideal", 1 },
+		{ "residency", 4 } } },
+	[RE_COLS_TR_P] = { "P", 5, {
+		RE_COLS_HEAD, { "floor", 1 }, { "ideal", 1 }, { "time", 4 } } },
+	[RE_COLS_TR_C_STATE] = { "C_STATE TIME", 6, {
+		RE_COLS_HEAD, { "c0", 8 }, { "c1", 8 }, { "c2", 8 },
+		{ "c3", 8 } } },
+	[RE_COLS_TR_CYCLE] = { "CYCLE", 11, {
+		RE_COLS_HEAD, { "core_acc", 8 }, { "core_target", 8 },
+		{ "core_budget", 8 }, { "mem_acc", 8 }, { "mem_target", 8 },
+		{ "mem_budget", 8 }, { "overrun", 8 }, { "time", 4 },
+		{ "pow_acc", 8 } } },
+	[RE_COLS_TR_TRANSITION] = { "TRANSITION", 4, {
+		RE_COLS_HEAD, { "usec", 4 }, { "time", 4 } } },
+};
+
+int re_cols_open(struct re_cols *cols, const char *path)
+{
+	const struct re_cols_header *h;
+	const unsigned char *p, *end;
+	struct stat st;
+	unsigned int t, c;
+	int fd;
+
+	memset(cols, 0, sizeof(*cols));
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return -errno;
+	}
+	if ((size_t)st.st_size < sizeof(*h)) {
+		close(fd);
+		return -EINVAL;
+	}
+	cols->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (cols->map == MAP_FAILED) {
+		cols->map = NULL;
+		return -errno;
+	}
+	cols->size = st.st_size;
+
+	h = cols->map;
+	if (memcmp(h->magic, RE_COLS_MAGIC, 8) || h->version != RE_COLS_VERSION)
+		goto bad;
+	p = (const unsigned char *)(h + 1);
+	end = (const unsigned char *)cols->map + cols->size;
+	cols->nr_names = h->nr_names;
+	cols->names = (const void *)p;
+	p += re_cols_padded((size_t)h->nr_names * RE_COLS_NAME_LEN);
+	for (t = 0; t < RE_COLS_TABLES; t++) {
+		cols->rows[t] = h->rows[t];
+		for (c = 0; c < re_cols_schema[t].nr_cols; c++) {
+			cols->data[t][c] = p;
+			p += re_cols_padded(h->rows[t] * re_cols_schema[t].col[c].width);
+			if (p > end)
+				goto bad;
+		}
+	}
+	return 0;
+bad:
+	re_cols_close(cols);
+	return -EINVAL;
+}
+
+void re_cols_close(struct re_cols *cols)
+{
+	if (cols->map)
+		munmap(cols->map, cols->size);
+	cols->map = NULL;
+}
+
+// index of column in table, -1 if there is none
+int re_cols_find(int table, const char *column)
+{
+	unsigned int c;
+
+	for (c = 0; c < re_cols_schema[table].nr_cols; c++)
+		if (!strcmp(re_cols_schema[table].col[c].name, column))
+			return c;
+	return -1;
+}
+
+uint64_t re_cols_get(const struct re_cols *cols, int table, int column,
+			uint64_t row)
+{
+	const void *base = cols->data[table][column];
+
+	switch (re_cols_schema[table].col[column].width) {
+	case 1:
+		return ((const uint8_t *)base)[row];
+	case 2:
+		return ((const uint16_t *)base)[row];
+	case 4:
+		return ((const uint32_t *)base)[row];
+	default:
+		return ((const uint64_t *)base)[row];
+	}
+}
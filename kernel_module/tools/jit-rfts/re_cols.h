@@ -0,0 +1,74 @@
+/*
+ *  tools/jit-rfts/re_cols.h
+ *
+ * re_cols.h : interface for the columnar files re_logcols writes from
+ * RE_LOG / TR_LOG text. Each line kind is a table with a fixed schema,
+ * every table starts with the dmesg time stamp and the log_name id.
+ * Layout: header, name table, then per table each column as a packed
+ * little endian array of rows, every column padded to 8 bytes.
+ *
+ */
+
+#ifndef _RE_COLS_H
+#define _RE_COLS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RE_COLS_MAGIC "RECOLS\0\1"
+#define RE_COLS_VERSION 1
+#define RE_COLS_NAME_LEN 32		// log_name of cpufreq_re_stats
+#define RE_COLS_MAX_COLS 12
+
+enum re_cols_table {
+	RE_COLS_RE_LOG,			// thread_collect_data()
+	RE_COLS_TR_C,			// clamped idle entry
+	RE_COLS_TR_P,			// governor sample
+	RE_COLS_TR_C_STATE,		// idle residency snapshot
+	RE_COLS_TR_CYCLE,		// closed control cycle
+	RE_COLS_TR_TRANSITION,		// frequency change
+	RE_COLS_TABLES,
+};
+
+struct re_cols_column {
+	const char *name;
+	unsigned int width;		// bytes, 1 2 4 or 8
+};
+
+struct re_cols_schema {
+	const char *tag;		// text after "RE_LOG" / "TR_LOG"
+	unsigned int nr_cols;		// including ts and name
+	struct re_cols_column col[RE_COLS_MAX_COLS];
+};
+
+extern const struct re_cols_schema re_cols_schema[RE_COLS_TABLES];
+
+struct re_cols_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t nr_names;
+	uint64_t rows[RE_COLS_TABLES];
+};
+
+// an opened file, columns point into the mapping
+struct re_cols {
+	void *map;
+	size_t size;
+	uint32_t nr_names;
+	const char (*names)[RE_COLS_NAME_LEN];
+	uint64_t rows[RE_COLS_TABLES];
+	const void *data[RE_COLS_TABLES][RE_COLS_MAX_COLS];
+};
+
+static inline size_t re_cols_padded(size_t bytes)
+{
+	return (bytes + 7) & ~(size_t)7;
+}
+
+int re_cols_open(struct re_cols *cols, const char *path);
+void re_cols_close(struct re_cols *cols);
+int re_cols_find(int table, const char *column);
+uint64_t re_cols_get(const struct re_cols *cols, int table, int column,
+			uint64_t row);
+
+#endif
@@ -0,0 +1,635 @@
+/*
+ *  tools/jit-rfts/re_daemon.c
+ *
+ * JIT-RFTS without the patched kernel. The host engine does the
+ * accounting of cpufreq_re_stats_update() from what any kernel exports
+ * in sysfs:
+ *   cpuN/cpuidle/stateM/time		usec per idle state
+ *   cpuN/cpufreq/stats/time_in_state	residency per frequency
+ * and the decisions are enforced through
+ *   cpuN/cpuidle/stateM/disable	the C-state ceiling
+ *   cpuN/cpufreq/scaling_min_freq	the P-state floor
+ * All files are opened once and read with pread(), every cpu in one
+ * pass per poll. Idle states and frequencies are mapped onto the model
+ * as cpufreq_re_platform.c does. The poll interval halves when a
+ * decision changes and doubles after a few stable polls, between -i
+ * and -I, and never exceeds a quarter of the control cycle.
+ *
+ * Precision against the kernel hooks: the ceiling and floor are taken
+ * once per poll instead of on every idle entry and governor sample,
+ * time_in_state has USER_HZ resolution, and the idle time of a poll is
+ * spread over its frequencies by their share of the interval. State
+ * time read before the state exits is only counted at the next poll.
+ * The original min frequency and state enables are restored on exit.
+ *
+ * usage: re_daemon [options]
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "re_engine.h"
+
+#define D_STATES 10		// CPUIDLE_STATE_MAX
+#define D_FREQS 64
+#define D_BUF 4096
+#define D_STABLE_POLLS 4	// stable polls before the interval doubles
+
+struct d_cpu {
+	unsigned int cpu;		// sysfs number, the engine uses the slot
+	unsigned int nstates;
+	int time_fd[D_STATES];
+	int disable_fd[D_STATES];
+	int class[D_STATES];		// model idle class, -1 = busy (POLL)
+	int disabled[D_STATES];		// as last written or read
+	int orig_disabled[D_STATES];
+	u64 last_time[D_STATES];
+	unsigned int nfreqs;
+	unsigned int khz[D_FREQS];	// ascending
+	int opp[D_FREQS];		// fit_data index
+	u64 last_tis[D_FREQS];		// time_in_state, clock ticks
+	int tis_fd;
+	int cur_fd;
+	int min_fd;
+	unsigned int orig_min;
+	unsigned int cur_min;
+	int last_C_state;
+	int last_P_state;
+	unsigned long long last_us;
+	unsigned int min_errors;	// floor above scaling_max_freq
+};
+
+static struct d_cpu d_cpus[NR_CPUS];
+static unsigned int d_ncpus;
+static const char *d_root = "/sys/devices/system/cpu";
+static unsigned long long d_vclock;	// what the engine sees as now
+static volatile sig_atomic_t d_stop;
+static int d_enforce = 1;
+static int d_verbose;
+
+// overhead of the daemon itself
+static unsigned long long d_polls, d_poll_ns, d_poll_max_ns, d_writes;
+static unsigned long long d_interval_sum;
+
+static unsigned long long d_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static unsigned long long d_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static unsigned long long d_clock(void *unused)
+{
+	return d_vclock;
+}
+
+static void d_signal(int sig)
+{
+	d_stop = 1;
+}
+
+static int d_open(unsigned int cpu, const char *file, int flags)
+{
+	char path[256];
+
+	snprintf(path, sizeof(path), "%s/cpu%u/%s", d_root, cpu, file);
+	return open(path, flags);
+}
+
+// whole file at offset 0 of a kept-open fd, NUL terminated
+static int d_pread(int fd, char *buf, size_t size)
+{
+	ssize_t len = pread(fd, buf, size - 1, 0);
+
+	if (len < 0)
+		return -errno;
+	buf[len] = 0;
+	return len;
+}
+
+static u64 d_parse(const char **p)
+{
+	const char *s = *p;
+	u64 v = 0;
+
+	while (*s == ' ' || *s == '\t' || *s == '\n')
+		s++;
+	while (*s >= '0' && *s <= '9')
+		v = v * 10 + (*s++ - '0');
+	*p = s;
+	return v;
+}
+
+static u64 d_read_u64(int fd)
+{
+	char buf[32];
+	const char *p = buf;
+
+	if (fd < 0 || d_pread(fd, buf, sizeof(buf)) <= 0)
+		return 0;
+	return d_parse(&p);
+}
+
+static int d_write_u64(int fd, u64 v)
+{
+	char buf[32];
+	int len = snprintf(buf, sizeof(buf), "%llu\n", (unsigned long long)v);
+
+	d_writes++;
+	return pwrite(fd, buf, len, 0) == len ? 0 : -errno;
+}
+
+/*
+ * Idle map of cpufreq_re_platform.c: POLL is busy, the other states are
+ * ranked by exit latency and spread over the model classes.
+ */
+static void d_map_idle(struct d_cpu *c, const char names[][32],
+			const unsigned int *latency)
+{
+	int order[D_STATES];
+	int i, j, n = 0, tmp;
+
+	for (i = 0; i < c->nstates; i++) {
+		if (!strcmp(names[i], "POLL")) {
+			c->class[i] = -1;
+			continue;
+		}
+		order[n++] = i;
+	}
+	for (i = 1; i < n; i++)
+		for (j = i; j > 0 && latency[order[j]] < latency[order[j - 1]];
+				j--) {
+			tmp = order[j];
+			order[j] = order[j - 1];
+			order[j - 1] = tmp;
+		}
+	for (i = 0; i < n; i++)
+		c->class[order[i]] = n == 1 ? 0
+			: (i * (RE_CORE_IDLE_STATES - 1) + (n - 1) / 2) / (n - 1);
+}
+
+// frequency map of cpufreq_re_platform.c
+static void d_map_freq(struct d_cpu *c)
+{
+	unsigned int i, j, max = c->khz[c->nfreqs - 1], model, diff, best;
+	int identity = 1;
+
+	for (i = 0; i < c->nfreqs; i++)
+		if (re_core_opp_index(c->khz[i]) < 0)
+			identity = 0;
+	for (i = 0; i < c->nfreqs; i++) {
+		if (identity) {
+			c->opp[i] = re_core_opp_index(c->khz[i]);
+			continue;
+		}
+		model = (u64)c->khz[i] * re_opp_khz[0] / max;
+		best = UINT_MAX;
+		for (j = 0; j < RE_CORE_OPPS; j++) {
+			diff = abs((int)model - (int)re_opp_khz[j]);
+			if (diff < best) {
+				best = diff;
+				c->opp[i] = j;
+			}
+		}
+	}
+}
+
+static int d_cmp_uint(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+// frequencies from time_in_state, or the available list without stats
+static int d_read_freqs(struct d_cpu *c)
+{
+	char buf[D_BUF];
+	const char *p = buf;
+	unsigned int khz;
+	int fd;
+
+	fd = c->tis_fd;
+	if (fd < 0)
+		fd = d_open(c->cpu, "cpufreq/scaling_available_frequencies",
+				O_RDONLY);
+	if (fd < 0 || d_pread(fd, buf, sizeof(buf)) <= 0)
+		return -ENOENT;
+	c->nfreqs = 0;
+	while (*p && c->nfreqs < D_FREQS) {
+		khz = d_parse(&p);
+		if (!khz)
+			break;
+		c->khz[c->nfreqs++] = khz;
+		// skip the residency column
+		if (c->tis_fd >= 0)
+			d_parse(&p);
+	}
+	if (fd != c->tis_fd)
+		close(fd);
+	if (!c->nfreqs)
+		return -ENOENT;
+	qsort(c->khz, c->nfreqs, sizeof(*c->khz), d_cmp_uint);
+	d_map_freq(c);
+	return 0;
+}
+
+static int d_freq_index(const struct d_cpu *c, unsigned int khz)
+{
+	unsigned int i;
+
+	for (i = 0; i < c->nfreqs; i++)
+		if (c->khz[i] == khz)
+			return i;
+	return -1;
+}
+
+static int d_cpu_init(struct d_cpu *c, unsigned int cpu)
+{
+	char names[D_STATES][32], file[64], buf[64];
+	unsigned int latency[D_STATES];
+	int fd, i;
+
+	memset(c, 0, sizeof(*c));
+	c->cpu = cpu;
+	for (i = 0; i < D_STATES; i++) {
+		snprintf(file, sizeof(file), "cpuidle/state%d/time", i);
+		c->time_fd[i] = d_open(cpu, file, O_RDONLY);
+		if (c->time_fd[i] < 0)
+			break;
+		snprintf(file, sizeof(file), "cpuidle/state%d/disable", i);
+		c->disable_fd[i] = d_open(cpu, file, d_enforce ? O_RDWR : O_RDONLY);
+		snprintf(file, sizeof(file), "cpuidle/state%d/name", i);
+		fd = d_open(cpu, file, O_RDONLY);
+		names[i][0] = 0;
+		if (fd >= 0 && d_pread(fd, buf, sizeof(buf)) > 0)
+			sscanf(buf, "%31s", names[i]);
+		if (fd >= 0)
+			close(fd);
+		snprintf(file, sizeof(file), "cpuidle/state%d/latency", i);
+		fd = d_open(cpu, file, O_RDONLY);
+		latency[i] = d_read_u64(fd);
+		if (fd >= 0)
+			close(fd);
+		c->disabled[i] = c->orig_disabled[i] = d_read_u64(c->disable_fd[i]);
+		c->last_time[i] = d_read_u64(c->time_fd[i]);
+	}
+	c->nstates = i;
+	d_map_idle(c, names, latency);
+
+	c->tis_fd = d_open(cpu, "cpufreq/stats/time_in_state", O_RDONLY);
+	c->cur_fd = d_open(cpu, "cpufreq/scaling_cur_freq", O_RDONLY);
+	c->min_fd = d_open(cpu, "cpufreq/scaling_min_freq",
+			d_enforce ? O_RDWR : O_RDONLY);
+	if (c->cur_fd < 0 || c->min_fd < 0 || d_read_freqs(c)) {
+		fprintf(stderr, "cpu%u: no cpufreq table%s\n", cpu, d_enforce
+			? " or scaling_min_freq not writable, see -n" : "");
+		return -ENOENT;
+	}
+	for (i = 0; d_enforce && i < c->nstates; i++)
+		if (c->disable_fd[i] < 0)
+			fprintf(stderr, "cpu%u: state%d/disable not writable\n",
+				cpu, i);
+	c->orig_min = c->cur_min = d_read_u64(c->min_fd);
+	c->last_C_state = RE_CORE_IDLE_STATES - 1;
+	return 0;
+}
+
+static void d_read_tis(struct d_cpu *c, u64 *tis)
+{
+	char buf[D_BUF];
+	const char *p = buf;
+	unsigned int khz;
+	int i;
+
+	memset(tis, 0, c->nfreqs * sizeof(*tis));
+	if (c->tis_fd < 0 || d_pread(c->tis_fd, buf, sizeof(buf)) <= 0)
+		return;
+	while (*p) {
+		khz = d_parse(&p);
+		if (!khz)
+			break;
+		i = d_freq_index(c, khz);
+		if (i >= 0)
+			tis[i] = d_parse(&p);
+		else
+			d_parse(&p);
+	}
+}
+
+/*
+ * Charge what happened on slot since the last poll. Each frequency the
+ * interval spent time at becomes a segment of the engine timeline, the
+ * current one last, and carries its share of every idle class.
+ */
+static void d_account(unsigned int slot, unsigned long long now)
+{
+	struct d_cpu *c = &d_cpus[slot];
+	u64 tis[D_FREQS], seg[D_FREQS], idle[RE_CORE_IDLE_STATES];
+	u64 t, total = 0, interval, len, done = 0;
+	int cur, i, k, order[D_FREQS], n = 0, state;
+
+	memset(idle, 0, sizeof(idle));
+	for (i = 0; i < c->nstates; i++) {
+		t = d_read_u64(c->time_fd[i]);
+		if (c->class[i] >= 0 && t > c->last_time[i])
+			idle[c->class[i]] += t - c->last_time[i];
+		c->last_time[i] = t;
+	}
+	d_read_tis(c, tis);
+	for (i = 0; i < c->nfreqs; i++) {
+		seg[i] = tis[i] > c->last_tis[i] ? tis[i] - c->last_tis[i] : 0;
+		c->last_tis[i] = tis[i];
+		total += seg[i];
+	}
+	cur = d_freq_index(c, d_read_u64(c->cur_fd));
+	if (cur < 0)
+		cur = 0;
+	// below the time_in_state resolution the current frequency had it all
+	if (!total) {
+		seg[cur] = 1;
+		total = 1;
+	}
+	for (i = 0; i < c->nfreqs; i++)
+		if (seg[i] && i != cur)
+			order[n++] = i;
+	if (seg[cur])
+		order[n++] = cur;
+
+	interval = now - c->last_us;
+	d_vclock = c->last_us;
+	for (k = 0; k < n; k++) {
+		i = order[k];
+		len = k == n - 1 ? interval - done : interval * seg[i] / total;
+		re_engine_set_freq(slot, re_opp_khz[c->opp[i]]);
+		for (state = 0; state < RE_CORE_IDLE_STATES; state++)
+			if (idle[state])
+				re_engine_idle(slot, state,
+						idle[state] * len / interval);
+		done += len;
+		d_vclock = c->last_us + done;
+	}
+	c->last_us = now;
+}
+
+// ceiling and floor of slot, written only when they change
+static int d_enforce_cpu(unsigned int slot)
+{
+	struct d_cpu *c = &d_cpus[slot];
+	int ceiling, floor, changed = 0, want, i;
+	unsigned int khz;
+
+	ceiling = re_engine_get_C_states(slot);
+	floor = re_engine_get_P_states(slot);
+	if (ceiling != c->last_C_state || floor != c->last_P_state)
+		changed = 1;
+	c->last_C_state = ceiling;
+	c->last_P_state = floor;
+	if (!d_enforce)
+		return changed;
+
+	for (i = 0; i < c->nstates; i++) {
+		want = c->orig_disabled[i] || c->class[i] > ceiling;
+		if (want != c->disabled[i] && c->disable_fd[i] >= 0 &&
+		    !d_write_u64(c->disable_fd[i], want))
+			c->disabled[i] = want;
+	}
+
+	// slowest frequency at or above the model P-state, as the kernel
+	for (i = 0; i < c->nfreqs; i++)
+		if (RE_CORE_OPPS - 1 - c->opp[i] >= floor)
+			break;
+	khz = c->khz[i < c->nfreqs ? i : c->nfreqs - 1];
+	if (khz < c->orig_min)
+		khz = c->orig_min;
+	if (khz != c->cur_min) {
+		if (d_write_u64(c->min_fd, khz))
+			c->min_errors++;
+		else
+			c->cur_min = khz;
+	}
+	return changed;
+}
+
+static void d_restore(void)
+{
+	struct d_cpu *c;
+	unsigned int slot;
+	int i;
+
+	if (!d_enforce)
+		return;
+	for (slot = 0; slot < d_ncpus; slot++) {
+		c = &d_cpus[slot];
+		for (i = 0; i < c->nstates; i++)
+			if (c->disabled[i] != c->orig_disabled[i])
+				d_write_u64(c->disable_fd[i], c->orig_disabled[i]);
+		if (c->cur_min != c->orig_min)
+			d_write_u64(c->min_fd, c->orig_min);
+	}
+}
+
+static void d_report(void)
+{
+	struct re_engine_stats st;
+	struct rusage ru;
+	unsigned int slot;
+	double cpu_ms;
+
+	for (slot = 0; slot < d_ncpus; slot++) {
+		re_engine_read(slot, &st);
+		printf("RE_DAEMON cpu%u: core_fit_acc %llu mem_fit_acc %llu "
+			"core_pow_acc %llu mem_pow_acc %llu busy %llu "
+			"epochs %u overflows %u C %d P %d min_errors %u\n",
+			d_cpus[slot].cpu,
+			(unsigned long long)st.acc.core_fit_acc,
+			(unsigned long long)st.acc.mem_fit_acc,
+			(unsigned long long)st.acc.core_pow_acc,
+			(unsigned long long)st.acc.mem_pow_acc,
+			(unsigned long long)st.busy_time, st.epoch,
+			st.overflows, st.last_C_state, st.last_P_state,
+			d_cpus[slot].min_errors);
+	}
+	getrusage(RUSAGE_SELF, &ru);
+	cpu_ms = ru.ru_utime.tv_sec * 1e3 + ru.ru_utime.tv_usec / 1e3
+		+ ru.ru_stime.tv_sec * 1e3 + ru.ru_stime.tv_usec / 1e3;
+	printf("RE_DAEMON overhead: polls %llu mean_poll_us %.1f max_poll_us %.1f "
+		"writes %llu mean_interval_ms %.1f cpu_ms %.1f\n", d_polls,
+		d_polls ? d_poll_ns / 1e3 / d_polls : 0.0, d_poll_max_ns / 1e3,
+		d_writes, d_polls ? d_interval_sum / 1e3 / d_polls : 0.0,
+		cpu_ms);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-i min_ms] [-I max_ms] [-d seconds] [-n] [-v]\n"
+		"       [-l location_factor] [-f target_factor] [-c fit_case]\n"
+		"       [-b bank_cap] [-e epoch_usec] [-r sysfs_cpu_dir]\n"
+		"  -n accounts without writing the ceiling and floor\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	struct re_engine_config cfg;
+	unsigned int min_ms = 10, max_ms = 160, interval_us, stable = 0;
+	unsigned int slot, cpu, seconds = 0;
+	unsigned long long start, now, t0, ns;
+	struct timespec next;
+	char path[256];
+	int opt, changed, cur;
+
+	re_engine_default_config(&cfg);
+	while ((opt = getopt(argc, argv, "i:I:d:nvl:f:c:b:e:r:")) != -1) {
+		switch (opt) {
+		case 'i':
+			min_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'I':
+			max_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			d_enforce = 0;
+			break;
+		case 'v':
+			d_verbose = 1;
+			break;
+		case 'l':
+			cfg.location_factor = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			cfg.target_factor = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			cfg.fit_case = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			cfg.bank_cap = strtol(optarg, NULL, 0);
+			break;
+		case 'e':
+			cfg.epoch_len = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			d_root = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (!min_ms || max_ms < min_ms || !cfg.epoch_len) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (max_ms * 4000 > cfg.epoch_len)
+		max_ms = cfg.epoch_len / 4000 > min_ms ? cfg.epoch_len / 4000
+				: min_ms;
+	// the engine has NR_CPUS slots, the first online cpus get them
+	for (cpu = 0; d_ncpus < NR_CPUS; cpu++) {
+		snprintf(path, sizeof(path), "%s/cpu%u", d_root, cpu);
+		if (access(path, F_OK))
+			break;
+		snprintf(path, sizeof(path), "%s/cpu%u/cpuidle", d_root, cpu);
+		if (access(path, F_OK))
+			continue;	// offline
+		if (d_cpu_init(&d_cpus[d_ncpus], cpu))
+			return 1;
+		d_ncpus++;
+	}
+	if (!d_ncpus) {
+		fprintf(stderr, "no cpu with cpuidle and cpufreq under %s\n",
+			d_root);
+		return 1;
+	}
+
+	re_host_tick_us = 1;
+	re_host_set_clock(d_clock, NULL);
+	start = d_now_us();
+	d_vclock = start;
+	cfg.nr_cpus = d_ncpus;
+	cur = d_freq_index(&d_cpus[0], d_read_u64(d_cpus[0].cur_fd));
+	cfg.boot_khz = re_opp_khz[d_cpus[0].opp[cur < 0 ? 0 : cur]];
+	if (re_engine_init(&cfg)) {
+		fprintf(stderr, "engine init failed\n");
+		return 1;
+	}
+	for (slot = 0; slot < d_ncpus; slot++) {
+		d_cpus[slot].last_us = start;
+		d_read_tis(&d_cpus[slot], d_cpus[slot].last_tis);
+	}
+
+	signal(SIGINT, d_signal);
+	signal(SIGTERM, d_signal);
+	interval_us = min_ms * 1000;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!d_stop) {
+		next.tv_nsec += interval_us * 1000L;
+		while (next.tv_nsec >= 1000000000L) {
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL)
+				&& d_stop)
+			break;
+
+		t0 = d_now_ns();
+		now = t0 / 1000;
+		changed = 0;
+		for (slot = 0; slot < d_ncpus; slot++) {
+			d_account(slot, now);
+			d_vclock = now;
+			if (d_enforce_cpu(slot)) {
+				changed = 1;
+				if (d_verbose)
+					printf("RE_DAEMON cpu%u %llu: C %d P %d\n",
+						d_cpus[slot].cpu, now - start,
+						d_cpus[slot].last_C_state,
+						d_cpus[slot].last_P_state);
+			}
+		}
+		ns = d_now_ns() - t0;
+		d_polls++;
+		d_poll_ns += ns;
+		if (ns > d_poll_max_ns)
+			d_poll_max_ns = ns;
+		d_interval_sum += interval_us;
+
+		// react fast while decisions move, back off while they hold
+		if (changed) {
+			stable = 0;
+			interval_us = max_t(unsigned int, interval_us / 2,
+					min_ms * 1000);
+		} else if (++stable >= D_STABLE_POLLS) {
+			stable = 0;
+			interval_us = min_t(unsigned int, interval_us * 2,
+					max_ms * 1000);
+		}
+		if (seconds && now - start >= seconds * 1000000ULL)
+			break;
+	}
+
+	d_restore();
+	d_report();
+	re_engine_exit();
+	return 0;
+}
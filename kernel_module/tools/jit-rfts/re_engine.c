@@ -0,0 +1,266 @@
+/*
+ *  tools/jit-rfts/re_engine.c
+ *
+ * Userspace glue around cpufreq_re_core, following the flow of
+ * cpufreq_re_stats: the accounting of an interval is charged on every
+ * query, a control cycle closes once its stop time has passed and the
+ * threshold rule turns the remaining allowance into the C-state ceiling
+ * and P-state floor. The budget and its cycles are the re_core_budget
+ * code cpufreq_re_stats runs. PMU sampling, cgroups, the energy and
+ * wear caps and the other policies stay in the kernel.
+ *
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "re_engine.h"
+
+struct re_engine_cpu {
+	unsigned int cpu;
+	unsigned int khz;
+	struct cpufreq_re_fit_data fit_data;
+	struct re_core_rates rates;
+	struct re_core_acc acc;
+	struct re_core_budget budget;		// targets, factors, running cycle
+	unsigned long long last_time;		// in usec
+	u64 idle_time[RE_CORE_IDLE_STATES];	// cpuidle residency counters
+	u64 last_idle_time[RE_CORE_IDLE_STATES];
+	u64 busy_time;
+	unsigned int epoch;
+	unsigned int overflows;
+	int last_C_state;
+	int last_P_state;
+};
+
+// cpufreq_re_fit.c is also built once per hardware case, see the Makefile
+void import_fit_data_case1(struct cpufreq_re_fit_data *fit_data, unsigned int cpu);
+void import_fit_data_case2(struct cpufreq_re_fit_data *fit_data, unsigned int cpu);
+void import_fit_data_case3(struct cpufreq_re_fit_data *fit_data, unsigned int cpu);
+void import_fit_data_case4(struct cpufreq_re_fit_data *fit_data, unsigned int cpu);
+
+static void (* const re_engine_fit_case[])(struct cpufreq_re_fit_data *,
+			unsigned int) = {
+	import_fit_data, import_fit_data_case1, import_fit_data_case2,
+	import_fit_data_case3, import_fit_data_case4,
+};
+
+static struct re_engine_config re_engine_cfg;
+static spinlock_t re_engine_lock;
+static DEFINE_PER_CPU(struct re_engine_cpu *, re_engine_table);
+
+void re_engine_default_config(struct re_engine_config *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->nr_cpus = 1;
+	cfg->boot_khz = 1000*1000;
+	cfg->location_factor = 100;
+	cfg->target_factor = 50;
+	cfg->epoch_len = 1000000/3;
+}
+
+static unsigned long long re_engine_now(void)
+{
+	return jiffies_to_usecs(get_jiffies_64());
+}
+
+// close the cycle once its stop time passed, with re_engine_lock held
+static void re_engine_epoch_check(struct re_engine_cpu *c,
+			unsigned long long now)
+{
+	if (now < c->budget.stop_time)
+		return;
+	if (re_core_budget_overflow(&c->budget, &c->acc))
+		c->overflows++;
+	re_core_budget_close(&c->budget, &c->acc, re_engine_cfg.epoch_len,
+			re_engine_cfg.bank_cap);
+	re_core_budget_open(&c->budget, &c->acc, re_engine_cfg.epoch_len, now);
+	c->epoch++;
+}
+
+int re_engine_init(const struct re_engine_config *cfg)
+{
+	struct re_engine_cpu *c;
+	unsigned int cpu;
+	int index;
+
+	if (!cfg->nr_cpus || cfg->nr_cpus > NR_CPUS || !cfg->epoch_len ||
+	    cfg->fit_case >= ARRAY_SIZE(re_engine_fit_case))
+		return -EINVAL;
+	index = re_core_opp_index(cfg->boot_khz);
+	if (index < 0)
+		return -EINVAL;
+	re_engine_cfg = *cfg;
+	re_host_nr_cpus = cfg->nr_cpus;
+	spin_lock_init(&re_engine_lock);
+
+	for_each_online_cpu(cpu) {
+		c = calloc(1, sizeof(*c));
+		if (!c) {
+			re_engine_exit();
+			return -ENOMEM;
+		}
+		c->cpu = cpu;
+		c->khz = cfg->boot_khz;
+		re_engine_fit_case[cfg->fit_case](&c->fit_data, cpu);
+		re_core_rates(&c->fit_data, index, cfg->location_factor,
+				&c->rates);
+		re_core_budget_init(&c->budget, &c->fit_data, cfg->target_factor);
+		c->last_time = re_engine_now();
+		re_core_budget_open(&c->budget, &c->acc, cfg->epoch_len,
+				c->last_time);
+		c->last_C_state = 3;
+		per_cpu(re_engine_table, cpu) = c;
+	}
+	return 0;
+}
+
+void re_engine_exit(void)
+{
+	unsigned int cpu;
+
+	for_each_online_cpu(cpu) {
+		free(per_cpu(re_engine_table, cpu));
+		per_cpu(re_engine_table, cpu) = NULL;
+	}
+}
+
+/*
+ * usec spent in cpuidle state (0 = WFI .. 3), what the kernel reads
+ * from dev->states_usage[state].time
+ */
+void re_engine_idle(unsigned int cpu, int state, unsigned int usec)
+{
+	struct re_engine_cpu *c = per_cpu(re_engine_table, cpu);
+
+	if (!c || state < 0 || state >= RE_CORE_IDLE_STATES)
+		return;
+	spin_lock(&re_engine_lock);
+	c->idle_time[state] += usec;
+	spin_unlock(&re_engine_lock);
+}
+
+// charge the interval since the last update, called with the lock held
+static void re_engine_account(struct re_engine_cpu *c,
+			unsigned long long now)
+{
+	int idle_time_diff[RE_CORE_IDLE_STATES];
+	int time_diff, busy_diff, i;
+
+	time_diff = (int)(now - c->last_time);
+	idle_time_diff[0] = time_diff;
+	for (i = 1; i < RE_CORE_IDLE_STATES; i++) {
+		idle_time_diff[i] = (int)(c->idle_time[i] - c->last_idle_time[i]);
+		idle_time_diff[0] -= idle_time_diff[i];
+	}
+	if (idle_time_diff[0] < 0)
+		idle_time_diff[0] = 0;
+	// C0 in the model includes the WFI state, busy time does not
+	busy_diff = idle_time_diff[0] - (int)(c->idle_time[0] - c->last_idle_time[0]);
+	if (busy_diff > 0)
+		c->busy_time += busy_diff;
+
+	re_core_account(&c->acc, &c->rates, idle_time_diff,
+			c->rates.cur_core_fit, c->rates.cur_mem_fit);
+	memcpy(c->last_idle_time, c->idle_time, sizeof(c->idle_time));
+	c->last_time = now;
+}
+
+int re_engine_update(unsigned int cpu)
+{
+	struct re_engine_cpu *c = per_cpu(re_engine_table, cpu);
+
+	if (!c)
+		return -ENODEV;
+	spin_lock(&re_engine_lock);
+	re_engine_account(c, re_engine_now());
+	spin_unlock(&re_engine_lock);
+	return 0;
+}
+
+/*
+ * Frequency change, like the POSTCHANGE notifier: the time so far is
+ * charged at the old OPP
+ */
+int re_engine_set_freq(unsigned int cpu, unsigned int khz)
+{
+	struct re_engine_cpu *c = per_cpu(re_engine_table, cpu);
+	int index = re_core_opp_index(khz);
+
+	if (!c)
+		return -ENODEV;
+	if (index < 0)
+		return -EINVAL;
+	spin_lock(&re_engine_lock);
+	re_engine_account(c, re_engine_now());
+	c->khz = khz;
+	re_core_rates(&c->fit_data, index, re_engine_cfg.location_factor,
+			&c->rates);
+	spin_unlock(&re_engine_lock);
+	return 0;
+}
+
+int re_engine_get_C_states(unsigned int cpu)
+{
+	struct re_engine_cpu *c = per_cpu(re_engine_table, cpu);
+	unsigned long long now = re_engine_now();
+	unsigned int core_rate, mem_rate;
+
+	if (!c)
+		return 3;
+	spin_lock(&re_engine_lock);
+	re_engine_account(c, now);
+	re_engine_epoch_check(c, now);
+	re_core_budget_rates(&c->budget, &c->acc, now, &core_rate, &mem_rate);
+	c->last_C_state = re_core_c_ceiling(core_rate, mem_rate,
+			c->rates.cpuidle_c2_fit, c->rates.cpuidle_mem_ret_fit);
+	spin_unlock(&re_engine_lock);
+	return c->last_C_state;
+}
+
+int re_engine_get_P_states(unsigned int cpu)
+{
+	struct re_engine_cpu *c = per_cpu(re_engine_table, cpu);
+	unsigned long long now = re_engine_now();
+	unsigned int core_rate, mem_rate;
+
+	if (!c)
+		return 0;
+	spin_lock(&re_engine_lock);
+	re_engine_account(c, now);
+	re_engine_epoch_check(c, now);
+	re_core_budget_rates(&c->budget, &c->acc, now, &core_rate, &mem_rate);
+	// no PMU on the host, the factors stay as re_core_budget_init() set them
+	c->last_P_state = re_core_budget_floor(&c->budget, &c->fit_data,
+			re_engine_cfg.location_factor, core_rate, mem_rate);
+	spin_unlock(&re_engine_lock);
+	return c->last_P_state;
+}
+
+int re_engine_read(unsigned int cpu, struct re_engine_stats *out)
+{
+	struct re_engine_cpu *c = per_cpu(re_engine_table, cpu);
+	unsigned long long now = re_engine_now();
+
+	if (!c)
+		return -ENODEV;
+	spin_lock(&re_engine_lock);
+	out->khz = c->khz;
+	out->rates = c->rates;
+	out->acc = c->acc;
+	out->busy_time = c->busy_time;
+	memcpy(out->idle_time, c->idle_time, sizeof(c->idle_time));
+	out->core_fit_target = c->budget.core_fit_target;
+	out->mem_fit_target = c->budget.mem_fit_target;
+	re_core_budget_rates(&c->budget, &c->acc, now, &out->core_fit_rate,
+			&out->mem_fit_rate);
+	out->core_fit_bank = c->budget.core_fit_bank;
+	out->mem_fit_bank = c->budget.mem_fit_bank;
+	out->epoch = c->epoch;
+	out->overflows = c->overflows;
+	out->last_C_state = c->last_C_state;
+	out->last_P_state = c->last_P_state;
+	spin_unlock(&re_engine_lock);
+	return 0;
+}
@@ -0,0 +1,58 @@
+/*
+ *  tools/jit-rfts/re_engine.h
+ *
+ * re_engine.h : interface for the userspace build of the reliability
+ * engine. It keeps the per cpu state cpufreq_re_stats keeps (accounting,
+ * control cycles, budget bank) around cpufreq_re_core and takes the
+ * decisions of the threshold policy. The caller plays cpuidle and
+ * cpufreq: it reports idle residency and frequency changes and asks for
+ * the C-state ceiling and P-state floor, in the time of re_host.h.
+ *
+ */
+
+#ifndef _RE_ENGINE_H
+#define _RE_ENGINE_H
+
+#include "re_host.h"
+#include "cpufreq_re_core.h"
+
+struct re_engine_config {
+	unsigned int nr_cpus;
+	unsigned int boot_khz;		// frequency at start, one of re_opp_khz
+	unsigned int location_factor;	// %, 100 = model as is
+	unsigned int target_factor;	// targets in 1/10 of the deepest idle rates
+	unsigned int epoch_len;		// control cycle, usec
+	int bank_cap;			// cycles of budget the bank may hold
+	unsigned int fit_case;		// CASE1..4 of cpufreq_re_fit.c, 0 = as built
+};
+
+struct re_engine_stats {
+	unsigned int khz;
+	struct re_core_rates rates;
+	struct re_core_acc acc;
+	u64 busy_time;			// usec not spent in any idle state
+	u64 idle_time[RE_CORE_IDLE_STATES];
+	unsigned int core_fit_target;
+	unsigned int mem_fit_target;
+	unsigned int core_fit_rate;	// remaining allowance of the cycle
+	unsigned int mem_fit_rate;
+	s64 core_fit_bank;
+	s64 mem_fit_bank;
+	unsigned int epoch;
+	unsigned int overflows;		// closed cycles over budget
+	int last_C_state;
+	int last_P_state;
+};
+
+void re_engine_default_config(struct re_engine_config *cfg);
+int re_engine_init(const struct re_engine_config *cfg);
+void re_engine_exit(void);
+
+void re_engine_idle(unsigned int cpu, int state, unsigned int usec);
+int re_engine_set_freq(unsigned int cpu, unsigned int khz);
+int re_engine_update(unsigned int cpu);
+int re_engine_get_C_states(unsigned int cpu);
+int re_engine_get_P_states(unsigned int cpu);
+int re_engine_read(unsigned int cpu, struct re_engine_stats *out);
+
+#endif
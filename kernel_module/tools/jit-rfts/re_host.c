@@ -0,0 +1,38 @@
+/*
+ *  tools/jit-rfts/re_host.c
+ *
+ * Clock and cpu count behind re_host.h.
+ *
+ */
+
+#include <time.h>
+
+#include "re_host.h"
+
+unsigned int re_host_nr_cpus = 1;
+unsigned int re_host_tick_us = 10000;
+
+static re_host_clock_fn re_host_clock;
+static void *re_host_clock_data;
+
+static unsigned long long re_host_monotonic_us(void *unused)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// NULL restores CLOCK_MONOTONIC
+void re_host_set_clock(re_host_clock_fn fn, void *data)
+{
+	re_host_clock = fn;
+	re_host_clock_data = data;
+}
+
+unsigned long long re_host_clock_us(void)
+{
+	if (re_host_clock)
+		return re_host_clock(re_host_clock_data);
+	return re_host_monotonic_us(NULL);
+}
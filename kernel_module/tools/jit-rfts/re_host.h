@@ -0,0 +1,85 @@
+/*
+ *  tools/jit-rfts/re_host.h
+ *
+ * re_host.h : interface for the userspace stand-ins of the kernel
+ * facilities the reliability engine uses: fixed width types, 64 bit
+ * division helpers, per cpu variables, spinlocks and the jiffies time
+ * base. The clock defaults to CLOCK_MONOTONIC and can be replaced, so
+ * simulators and trace replay drive the engine in their own time.
+ *
+ */
+
+#ifndef _RE_HOST_H
+#define _RE_HOST_H
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef uint8_t u8;
+typedef uint32_t u32;
+typedef int32_t s32;
+typedef uint64_t u64;
+typedef int64_t s64;
+
+static inline u64 div64_u64(u64 dividend, u64 divisor)
+{
+	return dividend / divisor;
+}
+
+static inline u64 div_u64(u64 dividend, u32 divisor)
+{
+	return dividend / divisor;
+}
+
+static inline s64 div_s64(s64 dividend, s32 divisor)
+{
+	return dividend / divisor;
+}
+
+#define min_t(type, x, y) ({ type __x = (x); type __y = (y); __x < __y ? __x : __y; })
+#define max_t(type, x, y) ({ type __x = (x); type __y = (y); __x > __y ? __x : __y; })
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+#define printk(fmt, ...)	fprintf(stderr, fmt, ##__VA_ARGS__)
+#define pr_info(fmt, ...)	printf(fmt, ##__VA_ARGS__)
+
+// per cpu variables are plain arrays indexed by cpu
+#define NR_CPUS 8
+#define DEFINE_PER_CPU(type, name)	__typeof__(type) name[NR_CPUS]
+#define per_cpu(name, cpu)		((name)[cpu])
+
+extern unsigned int re_host_nr_cpus;
+#define for_each_online_cpu(cpu) \
+	for ((cpu) = 0; (cpu) < re_host_nr_cpus; (cpu)++)
+
+typedef pthread_mutex_t spinlock_t;
+#define spin_lock_init(lock)	pthread_mutex_init(lock, NULL)
+#define spin_lock(lock)		pthread_mutex_lock(lock)
+#define spin_unlock(lock)	pthread_mutex_unlock(lock)
+
+/*
+ * Time base. get_jiffies_64() advances every re_host_tick_us usec of
+ * the clock (10000 by default, HZ=100 as on the board); a tick of 1
+ * gives the engine exact usec.
+ */
+typedef unsigned long long (*re_host_clock_fn)(void *data);
+
+extern unsigned int re_host_tick_us;
+
+void re_host_set_clock(re_host_clock_fn fn, void *data);
+unsigned long long re_host_clock_us(void);
+
+static inline u64 get_jiffies_64(void)
+{
+	return re_host_clock_us() / re_host_tick_us;
+}
+
+// 64 bit unlike the kernel, so hours of simulated time do not wrap
+static inline u64 jiffies_to_usecs(u64 j)
+{
+	return j * re_host_tick_us;
+}
+
+#endif
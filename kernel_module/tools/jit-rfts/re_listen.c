@@ -0,0 +1,225 @@
+/*
+ *  tools/jit-rfts/re_listen.c
+ *
+ * Minimal listener for the cpufreq_re generic netlink events.
+ * Resolves the family, joins the "events" multicast group and prints
+ * one line per event. Uses plain sockets so it needs no libnl.
+ *
+ * usage: re_listen [-n count]
+ *
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+
+#include <linux/cpufreq_re_genl.h>
+
+#define BUF_SIZE 8192
+
+#define GENLMSG_DATA(nh)	((void *)((char *)NLMSG_DATA(nh) + GENL_HDRLEN))
+#define NLA_DATA(na)		((void *)((char *)(na) + NLA_HDRLEN))
+
+static int genl_send_getfamily(int fd, const char *name)
+{
+	struct {
+		struct nlmsghdr n;
+		struct genlmsghdr g;
+		char buf[64];
+	} req;
+	struct nlattr *na;
+	struct sockaddr_nl addr;
+
+	memset(&req, 0, sizeof(req));
+	req.n.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+	req.n.nlmsg_type = GENL_ID_CTRL;
+	req.n.nlmsg_flags = NLM_F_REQUEST;
+	req.n.nlmsg_seq = 1;
+	req.n.nlmsg_pid = getpid();
+	req.g.cmd = CTRL_CMD_GETFAMILY;
+	req.g.version = 1;
+
+	na = (struct nlattr *)((char *)&req + NLMSG_ALIGN(req.n.nlmsg_len));
+	na->nla_type = CTRL_ATTR_FAMILY_NAME;
+	na->nla_len = NLA_HDRLEN + strlen(name) + 1;
+	strcpy(NLA_DATA(na), name);
+	req.n.nlmsg_len += NLA_ALIGN(na->nla_len);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	if (sendto(fd, &req, req.n.nlmsg_len, 0,
+		   (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		return -errno;
+	return 0;
+}
+
+/*
+ * Find the id of the multicast group called grp_name inside the
+ * CTRL_ATTR_MCAST_GROUPS nest of a CTRL_CMD_NEWFAMILY reply.
+ */
+static int genl_parse_mcgrp(struct nlattr *nest, const char *grp_name)
+{
+	struct nlattr *grp, *na;
+	int rem, grem, id;
+	const char *name;
+
+	rem = nest->nla_len - NLA_HDRLEN;
+	for (grp = NLA_DATA(nest); rem >= (int)NLA_HDRLEN;
+	     rem -= NLA_ALIGN(grp->nla_len),
+	     grp = (struct nlattr *)((char *)grp + NLA_ALIGN(grp->nla_len))) {
+		id = -1;
+		name = NULL;
+		grem = grp->nla_len - NLA_HDRLEN;
+		for (na = NLA_DATA(grp); grem >= (int)NLA_HDRLEN;
+		     grem -= NLA_ALIGN(na->nla_len),
+		     na = (struct nlattr *)((char *)na + NLA_ALIGN(na->nla_len))) {
+			if (na->nla_type == CTRL_ATTR_MCAST_GRP_ID)
+				id = *(uint32_t *)NLA_DATA(na);
+			else if (na->nla_type == CTRL_ATTR_MCAST_GRP_NAME)
+				name = NLA_DATA(na);
+		}
+		if (name && id >= 0 && !strcmp(name, grp_name))
+			return id;
+	}
+	return -ENOENT;
+}
+
+static int genl_resolve_mcgrp(int fd, const char *family, const char *grp)
+{
+	char buf[BUF_SIZE];
+	struct nlmsghdr *nh;
+	struct nlattr *na;
+	int len, rem;
+
+	if (genl_send_getfamily(fd, family) < 0)
+		return -errno;
+	len = recv(fd, buf, sizeof(buf), 0);
+	if (len < 0)
+		return -errno;
+
+	for (nh = (struct nlmsghdr *)buf; NLMSG_OK(nh, len);
+	     nh = NLMSG_NEXT(nh, len)) {
+		if (nh->nlmsg_type == NLMSG_ERROR)
+			return ((struct nlmsgerr *)NLMSG_DATA(nh))->error;
+		rem = nh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+		for (na = GENLMSG_DATA(nh); rem >= (int)NLA_HDRLEN;
+		     rem -= NLA_ALIGN(na->nla_len),
+		     na = (struct nlattr *)((char *)na + NLA_ALIGN(na->nla_len))) {
+			if ((na->nla_type & NLA_TYPE_MASK) ==
+			    CTRL_ATTR_MCAST_GROUPS)
+				return genl_parse_mcgrp(na, grp);
+		}
+	}
+	return -ENOENT;
+}
+
+static void print_event(struct nlmsghdr *nh)
+{
+	uint64_t val[CPUFREQ_RE_A_MAX + 1];
+	struct nlattr *na;
+	int rem, type;
+
+	memset(val, 0, sizeof(val));
+	rem = nh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+	for (na = GENLMSG_DATA(nh); rem >= (int)NLA_HDRLEN;
+	     rem -= NLA_ALIGN(na->nla_len),
+	     na = (struct nlattr *)((char *)na + NLA_ALIGN(na->nla_len))) {
+		type = na->nla_type & NLA_TYPE_MASK;
+		if (type > CPUFREQ_RE_A_MAX)
+			continue;
+		if (na->nla_len - NLA_HDRLEN == sizeof(uint64_t))
+			memcpy(&val[type], NLA_DATA(na), sizeof(uint64_t));
+		else
+			val[type] = *(uint32_t *)NLA_DATA(na);
+	}
+
+	printf("%s cpu %llu epoch %llu time %llu core_fit %llu mem_fit %llu "
+	       "core_energy %llu mem_energy %llu core_balance %lld "
+	       "mem_balance %lld core_bank %lld mem_bank %lld "
+	       "C %llu P %llu dropped %llu\n",
+	       val[CPUFREQ_RE_A_TYPE] == CPUFREQ_RE_EVENT_OVERFLOW ?
+			"OVERFLOW" : "EPOCH",
+	       (unsigned long long)val[CPUFREQ_RE_A_CPU],
+	       (unsigned long long)val[CPUFREQ_RE_A_EPOCH],
+	       (unsigned long long)val[CPUFREQ_RE_A_TIME],
+	       (unsigned long long)val[CPUFREQ_RE_A_CORE_FIT],
+	       (unsigned long long)val[CPUFREQ_RE_A_MEM_FIT],
+	       (unsigned long long)val[CPUFREQ_RE_A_CORE_ENERGY],
+	       (unsigned long long)val[CPUFREQ_RE_A_MEM_ENERGY],
+	       (long long)val[CPUFREQ_RE_A_CORE_BALANCE],
+	       (long long)val[CPUFREQ_RE_A_MEM_BALANCE],
+	       (long long)val[CPUFREQ_RE_A_CORE_BANK],
+	       (long long)val[CPUFREQ_RE_A_MEM_BANK],
+	       (unsigned long long)val[CPUFREQ_RE_A_C_STATE],
+	       (unsigned long long)val[CPUFREQ_RE_A_P_STATE],
+	       (unsigned long long)val[CPUFREQ_RE_A_DROPPED]);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_nl addr;
+	char buf[BUF_SIZE];
+	struct nlmsghdr *nh;
+	long count = -1;
+	int fd, grp, len;
+
+	if (argc == 3 && !strcmp(argv[1], "-n")) {
+		count = strtol(argv[2], NULL, 0);
+	} else if (argc != 1) {
+		fprintf(stderr, "usage: %s [-n count]\n", argv[0]);
+		return 1;
+	}
+
+	fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_GENERIC);
+	if (fd < 0) {
+		perror("socket");
+		return 1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror("bind");
+		return 1;
+	}
+
+	grp = genl_resolve_mcgrp(fd, CPUFREQ_RE_GENL_NAME,
+				 CPUFREQ_RE_GENL_MCGRP_NAME);
+	if (grp < 0) {
+		fprintf(stderr, "cannot resolve %s/%s: %s\n",
+			CPUFREQ_RE_GENL_NAME, CPUFREQ_RE_GENL_MCGRP_NAME,
+			strerror(-grp));
+		return 1;
+	}
+	if (setsockopt(fd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP,
+		       &grp, sizeof(grp)) < 0) {
+		perror("NETLINK_ADD_MEMBERSHIP");
+		return 1;
+	}
+
+	while (count != 0) {
+		len = recv(fd, buf, sizeof(buf), 0);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("recv");
+			return 1;
+		}
+		for (nh = (struct nlmsghdr *)buf; NLMSG_OK(nh, len);
+		     nh = NLMSG_NEXT(nh, len)) {
+			if (nh->nlmsg_type < NLMSG_MIN_TYPE)
+				continue;
+			print_event(nh);
+			if (count > 0 && --count == 0)
+				break;
+		}
+	}
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,529 @@
+/*
+ *  tools/jit-rfts/re_logcols.c
+ *
+ * Converts RE_LOG / TR_LOG text (dmesg captures, with or without time
+ * stamps, any other lines mixed in) into the columnar format of
+ * re_cols.h. Inputs are memory mapped and cut into chunks at line
+ * boundaries that worker threads parse independently, the chunks are
+ * concatenated in order when the file is written. Tags are located with
+ * SSE2 16 bytes at a time where available, lines with memchr.
+ *
+ * usage: re_logcols [-j threads] -o out.rec log...
+ *        re_logcols -s file.rec              summary
+ *        re_logcols -p table file.rec        table as CSV
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "re_cols.h"
+
+#define CHUNKS_PER_THREAD 8
+#define MIN_CHUNK (1 << 20)
+#define MAX_NAMES 256
+
+struct colbuf {
+	unsigned char *col[RE_COLS_MAX_COLS];
+	size_t rows, cap;
+};
+
+struct chunk {
+	const char *begin, *end;
+	struct colbuf tab[RE_COLS_TABLES];
+	char names[MAX_NAMES][RE_COLS_NAME_LEN];
+	unsigned int nr_names;
+	unsigned int last_name;
+	int err;
+};
+
+static struct chunk *chunks;
+static unsigned int nr_chunks;
+static unsigned int next_chunk;
+
+static int colbuf_append(struct colbuf *b, int table, const uint64_t *vals)
+{
+	const struct re_cols_schema *s = &re_cols_schema[table];
+	unsigned int c, w;
+	unsigned char *p;
+
+	if (b->rows == b->cap) {
+		size_t cap = b->cap ? b->cap * 2 : 4096;
+
+		for (c = 0; c < s->nr_cols; c++) {
+			p = realloc(b->col[c], cap * s->col[c].width);
+			if (!p)
+				return -ENOMEM;
+			b->col[c] = p;
+		}
+		b->cap = cap;
+	}
+	// little endian hosts only, the low bytes of each value
+	for (c = 0; c < s->nr_cols; c++) {
+		w = s->col[c].width;
+		memcpy(b->col[c] + b->rows * w, &vals[c], w);
+	}
+	b->rows++;
+	return 0;
+}
+
+static int chunk_name(struct chunk *ck, const char *name, size_t len)
+{
+	unsigned int i;
+
+	if (len >= RE_COLS_NAME_LEN)
+		len = RE_COLS_NAME_LEN - 1;
+	if (ck->nr_names && !strncmp(ck->names[ck->last_name], name, len) &&
+	    !ck->names[ck->last_name][len])
+		return ck->last_name;
+	for (i = 0; i < ck->nr_names; i++)
+		if (!strncmp(ck->names[i], name, len) && !ck->names[i][len])
+			return ck->last_name = i;
+	if (ck->nr_names == MAX_NAMES)
+		return -1;
+	memset(ck->names[i], 0, RE_COLS_NAME_LEN);
+	memcpy(ck->names[i], name, len);
+	ck->nr_names++;
+	return ck->last_name = i;
+}
+
+/*
+ * Next "_LOG " from p, NULL if none before end
+ */
+static const char *find_tag(const char *p, const char *end)
+{
+#ifdef __SSE2__
+	const __m128i us = _mm_set1_epi8('_');
+	const __m128i ll = _mm_set1_epi8('L');
+	unsigned int mask;
+	int bit;
+
+	while (p + 17 <= end) {
+		__m128i a = _mm_loadu_si128((const __m128i *)p);
+		__m128i b = _mm_loadu_si128((const __m128i *)(p + 1));
+
+		mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, us),
+				_mm_cmpeq_epi8(b, ll)));
+		while (mask) {
+			bit = __builtin_ctz(mask);
+			if (p + bit + 5 <= end && !memcmp(p + bit, "_LOG ", 5))
+				return p + bit;
+			mask &= mask - 1;
+		}
+		p += 16;
+	}
+#endif
+	for (; p + 5 <= end; p++)
+		if (*p == '_' && !memcmp(p, "_LOG ", 5))
+			return p;
+	return NULL;
+}
+
+// dmesg "<6>[  123.456789] " prefix in usec, 0 without one
+static uint64_t parse_stamp(const char *p, const char *end)
+{
+	uint64_t sec = 0, frac = 0;
+	int digits = 0;
+
+	if (p < end && *p == '<') {
+		while (p < end && *p != '>')
+			p++;
+		p++;
+	}
+	if (p >= end || *p != '[')
+		return 0;
+	p++;
+	while (p < end && *p == ' ')
+		p++;
+	while (p < end && *p >= '0' && *p <= '9')
+		sec = sec * 10 + (*p++ - '0');
+	if (p < end && *p == '.')
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+			if (digits < 6) {
+				frac = frac * 10 + (*p - '0');
+				digits++;
+			}
+	while (digits++ < 6)
+		frac *= 10;
+	return sec * 1000000 + frac;
+}
+
+// up to max decimal numbers, negative ones as two's complement
+static int parse_numbers(const char *p, const char *end, uint64_t *vals,
+			int max)
+{
+	int n = 0, neg;
+	uint64_t v;
+
+	while (n < max) {
+		while (p < end && *p == ' ')
+			p++;
+		if (p >= end)
+			break;
+		neg = *p == '-';
+		if (neg)
+			p++;
+		if (p >= end || *p < '0' || *p > '9')
+			break;
+		for (v = 0; p < end && *p >= '0' && *p <= '9'; p++)
+			v = v * 10 + (*p - '0');
+		vals[n++] = neg ? (uint64_t)-(int64_t)v : v;
+	}
+	return n;
+}
+
+static int match(const char **p, const char *end, const char *s)
+{
+	size_t len = strlen(s);
+
+	if ((size_t)(end - *p) < len || memcmp(*p, s, len))
+		return 0;
+	*p += len;
+	return 1;
+}
+
+static void parse_line(struct chunk *ck, const char *line, const char *tag,
+			const char *eol)
+{
+	uint64_t vals[RE_COLS_MAX_COLS];
+	const char *p = tag + 5, *name, *colon;
+	int table, name_id, want;
+
+	if (tag - line >= 2 && !memcmp(tag - 2, "RE", 2)) {
+		table = RE_COLS_RE_LOG;
+	} else if (tag - line >= 2 && !memcmp(tag - 2, "TR", 2)) {
+		if (match(&p, eol, "C_STATE TIME "))
+			table = RE_COLS_TR_C_STATE;
+		else if (match(&p, eol, "CYCLE "))
+			table = RE_COLS_TR_CYCLE;
+		else if (match(&p, eol, "TRANSITION "))
+			table = RE_COLS_TR_TRANSITION;
+		else if (match(&p, eol, "C "))
+			table = RE_COLS_TR_C;
+		else if (match(&p, eol, "P "))
+			table = RE_COLS_TR_P;
+		else
+			return;
+	} else {
+		return;
+	}
+	name = p;
+	for (colon = p; colon + 1 < eol; colon++)
+		if (colon[0] == ':' && colon[1] == ' ')
+			break;
+	if (colon + 1 >= eol)
+		return;
+	name_id = chunk_name(ck, name, colon - name);
+	if (name_id < 0)
+		return;
+
+	want = re_cols_schema[table].nr_cols - 2;
+	if (parse_numbers(colon + 2, eol, vals + 2, want) != want)
+		return;
+	vals[0] = parse_stamp(line, tag);
+	vals[1] = name_id;
+	if (colbuf_append(&ck->tab[table], table, vals))
+		ck->err = -ENOMEM;
+}
+
+static void parse_chunk(struct chunk *ck)
+{
+	const char *p = ck->begin, *tag, *line, *eol;
+
+	while (p < ck->end && !ck->err) {
+		tag = find_tag(p, ck->end);
+		if (!tag)
+			break;
+		for (line = tag; line > ck->begin && line[-1] != '\n'; line--)
+			;
+		eol = memchr(tag, '\n', ck->end - tag);
+		if (!eol)
+			eol = ck->end;
+		parse_line(ck, line, tag, eol);
+		p = eol;
+	}
+}
+
+static void *worker(void *unused)
+{
+	unsigned int i;
+
+	while ((i = __sync_fetch_and_add(&next_chunk, 1)) < nr_chunks)
+		parse_chunk(&chunks[i]);
+	return NULL;
+}
+
+// cut [p, end) into about n chunks ending at newlines
+static int add_chunks(const char *p, const char *end, unsigned int n)
+{
+	size_t step = (end - p) / n;
+	const char *cut;
+	struct chunk *c;
+
+	if (step < MIN_CHUNK)
+		step = MIN_CHUNK;
+	while (p < end) {
+		cut = (size_t)(end - p) > step ? p + step : end;
+		if (cut < end) {
+			cut = memchr(cut, '\n', end - cut);
+			cut = cut ? cut + 1 : end;
+		}
+		c = realloc(chunks, (nr_chunks + 1) * sizeof(*chunks));
+		if (!c)
+			return -ENOMEM;
+		chunks = c;
+		memset(&chunks[nr_chunks], 0, sizeof(*chunks));
+		chunks[nr_chunks].begin = p;
+		chunks[nr_chunks].end = cut;
+		nr_chunks++;
+		p = cut;
+	}
+	return 0;
+}
+
+// zeroes up to the 8 byte boundary after len bytes
+static int write_pad(FILE *f, size_t len)
+{
+	static const char zero[8];
+	size_t pad = re_cols_padded(len) - len;
+
+	if (pad && fwrite(zero, 1, pad, f) != pad)
+		return -EIO;
+	return 0;
+}
+
+static int write_padded(FILE *f, const void *data, size_t len)
+{
+	if (len && fwrite(data, 1, len, f) != len)
+		return -EIO;
+	return write_pad(f, len);
+}
+
+static int write_cols(const char *path)
+{
+	static char names[MAX_NAMES][RE_COLS_NAME_LEN];
+	struct re_cols_header h;
+	unsigned int nr_names = 0, i, j, t, c, w;
+	size_t len, k;
+	uint16_t *ids;
+	unsigned char *buf;
+	FILE *f;
+	int ret = 0;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, RE_COLS_MAGIC, 8);
+	h.version = RE_COLS_VERSION;
+
+	// merge the name tables, remap the name columns in place
+	for (i = 0; i < nr_chunks; i++) {
+		uint16_t remap[MAX_NAMES];
+
+		for (j = 0; j < chunks[i].nr_names; j++) {
+			for (k = 0; k < nr_names; k++)
+				if (!strcmp(names[k], chunks[i].names[j]))
+					break;
+			if (k == nr_names) {
+				if (nr_names == MAX_NAMES)
+					return -E2BIG;
+				memcpy(names[nr_names++], chunks[i].names[j],
+						RE_COLS_NAME_LEN);
+			}
+			remap[j] = k;
+		}
+		for (t = 0; t < RE_COLS_TABLES; t++) {
+			ids = (uint16_t *)chunks[i].tab[t].col[1];
+			for (k = 0; k < chunks[i].tab[t].rows; k++)
+				ids[k] = remap[ids[k]];
+			h.rows[t] += chunks[i].tab[t].rows;
+		}
+	}
+	h.nr_names = nr_names;
+
+	f = fopen(path, "w");
+	if (!f)
+		return -errno;
+	if (fwrite(&h, sizeof(h), 1, f) != 1)
+		ret = -EIO;
+	if (!ret)
+		ret = write_padded(f, names, (size_t)nr_names * RE_COLS_NAME_LEN);
+	for (t = 0; t < RE_COLS_TABLES && !ret; t++) {
+		for (c = 0; c < re_cols_schema[t].nr_cols && !ret; c++) {
+			w = re_cols_schema[t].col[c].width;
+			len = 0;
+			for (i = 0; i < nr_chunks && !ret; i++) {
+				buf = chunks[i].tab[t].col[c];
+				k = chunks[i].tab[t].rows * w;
+				if (k && fwrite(buf, 1, k, f) != k)
+					ret = -EIO;
+				len += k;
+			}
+			if (!ret)
+				ret = write_pad(f, len);
+		}
+	}
+	if (fclose(f) && !ret)
+		ret = -EIO;
+	return ret;
+}
+
+static int summary(const char *path, int table)
+{
+	struct re_cols cols;
+	unsigned int t, c;
+	uint64_t r;
+	int ret = re_cols_open(&cols, path);
+
+	if (ret)
+		return ret;
+	if (table < 0) {
+		printf("names:");
+		for (r = 0; r < cols.nr_names; r++)
+			printf(" %s", cols.names[r]);
+		printf("\n");
+		for (t = 0; t < RE_COLS_TABLES; t++)
+			printf("%-14s %llu rows\n", re_cols_schema[t].tag,
+					(unsigned long long)cols.rows[t]);
+	} else {
+		for (c = 0; c < re_cols_schema[table].nr_cols; c++)
+			printf("%s%s", c ? "," : "", re_cols_schema[table].col[c].name);
+		printf("\n");
+		for (r = 0; r < cols.rows[table]; r++) {
+			for (c = 0; c < re_cols_schema[table].nr_cols; c++) {
+				uint64_t v = re_cols_get(&cols, table, c, r);
+
+				if (c == 1 && v < cols.nr_names)
+					printf(",%s", cols.names[v]);
+				else
+					printf("%s%llu", c ? "," : "",
+							(unsigned long long)v);
+			}
+			printf("\n");
+		}
+	}
+	re_cols_close(&cols);
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-j threads] -o out.rec log...\n"
+		"       %s -s file.rec\n"
+		"       %s -p RE_LOG|C|P|C_STATE|CYCLE|TRANSITION file.rec\n",
+		prog, prog, prog);
+}
+
+int main(int argc, char **argv)
+{
+	static const char * const table_names[RE_COLS_TABLES] = {
+		"RE_LOG", "C", "P", "C_STATE", "CYCLE", "TRANSITION",
+	};
+	unsigned int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	const char *out = NULL;
+	struct timespec t0, t1;
+	pthread_t *tids;
+	size_t total = 0;
+	struct stat st;
+	int opt, fd, i, t, table = -2, ret = 0;
+	void *map;
+	double secs;
+
+	while ((opt = getopt(argc, argv, "j:o:sp:")) != -1) {
+		switch (opt) {
+		case 'j':
+			threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			out = optarg;
+			break;
+		case 's':
+			table = -1;
+			break;
+		case 'p':
+			for (t = 0; t < RE_COLS_TABLES; t++)
+				if (!strcmp(optarg, table_names[t]))
+					table = t;
+			if (table < 0) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (table > -2) {
+		if (optind != argc - 1) {
+			usage(argv[0]);
+			return 1;
+		}
+		ret = summary(argv[optind], table);
+		if (ret)
+			fprintf(stderr, "%s: %s\n", argv[optind], strerror(-ret));
+		return !!ret;
+	}
+	if (!out || optind == argc || !threads) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = optind; i < argc; i++) {
+		fd = open(argv[i], O_RDONLY);
+		if (fd < 0 || fstat(fd, &st) < 0) {
+			perror(argv[i]);
+			return 1;
+		}
+		if (!st.st_size) {
+			close(fd);
+			continue;
+		}
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (map == MAP_FAILED) {
+			perror(argv[i]);
+			return 1;
+		}
+		madvise(map, st.st_size, MADV_SEQUENTIAL);
+		total += st.st_size;
+		if (add_chunks(map, (const char *)map + st.st_size,
+				threads * CHUNKS_PER_THREAD))
+			return 1;
+	}
+
+	tids = calloc(threads, sizeof(*tids));
+	if (!tids)
+		return 1;
+	for (i = 0; i < (int)threads; i++)
+		if (pthread_create(&tids[i], NULL, worker, NULL))
+			break;
+	while (i--)
+		pthread_join(tids[i], NULL);
+	for (i = 0; i < (int)nr_chunks; i++)
+		if (chunks[i].err)
+			ret = chunks[i].err;
+	if (!ret)
+		ret = write_cols(out);
+	if (ret) {
+		fprintf(stderr, "%s: %s\n", out, strerror(-ret));
+		return 1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	fprintf(stderr, "%zu bytes in %.3f s, %.1f MB/s, %u chunks\n", total,
+			secs, secs > 0 ? total / secs / 1e6 : 0, nr_chunks);
+	return 0;
+}
@@ -0,0 +1,441 @@
+/*
+ *  tools/jit-rfts/re_replay.c
+ *
+ * Replays the RE_LOG / TR_LOG lines cpufreq_re_stats prints (with
+ * tracing_state and logging_state set, under the reliability governor)
+ * through the host engine, once as recorded and once under another
+ * policy or model configuration, and compares FIT, energy and the time
+ * the policy clamped performance.
+ *
+ * The timeline is cut at every "TR_LOG P" line (one per governor
+ * sample). The "TR_LOG C_STATE TIME" snapshot printed right before it
+ * gives the idle residency of each state in the segment, the P line the
+ * floor and the load based choice the OPP was picked from, and the
+ * "TR_LOG C" lines the idle periods the C ceiling made shallower than
+ * the governor wanted. In the alternative run the work of a segment is
+ * kept in cycles, so a lower OPP stretches busy time into idle time (or
+ * into the next segment), and the ceiling is applied to the idle time
+ * the governor would have chosen.
+ *
+ * usage: re_replay [options] [dmesg capture...]
+ *
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "re_engine.h"
+
+#define REPLAY_CHUNK 65536
+
+struct replay_seg {
+	u64 start;			// usec, unwrapped
+	u32 len;
+	u8 opp;				// ascending index the cpu ran at
+	u8 ideal;			// load based choice
+	u8 floor;
+	u32 idle[RE_CORE_IDLE_STATES];	// as recorded
+	u32 want[RE_CORE_IDLE_STATES];	// before the C ceiling
+	u32 c_clamped;			// idle usec made shallower
+};
+
+// totals the kernel printed itself
+struct replay_logged {
+	u64 pow, core_fit, mem_fit;
+	unsigned int samples;
+	unsigned int cycles, overflows;
+};
+
+struct replay_result {
+	struct re_engine_stats st;
+	double p_clamped;		// usec the floor was above the load choice
+	double c_clamped;		// idle usec in a shallower state
+	double busy;
+	double backlog;			// work not done by the end, usec at 1GHz
+	double opp_time[RE_CORE_OPPS];
+};
+
+static struct replay_seg *segs;
+static size_t nr_segs, max_segs;
+static struct replay_logged logged;
+static const char *name_filter;
+static u64 replay_now;
+
+static unsigned long long replay_clock(void *data)
+{
+	return replay_now;
+}
+
+static unsigned int replay_khz(int opp)
+{
+	return re_opp_khz[RE_CORE_OPPS - 1 - opp];
+}
+
+/*
+ * Tag and payload of a trace line, NULL for other lines and for other
+ * log names than -n
+ */
+static const char *replay_match(const char *line, const char *tag)
+{
+	const char *p = strstr(line, tag);
+	const char *colon;
+	size_t len;
+
+	if (!p)
+		return NULL;
+	p += strlen(tag);
+	colon = strstr(p, ": ");
+	if (!colon)
+		return NULL;
+	if (name_filter) {
+		len = strlen(name_filter);
+		if ((size_t)(colon - p) != len || strncmp(p, name_filter, len))
+			return NULL;
+	}
+	return colon + 2;
+}
+
+static struct replay_seg *replay_new_seg(void)
+{
+	struct replay_seg *s;
+
+	if (nr_segs == max_segs) {
+		s = realloc(segs, (max_segs + REPLAY_CHUNK) * sizeof(*segs));
+		if (!s)
+			return NULL;
+		segs = s;
+		max_segs += REPLAY_CHUNK;
+	}
+	s = &segs[nr_segs++];
+	memset(s, 0, sizeof(*s));
+	return s;
+}
+
+static int replay_parse(FILE *f)
+{
+	static unsigned long long snap[RE_CORE_IDLE_STATES], last_snap[RE_CORE_IDLE_STATES];
+	static u32 clamp[RE_CORE_IDLE_STATES][RE_CORE_IDLE_STATES];
+	static int have_snap, have_start;
+	static u64 wrap, last_raw;
+	static struct replay_seg cur;
+	unsigned long long a[9];
+	char line[512];
+	const char *p;
+	struct replay_seg *s;
+	int floor, ideal, entered, want, res, i, j;
+	unsigned int raw;
+	u64 t;
+
+	while (fgets(line, sizeof(line), f)) {
+		if ((p = replay_match(line, "TR_LOG C_STATE TIME "))) {
+			if (sscanf(p, "%llu %llu %llu %llu", &snap[0], &snap[1],
+					&snap[2], &snap[3]) == 4)
+				have_snap = 1;
+		} else if ((p = replay_match(line, "TR_LOG CYCLE "))) {
+			if (sscanf(p, "%llu %llu %llu %llu %llu %llu %llu %llu %llu",
+					&a[0], &a[1], &a[2], &a[3], &a[4], &a[5],
+					&a[6], &a[7], &a[8]) != 9)
+				continue;
+			logged.cycles++;
+			if (a[0] > a[1] || a[3] > a[4])
+				logged.overflows++;
+		} else if ((p = replay_match(line, "TR_LOG C "))) {
+			if (sscanf(p, "%d %d %d", &entered, &want, &res) != 3 ||
+			    entered < 0 || want < 0 || res <= 0 ||
+			    entered >= RE_CORE_IDLE_STATES ||
+			    want >= RE_CORE_IDLE_STATES || want <= entered)
+				continue;
+			clamp[entered][want] += res;
+		} else if ((p = replay_match(line, "TR_LOG P "))) {
+			if (sscanf(p, "%d %d %u", &floor, &ideal, &raw) != 3 ||
+			    !have_snap)
+				continue;
+			// jiffies_to_usecs() wraps every 2^32 usec
+			if (have_start && raw < last_raw &&
+			    last_raw - raw > 0x80000000ULL)
+				wrap += 1ULL << 32;
+			last_raw = raw;
+			t = wrap + raw;
+			if (have_start && t > cur.start) {
+				s = replay_new_seg();
+				if (!s)
+					return -ENOMEM;
+				*s = cur;
+				s->len = (u32)(t - cur.start);
+				for (i = 0; i < RE_CORE_IDLE_STATES; i++) {
+					s->idle[i] = (u32)(snap[i] - last_snap[i]);
+					s->want[i] = s->idle[i];
+				}
+				// undo the ceiling, capped by what was recorded
+				for (i = 0; i < RE_CORE_IDLE_STATES; i++)
+					for (j = i + 1; j < RE_CORE_IDLE_STATES; j++) {
+						res = clamp[i][j] < s->want[i] ?
+							clamp[i][j] : s->want[i];
+						s->want[i] -= res;
+						s->want[j] += res;
+						s->c_clamped += res;
+					}
+			}
+			if (floor < 0)
+				floor = 0;
+			if (ideal < 0)
+				ideal = 0;
+			if (floor >= RE_CORE_OPPS)
+				floor = RE_CORE_OPPS - 1;
+			if (ideal >= RE_CORE_OPPS)
+				ideal = RE_CORE_OPPS - 1;
+			cur.start = t;
+			cur.floor = floor;
+			cur.ideal = ideal;
+			cur.opp = floor > ideal ? floor : ideal;
+			memcpy(last_snap, snap, sizeof(snap));
+			memset(clamp, 0, sizeof(clamp));
+			have_snap = 0;
+			have_start = 1;
+		} else if ((p = replay_match(line, "RE_LOG "))) {
+			if (sscanf(p, "%llu %llu %llu %llu %llu", &a[0], &a[1],
+					&a[2], &a[3], &a[4]) != 5)
+				continue;
+			logged.pow += a[2];
+			logged.core_fit += a[3];
+			logged.mem_fit += a[4];
+			logged.samples++;
+		}
+	}
+	return 0;
+}
+
+/*
+ * One pass over the timeline. With alt set, the engine decisions (or
+ * none with policy off) replace the recorded ones.
+ */
+static int replay_run(const struct re_engine_config *cfg, int alt,
+			int policy, struct replay_result *r)
+{
+	struct re_engine_config c = *cfg;
+	const struct replay_seg *s;
+	double work, busy, idle, total, scale, carry = 0;
+	u32 idle_alt[RE_CORE_IDLE_STATES];
+	int opp, floor, ceiling, i, ret;
+	size_t k;
+
+	memset(r, 0, sizeof(*r));
+	replay_now = segs[0].start;
+	c.nr_cpus = 1;
+	c.boot_khz = replay_khz(segs[0].opp);
+	ret = re_engine_init(&c);
+	if (ret)
+		return ret;
+
+	for (k = 0; k < nr_segs; k++) {
+		s = &segs[k];
+		replay_now = s->start;
+		// closes the cycles and charges the previous segment
+		ceiling = re_engine_get_C_states(0);
+		floor = re_engine_get_P_states(0);
+
+		if (!alt) {
+			opp = s->opp;
+			if (s->floor > s->ideal)
+				r->p_clamped += s->len;
+			r->c_clamped += s->c_clamped;
+			memcpy(idle_alt, s->idle, sizeof(idle_alt));
+			busy = s->len;
+			for (i = 0; i < RE_CORE_IDLE_STATES; i++)
+				busy -= s->idle[i];
+		} else {
+			if (!policy)
+				floor = 0, ceiling = RE_CORE_IDLE_STATES - 1;
+			opp = floor > s->ideal ? floor : s->ideal;
+			if (floor > s->ideal)
+				r->p_clamped += s->len;
+
+			// recorded busy time in cycles, run at the new OPP
+			busy = s->len;
+			for (i = 0; i < RE_CORE_IDLE_STATES; i++)
+				busy -= s->idle[i];
+			if (busy < 0)
+				busy = 0;
+			work = busy * replay_khz(s->opp) / 1000000.0 + carry;
+			busy = work * 1000000.0 / replay_khz(opp);
+			carry = 0;
+			if (busy > s->len) {
+				carry = (busy - s->len) * replay_khz(opp) / 1000000.0;
+				busy = s->len;
+			}
+			// what is left is idle, spread like the governor wanted it
+			idle = s->len - busy;
+			total = 0;
+			for (i = 0; i < RE_CORE_IDLE_STATES; i++)
+				total += s->want[i];
+			scale = total > 0 ? idle / total : 0;
+			memset(idle_alt, 0, sizeof(idle_alt));
+			for (i = 0; i < RE_CORE_IDLE_STATES; i++) {
+				u32 v = (u32)(s->want[i] * scale);
+
+				if (i > ceiling) {
+					idle_alt[ceiling] += v;
+					r->c_clamped += v;
+				} else {
+					idle_alt[i] += v;
+				}
+			}
+			if (!total)
+				idle_alt[0] = (u32)idle;
+		}
+		if (busy > 0)
+			r->busy += busy;
+		r->opp_time[opp] += s->len;
+		re_engine_set_freq(0, replay_khz(opp));
+		for (i = 0; i < RE_CORE_IDLE_STATES; i++)
+			re_engine_idle(0, i, idle_alt[i]);
+	}
+	replay_now = segs[nr_segs - 1].start + segs[nr_segs - 1].len;
+	re_engine_get_P_states(0);
+	re_engine_read(0, &r->st);
+	r->backlog = carry;
+	re_engine_exit();
+	return 0;
+}
+
+static void replay_row(const char *what, double rec, double alt,
+			const char *unit)
+{
+	printf("%-18s %16.3f %16.3f %+9.2f%% %s\n", what, rec, alt,
+			rec != 0 ? (alt - rec) * 100 / rec : 0, unit);
+}
+
+static void replay_report(const struct replay_result *rec,
+			const struct replay_result *alt, double span)
+{
+	const struct re_engine_stats *a = &rec->st, *b = &alt->st;
+	int i;
+
+	printf("timeline           %.1f s in %zu segments\n", span / 1e6, nr_segs);
+	if (logged.samples)
+		printf("logged (RE_LOG)    pow %llu core fit %llu mem fit %llu over %u samples\n",
+				(unsigned long long)logged.pow,
+				(unsigned long long)logged.core_fit,
+				(unsigned long long)logged.mem_fit,
+				logged.samples);
+	if (logged.cycles)
+		printf("logged (CYCLE)     %u cycles, %u over budget\n",
+				logged.cycles, logged.overflows);
+	printf("%-18s %16s %16s %10s\n", "", "recorded", "replay", "delta");
+	replay_row("core fit", a->acc.core_fit_acc, b->acc.core_fit_acc, "");
+	replay_row("mem fit", a->acc.mem_fit_acc, b->acc.mem_fit_acc, "");
+	replay_row("energy",
+			(double)(a->acc.core_pow_acc + a->acc.mem_pow_acc) / 100 / 1e9,
+			(double)(b->acc.core_pow_acc + b->acc.mem_pow_acc) / 100 / 1e9,
+			"J");
+	replay_row("wear", a->acc.wear_acc / 1e9, b->acc.wear_acc / 1e9,
+			"OPP100 s");
+	replay_row("busy", rec->busy / 1e6, alt->busy / 1e6, "s");
+	replay_row("P floor clamped", rec->p_clamped / 1e6,
+			alt->p_clamped / 1e6, "s");
+	replay_row("C ceiling clamped", rec->c_clamped / 1e6,
+			alt->c_clamped / 1e6, "s");
+	replay_row("cycles over budget", a->overflows, b->overflows, "");
+	printf("%-18s %16u %16u\n", "cycles closed", a->epoch, b->epoch);
+	if (alt->backlog > 0)
+		printf("%-18s %16s %16.3f s of 1GHz work left over\n",
+				"backlog", "", alt->backlog / 1e6);
+	for (i = 0; i < RE_CORE_OPPS; i++) {
+		char what[32];
+
+		snprintf(what, sizeof(what), "at %u MHz", replay_khz(i) / 1000);
+		replay_row(what, rec->opp_time[i] / 1e6, alt->opp_time[i] / 1e6, "s");
+	}
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-n log_name] [-p threshold|none] [-l location_factor]\n"
+		"       [-f target_factor] [-b bank_cap] [-e epoch_usec] [file...]\n"
+		"  the replay column re-runs the trace with the given policy and model,\n"
+		"  the recorded one accounts the trace as it happened with the defaults\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	struct re_engine_config rec_cfg, alt_cfg;
+	struct replay_result rec, alt;
+	int opt, policy = 1, ret, i;
+	FILE *f;
+
+	re_engine_default_config(&rec_cfg);
+	alt_cfg = rec_cfg;
+	while ((opt = getopt(argc, argv, "n:p:l:f:b:e:")) != -1) {
+		switch (opt) {
+		case 'n':
+			name_filter = optarg;
+			break;
+		case 'p':
+			if (!strcmp(optarg, "threshold"))
+				policy = 1;
+			else if (!strcmp(optarg, "none"))
+				policy = 0;
+			else {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'l':
+			alt_cfg.location_factor = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			alt_cfg.target_factor = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			alt_cfg.bank_cap = strtol(optarg, NULL, 0);
+			break;
+		case 'e':
+			alt_cfg.epoch_len = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind == argc) {
+		ret = replay_parse(stdin);
+	} else {
+		for (ret = 0, i = optind; i < argc && !ret; i++) {
+			f = fopen(argv[i], "r");
+			if (!f) {
+				perror(argv[i]);
+				return 1;
+			}
+			ret = replay_parse(f);
+			fclose(f);
+		}
+	}
+	if (ret) {
+		fprintf(stderr, "parse: %s\n", strerror(-ret));
+		return 1;
+	}
+	if (!nr_segs) {
+		fprintf(stderr, "no TR_LOG C_STATE TIME / TR_LOG P pairs found\n");
+		return 1;
+	}
+
+	// trace time is already in jiffy steps
+	re_host_tick_us = 1;
+	re_host_set_clock(replay_clock, NULL);
+	ret = replay_run(&rec_cfg, 0, 1, &rec);
+	if (!ret)
+		ret = replay_run(&alt_cfg, 1, policy, &alt);
+	if (ret) {
+		fprintf(stderr, "engine: %s\n", strerror(-ret));
+		return 1;
+	}
+	replay_report(&rec, &alt, (double)(segs[nr_segs - 1].start
+			+ segs[nr_segs - 1].len - segs[0].start));
+	free(segs);
+	return 0;
+}
@@ -0,0 +1,611 @@
+/*
+ *  tools/jit-rfts/re_sim.c
+ *
+ * Discrete-event simulator of one AM335x cpu running the reliability
+ * engine of librfts. Wakeups arrive from a workload description, a
+ * menu style idle governor picks from the DDR3 state table of
+ * cpuidle33xx.c under the C-state ceiling of the engine and an ondemand
+ * style governor picks the OPP above the P-state floor. Time only
+ * advances from event to event, so hours of device time take seconds.
+ *
+ * The workload file has one phase per line, repeated until -d:
+ *   <seconds> <util %> <exp|uniform|fixed> <mean inter-arrival usec>
+ * util is the busy share at 1GHz, every wakeup brings util * mean usec
+ * of 1GHz work. '#' starts a comment.
+ *
+ * usage: re_sim [options] workload
+ *
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "re_engine.h"
+
+#define SIM_MAX_PHASES 64
+#define SIM_QUEUE 4096			// pending wakeups, more are dropped
+#define SIM_HIST 131072			// latency histogram, 1 usec buckets
+#define SIM_IDLE_HISTORY 8		// idle intervals the idle governor averages
+
+enum { DIST_EXP, DIST_UNIFORM, DIST_FIXED };
+
+struct sim_phase {
+	double seconds;
+	unsigned int util;		// %
+	int dist;
+	double mean_us;
+};
+
+// DDR3 table of arch/arm/mach-omap2/cpuidle33xx.c
+struct sim_idle_state {
+	const char *name;
+	unsigned int exit_latency;	// usec
+	unsigned int target_residency;	// usec
+};
+
+static const struct sim_idle_state sim_states[RE_CORE_IDLE_STATES] = {
+	{ "WFI", 68, 150 },
+	{ "C1", 130, 200 },
+	{ "C2", 530, 800 },
+	{ "C3", 650, 1000 },
+};
+
+struct sim_job {
+	double arrival;
+	double work;			// usec at 1GHz
+};
+
+struct sim {
+	// configuration
+	struct sim_phase phase[SIM_MAX_PHASES];
+	int nr_phases;
+	double duration;		// usec
+	int use_engine;
+	unsigned int sampling_rate;	// usec
+	unsigned int up_threshold;	// %
+	unsigned int transition_latency;	// usec
+	u64 rng;
+
+	// state
+	double now;
+	int cur_phase;
+	double phase_end;
+	double next_arrival;
+	double next_sample;
+	int opp;			// ascending index, 0 = 300MHz
+	int idle;			// in an idle state
+	int idle_state;
+	double idle_since;
+	double busy_since_sample;
+	double last_sample;
+	double stall_until;		// frequency transition in progress
+	struct sim_job queue[SIM_QUEUE];
+	unsigned int q_head, q_len;
+	int job_started;
+	double idle_hist[SIM_IDLE_HISTORY];
+	unsigned int idle_hist_pos;
+
+	// results
+	u64 jobs_in, jobs_done, jobs_dropped;
+	double work_in, work_done;
+	double state_time[RE_CORE_IDLE_STATES];
+	u64 state_entries[RE_CORE_IDLE_STATES];
+	double opp_time[RE_CORE_OPPS];
+	double busy_time;
+	unsigned int transitions;
+	unsigned int floor_raises;	// samples where the floor won over load
+	unsigned int ceiling_cuts;	// idle entries limited by the ceiling
+	unsigned int *wake_hist;
+	unsigned int *resp_hist;
+};
+
+static struct sim sim;
+
+static unsigned long long sim_clock(void *data)
+{
+	return (unsigned long long)sim.now;
+}
+
+// xorshift64*, uniform in (0, 1]
+static double sim_rand(void)
+{
+	sim.rng ^= sim.rng >> 12;
+	sim.rng ^= sim.rng << 25;
+	sim.rng ^= sim.rng >> 27;
+	return ((sim.rng * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0)
+		+ (1.0 / 9007199254740992.0);
+}
+
+static double sim_interarrival(const struct sim_phase *p)
+{
+	switch (p->dist) {
+	case DIST_EXP:
+		return -log(sim_rand()) * p->mean_us;
+	case DIST_UNIFORM:
+		return sim_rand() * 2 * p->mean_us;
+	default:
+		return p->mean_us;
+	}
+}
+
+static unsigned int sim_khz(int opp)
+{
+	return re_opp_khz[RE_CORE_OPPS - 1 - opp];
+}
+
+static void sim_hist_add(unsigned int *hist, double usec)
+{
+	unsigned long idx = usec < 0 ? 0 : (unsigned long)usec;
+
+	hist[idx < SIM_HIST ? idx : SIM_HIST - 1]++;
+}
+
+static double sim_hist_pct(const unsigned int *hist, u64 total, double pct)
+{
+	u64 want = (u64)ceil(total * pct / 100.0), seen = 0;
+	int i;
+
+	if (!total)
+		return 0;
+	for (i = 0; i < SIM_HIST; i++) {
+		seen += hist[i];
+		if (seen >= want)
+			return i;
+	}
+	return SIM_HIST - 1;
+}
+
+static int sim_load(const char *path)
+{
+	char line[256], dist[16];
+	struct sim_phase *p;
+	FILE *f = fopen(path, "r");
+
+	if (!f)
+		return -errno;
+	while (fgets(line, sizeof(line), f)) {
+		char *hash = strchr(line, '#');
+
+		if (hash)
+			*hash = 0;
+		if (strspn(line, " \t\r\n") == strlen(line))
+			continue;
+		if (sim.nr_phases == SIM_MAX_PHASES) {
+			fclose(f);
+			return -E2BIG;
+		}
+		p = &sim.phase[sim.nr_phases];
+		if (sscanf(line, "%lf %u %15s %lf", &p->seconds, &p->util,
+				dist, &p->mean_us) != 4 || p->seconds <= 0 ||
+				p->mean_us <= 0 || p->util > 100) {
+			fclose(f);
+			return -EINVAL;
+		}
+		if (!strcmp(dist, "exp"))
+			p->dist = DIST_EXP;
+		else if (!strcmp(dist, "uniform"))
+			p->dist = DIST_UNIFORM;
+		else if (!strcmp(dist, "fixed"))
+			p->dist = DIST_FIXED;
+		else {
+			fclose(f);
+			return -EINVAL;
+		}
+		sim.nr_phases++;
+	}
+	fclose(f);
+	return sim.nr_phases ? 0 : -EINVAL;
+}
+
+/*
+ * Menu style selection: the deepest state whose target residency fits
+ * the average of the last idle intervals, limited by the C ceiling
+ */
+static int sim_select_idle(void)
+{
+	double predicted = 0;
+	int ceiling = RE_CORE_IDLE_STATES - 1;
+	int i, state = 0;
+
+	for (i = 0; i < SIM_IDLE_HISTORY; i++)
+		predicted += sim.idle_hist[i];
+	predicted /= SIM_IDLE_HISTORY;
+
+	// with -n the engine still closes its cycles, the ceiling is ignored
+	ceiling = re_engine_get_C_states(0);
+	if (!sim.use_engine || ceiling >= RE_CORE_IDLE_STATES)
+		ceiling = RE_CORE_IDLE_STATES - 1;
+	for (i = 1; i < RE_CORE_IDLE_STATES; i++) {
+		if (sim_states[i].target_residency > predicted)
+			break;
+		if (i > ceiling) {
+			sim.ceiling_cuts++;
+			break;
+		}
+		state = i;
+	}
+	return state;
+}
+
+static void sim_enter_idle(void)
+{
+	sim.idle = 1;
+	sim.idle_state = sim_select_idle();
+	sim.idle_since = sim.now;
+	sim.state_entries[sim.idle_state]++;
+}
+
+// leave idle at now, the cpu is usable after the exit latency
+static void sim_exit_idle(void)
+{
+	double exit = sim_states[sim.idle_state].exit_latency;
+	double residency = sim.now + exit - sim.idle_since;
+
+	sim.state_time[sim.idle_state] += residency;
+	sim.idle_hist[sim.idle_hist_pos++ % SIM_IDLE_HISTORY] = sim.now - sim.idle_since;
+	sim.now += exit;
+	re_engine_idle(0, sim.idle_state, (unsigned int)residency);
+	sim.idle = 0;
+}
+
+static void sim_set_opp(int opp)
+{
+	if (opp == sim.opp)
+		return;
+	sim.opp = opp;
+	sim.transitions++;
+	sim.stall_until = sim.now + sim.transition_latency;
+	re_engine_set_freq(0, sim_khz(opp));
+}
+
+/*
+ * ondemand: max above up_threshold, else the lowest OPP at or above
+ * load * max, then raised to the reliability floor
+ */
+static void sim_sample(void)
+{
+	double elapsed = sim.now - sim.last_sample;
+	unsigned int load = elapsed > 0 ?
+		(unsigned int)(sim.busy_since_sample * 100 / elapsed) : 100;
+	unsigned int target;
+	int opp, floor;
+
+	if (load > sim.up_threshold) {
+		opp = RE_CORE_OPPS - 1;
+	} else {
+		target = load * sim_khz(RE_CORE_OPPS - 1) / 100;
+		for (opp = 0; opp < RE_CORE_OPPS - 1; opp++)
+			if (sim_khz(opp) >= target)
+				break;
+	}
+	floor = re_engine_get_P_states(0);
+	if (sim.use_engine && floor > opp) {
+		opp = floor;
+		sim.floor_raises++;
+	}
+	sim_set_opp(opp);
+	sim.last_sample = sim.now;
+	sim.busy_since_sample = 0;
+	sim.next_sample = sim.now + sim.sampling_rate;
+}
+
+static void sim_arrival(void)
+{
+	const struct sim_phase *p = &sim.phase[sim.cur_phase];
+	double work = p->util * p->mean_us / 100.0;
+
+	sim.jobs_in++;
+	sim.work_in += work;
+	if (sim.q_len == SIM_QUEUE) {
+		sim.jobs_dropped++;
+	} else {
+		struct sim_job *j = &sim.queue[(sim.q_head + sim.q_len++) % SIM_QUEUE];
+
+		j->arrival = sim.now;
+		j->work = work;
+	}
+	sim.next_arrival = sim.now + sim_interarrival(p);
+}
+
+// run the queue from now up to until, at the current OPP
+static void sim_run(double until)
+{
+	double speed, start, span, t;
+	struct sim_job *j;
+
+	while (sim.now < until && sim.q_len) {
+		j = &sim.queue[sim.q_head];
+		if (sim.now < sim.stall_until) {
+			t = sim.stall_until < until ? sim.stall_until : until;
+			span = t - sim.now;
+			sim.busy_time += span;
+			sim.busy_since_sample += span;
+			sim.opp_time[sim.opp] += span;
+			sim.now = t;
+			continue;
+		}
+		if (!sim.job_started) {
+			sim.job_started = 1;
+			sim_hist_add(sim.wake_hist, sim.now - j->arrival);
+		}
+		speed = sim_khz(sim.opp) / 1000000.0;	// 1GHz usec per usec
+		start = sim.now;
+		t = start + j->work / speed;
+		if (t > until) {
+			t = until;
+			span = t - start;
+			j->work -= span * speed;
+			sim.work_done += span * speed;
+		} else {
+			// whole job, rounding must not leave a sliver behind
+			span = t - start;
+			sim.work_done += j->work;
+			j->work = 0;
+		}
+		sim.busy_time += span;
+		sim.busy_since_sample += span;
+		sim.opp_time[sim.opp] += span;
+		sim.now = t;
+		if (!j->work) {
+			sim.jobs_done++;
+			sim_hist_add(sim.resp_hist, sim.now - j->arrival);
+			sim.q_head = (sim.q_head + 1) % SIM_QUEUE;
+			sim.q_len--;
+			sim.job_started = 0;
+		}
+	}
+}
+
+static void sim_next_phase(void)
+{
+	sim.cur_phase = (sim.cur_phase + 1) % sim.nr_phases;
+	sim.phase_end = sim.now + sim.phase[sim.cur_phase].seconds * 1e6;
+	sim.next_arrival = sim.now + sim_interarrival(&sim.phase[sim.cur_phase]);
+}
+
+static double sim_min(double a, double b)
+{
+	return a < b ? a : b;
+}
+
+static void sim_loop(void)
+{
+	double next;
+
+	while (sim.now < sim.duration) {
+		next = sim_min(sim_min(sim.next_arrival, sim.phase_end),
+				sim.duration);
+		if (sim.idle) {
+			// the ondemand timer is deferrable and never wakes the cpu
+			if (next > sim.now)
+				sim.now = next;
+			if (sim.now >= sim.duration)
+				break;
+			if (sim.now >= sim.phase_end) {
+				sim_next_phase();
+				continue;
+			}
+			sim_arrival();
+			sim_exit_idle();
+			if (sim.now >= sim.next_sample)
+				sim_sample();
+			continue;
+		}
+		if (sim.q_len)
+			next = sim_min(next, sim.next_sample);
+		sim_run(next);
+		if (sim.now >= sim.next_sample)
+			sim_sample();
+		if (sim.now >= sim.phase_end)
+			sim_next_phase();
+		while (sim.next_arrival <= sim.now && sim.now < sim.duration)
+			sim_arrival();
+		if (!sim.q_len && sim.now < sim.duration)
+			sim_enter_idle();
+	}
+	if (sim.idle) {
+		sim.state_time[sim.idle_state] += sim.now - sim.idle_since;
+		re_engine_idle(0, sim.idle_state,
+				(unsigned int)(sim.now - sim.idle_since));
+	}
+}
+
+static void sim_report(double wall)
+{
+	struct re_engine_stats st;
+	double secs = sim.duration / 1e6;
+	int i;
+
+	printf("simulated    %.1f s in %.2f s (%.0fx)\n", secs, wall,
+			wall > 0 ? secs / wall : 0);
+	printf("wakeups      %llu done %llu dropped %llu, %.1f/s\n",
+			(unsigned long long)sim.jobs_in,
+			(unsigned long long)sim.jobs_done,
+			(unsigned long long)sim.jobs_dropped,
+			sim.jobs_done / secs);
+	printf("throughput   %.2f%% of offered work, busy %.2f%%\n",
+			sim.work_in > 0 ? sim.work_done * 100 / sim.work_in : 100,
+			sim.busy_time * 100 / sim.duration);
+	printf("wake latency p50 %.0f p90 %.0f p99 %.0f p99.9 %.0f usec\n",
+			sim_hist_pct(sim.wake_hist, sim.jobs_done, 50),
+			sim_hist_pct(sim.wake_hist, sim.jobs_done, 90),
+			sim_hist_pct(sim.wake_hist, sim.jobs_done, 99),
+			sim_hist_pct(sim.wake_hist, sim.jobs_done, 99.9));
+	printf("response     p50 %.0f p90 %.0f p99 %.0f p99.9 %.0f usec\n",
+			sim_hist_pct(sim.resp_hist, sim.jobs_done, 50),
+			sim_hist_pct(sim.resp_hist, sim.jobs_done, 90),
+			sim_hist_pct(sim.resp_hist, sim.jobs_done, 99),
+			sim_hist_pct(sim.resp_hist, sim.jobs_done, 99.9));
+	printf("idle        ");
+	for (i = 0; i < RE_CORE_IDLE_STATES; i++)
+		printf(" %s %.2f%% (%llu)", sim_states[i].name,
+				sim.state_time[i] * 100 / sim.duration,
+				(unsigned long long)sim.state_entries[i]);
+	printf("\nopp         ");
+	for (i = 0; i < RE_CORE_OPPS; i++)
+		printf(" %u %.2f%%", sim_khz(i) / 1000,
+				sim.opp_time[i] * 100 / sim.duration);
+	printf("\ntransitions  %u, floor raised %u samples, ceiling cut %u idle entries\n",
+			sim.transitions, sim.floor_raises, sim.ceiling_cuts);
+
+	re_engine_update(0);
+	if (re_engine_read(0, &st))
+		return;
+	// power unit 100 ~ 1mW, so pow * usec / 100 is nJ
+	printf("energy       %.3f J, %.2f mW average\n",
+			(double)(st.acc.core_pow_acc + st.acc.mem_pow_acc) / 100 / 1e9,
+			(double)(st.acc.core_pow_acc + st.acc.mem_pow_acc) / 100
+				/ sim.duration);
+	printf("fit rate     core %.2f (target %u) mem %.2f (target %u)\n",
+			st.acc.core_fit_acc / sim.duration, st.core_fit_target,
+			st.acc.mem_fit_acc / sim.duration, st.mem_fit_target);
+	printf("cycles       %u closed, %u over budget, %.2f%% compliant\n",
+			st.epoch, st.overflows, st.epoch ?
+			(st.epoch - st.overflows) * 100.0 / st.epoch : 100.0);
+	printf("wear         %.3f OPP100 seconds\n",
+			(double)st.acc.wear_acc / 1000 / 1e6);
+}
+
+// -m: the same figures on one key=value line, for re_sweep
+static void sim_report_keys(void)
+{
+	struct re_engine_stats st;
+
+	re_engine_update(0);
+	if (re_engine_read(0, &st))
+		return;
+	printf("throughput=%.4f busy=%.4f wake_p99=%.0f resp_p99=%.0f "
+		"energy=%.6f core_fit=%.4f mem_fit=%.4f core_target=%u "
+		"mem_target=%u compliant=%.4f wear=%.6f\n",
+			sim.work_in > 0 ? sim.work_done * 100 / sim.work_in : 100,
+			sim.busy_time * 100 / sim.duration,
+			sim_hist_pct(sim.wake_hist, sim.jobs_done, 99),
+			sim_hist_pct(sim.resp_hist, sim.jobs_done, 99),
+			(double)(st.acc.core_pow_acc + st.acc.mem_pow_acc) / 100 / 1e9,
+			st.acc.core_fit_acc / sim.duration,
+			st.acc.mem_fit_acc / sim.duration,
+			st.core_fit_target, st.mem_fit_target,
+			st.epoch ? (st.epoch - st.overflows) * 100.0 / st.epoch
+				: 100.0,
+			(double)st.acc.wear_acc / 1000 / 1e6);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-d seconds] [-s seed] [-n] [-m] [-l location_factor]\n"
+		"       [-f target_factor] [-c case] [-b bank_cap] [-e epoch_usec]\n"
+		"       [-r sampling_usec] [-u up_threshold] [-t transition_usec]\n"
+		"       [-T tick_usec] workload\n"
+		"  -n  accounting only, the engine does not steer the governors\n"
+		"  -m  one key=value line instead of the report\n"
+		"  -c  CASE1..4 hardware configuration of cpufreq_re_fit.c\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	struct re_engine_config cfg;
+	struct timespec t0, t1;
+	double secs = 0;
+	int opt, ret, i, keys = 0;
+
+	re_engine_default_config(&cfg);
+	sim.use_engine = 1;
+	sim.sampling_rate = 10000;
+	sim.up_threshold = 80;
+	sim.transition_latency = 300;
+	sim.rng = 88172645463325252ULL;
+
+	while ((opt = getopt(argc, argv, "d:s:nml:f:c:b:e:r:u:t:T:")) != -1) {
+		switch (opt) {
+		case 'd':
+			secs = strtod(optarg, NULL);
+			break;
+		case 's':
+			sim.rng = strtoull(optarg, NULL, 0) | 1;
+			break;
+		case 'n':
+			sim.use_engine = 0;
+			break;
+		case 'm':
+			keys = 1;
+			break;
+		case 'l':
+			cfg.location_factor = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			cfg.target_factor = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			cfg.fit_case = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			cfg.bank_cap = strtol(optarg, NULL, 0);
+			break;
+		case 'e':
+			cfg.epoch_len = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			sim.sampling_rate = strtoul(optarg, NULL, 0);
+			break;
+		case 'u':
+			sim.up_threshold = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			sim.transition_latency = strtoul(optarg, NULL, 0);
+			break;
+		case 'T':
+			re_host_tick_us = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc - 1 || !sim.sampling_rate || !re_host_tick_us) {
+		usage(argv[0]);
+		return 1;
+	}
+	ret = sim_load(argv[optind]);
+	if (ret) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(-ret));
+		return 1;
+	}
+	if (secs <= 0)
+		for (i = 0; i < sim.nr_phases; i++)
+			secs += sim.phase[i].seconds;
+	sim.duration = secs * 1e6;
+
+	sim.wake_hist = calloc(SIM_HIST, sizeof(*sim.wake_hist));
+	sim.resp_hist = calloc(SIM_HIST, sizeof(*sim.resp_hist));
+	if (!sim.wake_hist || !sim.resp_hist)
+		return 1;
+
+	re_host_set_clock(sim_clock, NULL);
+	sim.opp = RE_CORE_OPPS - 1;
+	cfg.boot_khz = sim_khz(sim.opp);
+	ret = re_engine_init(&cfg);
+	if (ret) {
+		fprintf(stderr, "engine: %s\n", strerror(-ret));
+		return 1;
+	}
+	sim.cur_phase = -1;
+	sim_next_phase();
+	sim.next_sample = sim.sampling_rate;
+	sim_enter_idle();
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	sim_loop();
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	if (keys)
+		sim_report_keys();
+	else
+		sim_report((t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+	re_engine_exit();
+	return 0;
+}
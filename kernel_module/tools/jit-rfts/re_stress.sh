@@ -0,0 +1,68 @@
+#!/bin/sh
+# Idle / DVFS stress of the JIT-RFTS stack, for the QEMU target (or a
+# board). Runs duty cycle phases under the reliability governor, then
+# steps through every OPP with the userspace governor, and prints
+# "key value" lines of what the engine, cpuidle and cpufreq counted.
+#   re_stress.sh [seconds per phase] [duty%...]
+# With cpufreq_re_bench.ko installed it also logs the hook timings.
+
+SECS=${1:-10}
+[ $# -gt 0 ] && shift
+DUTIES=${*:-"5 25 50 75 95"}
+CPU=/sys/devices/system/cpu/cpu0
+RE=$CPU/cpufreq/re_stats
+
+modprobe cpufreq_re 2>/dev/null
+[ -d $RE ] || { echo "cpufreq_re is not loaded"; exit 1; }
+
+snapshot() {
+	for s in $CPU/cpuidle/state*; do
+		echo "idle_$(cat $s/name)_usage $(cat $s/usage)"
+		echo "idle_$(cat $s/name)_time $(cat $s/time)"
+	done
+	for f in core_fit_acc mem_fit_acc core_pow_acc mem_pow_acc; do
+		echo "$f $(cat $RE/$f)"
+	done
+	echo "total_trans $(cat $CPU/cpufreq/stats/total_trans 2>/dev/null)"
+}
+
+# busy for duty% of each 100ms period
+duty() {
+	end=$(($(date +%s) + SECS))
+	while [ $(date +%s) -lt $end ]; do
+		( while :; do :; done ) &
+		usleep $(($1 * 1000))
+		kill $!
+		usleep $(((100 - $1) * 1000))
+	done
+}
+
+echo reliability > $CPU/cpufreq/scaling_governor
+echo 1 > $RE/tracing_state
+for d in $DUTIES; do
+	snapshot | sed "s/^/before_$d /"
+	duty $d
+	snapshot | sed "s/^/after_$d /"
+done
+echo 0 > $RE/tracing_state
+
+echo userspace > $CPU/cpufreq/scaling_governor
+start=$(date +%s)
+n=0
+while [ $(($(date +%s) - start)) -lt $SECS ]; do
+	for f in $(cat $CPU/cpufreq/scaling_available_frequencies); do
+		echo $f > $CPU/cpufreq/scaling_setspeed
+		n=$((n + 1))
+	done
+done
+echo "dvfs_steps $n"
+set -- $(cat $RE/transition_stats)
+echo "transitions $1"
+echo "transition_time_us $2"
+echo "avg_transition_us $4"
+echo reliability > $CPU/cpufreq/scaling_governor
+
+if modprobe cpufreq_re_bench 2>/dev/null; then
+	dmesg | grep "RE_BENCH "
+	rmmod cpufreq_re_bench
+fi
@@ -0,0 +1,431 @@
+/*
+ *  tools/jit-rfts/re_sweep.c
+ *
+ * Parameter sweep over re_sim: every combination of workload, hardware
+ * case (CASE1..4 of cpufreq_re_fit.c), TARGET_FACTOR and DYN_FREQ is one
+ * re_sim run. Runs are spread over the host cpus, results are cached by
+ * a hash of the configuration, and for each workload the configurations
+ * on the Pareto frontier of throughput, FIT and energy are listed.
+ *
+ * usage: re_sweep [-j jobs] [-c cases] [-f target_factors] [-D dyn_freqs]
+ *                 [-o "re_sim options"] [-C cache_dir] [-a] workload...
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define SWEEP_MAX_VALUES 32
+#define SWEEP_MAX_ARGS 64
+
+struct sweep_list {
+	unsigned int nr;
+	unsigned int val[SWEEP_MAX_VALUES];
+};
+
+struct sweep_result {
+	double throughput;		// % of offered work
+	double core_fit;
+	double mem_fit;
+	double energy;			// J
+	double resp_p99;		// usec
+	double compliant;		// % of cycles in budget
+};
+
+struct sweep_job {
+	const char *workload;
+	unsigned int fit_case;
+	unsigned int target_factor;
+	unsigned int dyn_freq;
+	uint64_t hash;
+	pid_t pid;
+	int done;
+	int pareto;
+	struct sweep_result res;
+};
+
+static const char *sim_path;
+static const char *cache_dir = ".re_sweep";
+static char *sim_opts[SWEEP_MAX_ARGS];
+static unsigned int nr_sim_opts;
+
+static int parse_list(struct sweep_list *l, char *s)
+{
+	char *tok;
+
+	l->nr = 0;
+	for (tok = strtok(s, ","); tok; tok = strtok(NULL, ",")) {
+		if (l->nr == SWEEP_MAX_VALUES)
+			return -E2BIG;
+		l->val[l->nr] = strtoul(tok, NULL, 0);
+		if (!l->val[l->nr])
+			return -EINVAL;
+		l->nr++;
+	}
+	return l->nr ? 0 : -EINVAL;
+}
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	while (len--) {
+		h ^= *p++;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static uint64_t hash_file(uint64_t h, const char *path)
+{
+	char buf[4096];
+	ssize_t n;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return h;
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+		h = fnv1a(h, buf, n);
+	close(fd);
+	return h;
+}
+
+/*
+ * The key covers the re_sim binary (size and mtime, so a rebuild with
+ * another model invalidates the cache), the workload contents and the
+ * command line of the run.
+ */
+static void job_hash(struct sweep_job *job, char **argv)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	struct stat st;
+
+	if (!stat(sim_path, &st)) {
+		h = fnv1a(h, &st.st_size, sizeof(st.st_size));
+		h = fnv1a(h, &st.st_mtime, sizeof(st.st_mtime));
+	}
+	h = hash_file(h, job->workload);
+	for (; *argv; argv++)
+		h = fnv1a(h, *argv, strlen(*argv) + 1);
+	job->hash = h;
+}
+
+// re_sim command line of a job, the strings live until the next call
+static void job_argv(const struct sweep_job *job, char **argv)
+{
+	static char c[16], f[16], e[16];
+	unsigned int n = 0, i;
+
+	snprintf(c, sizeof(c), "%u", job->fit_case);
+	snprintf(f, sizeof(f), "%u", job->target_factor);
+	snprintf(e, sizeof(e), "%u", 1000000 / job->dyn_freq);
+	argv[n++] = (char *)sim_path;
+	argv[n++] = "-m";
+	for (i = 0; i < nr_sim_opts; i++)
+		argv[n++] = sim_opts[i];
+	argv[n++] = "-c";
+	argv[n++] = c;
+	argv[n++] = "-f";
+	argv[n++] = f;
+	argv[n++] = "-e";
+	argv[n++] = e;
+	argv[n++] = (char *)job->workload;
+	argv[n] = NULL;
+}
+
+static void cache_path(char *buf, size_t len, uint64_t hash, const char *ext)
+{
+	snprintf(buf, len, "%s/%016llx%s", cache_dir,
+			(unsigned long long)hash, ext);
+}
+
+static int parse_key(const char *line, const char *key, double *val)
+{
+	const char *p = strstr(line, key);
+
+	if (!p)
+		return -EINVAL;
+	*val = strtod(p + strlen(key), NULL);
+	return 0;
+}
+
+static int load_result(struct sweep_job *job)
+{
+	char path[512], line[1024];
+	struct sweep_result *r = &job->res;
+	FILE *f;
+	int ret = -ENOENT;
+
+	cache_path(path, sizeof(path), job->hash, "");
+	f = fopen(path, "r");
+	if (!f)
+		return ret;
+	if (fgets(line, sizeof(line), f))
+		ret = parse_key(line, "throughput=", &r->throughput) ||
+			parse_key(line, "core_fit=", &r->core_fit) ||
+			parse_key(line, "mem_fit=", &r->mem_fit) ||
+			parse_key(line, "energy=", &r->energy) ||
+			parse_key(line, "resp_p99=", &r->resp_p99) ||
+			parse_key(line, "compliant=", &r->compliant) ?
+			-EINVAL : 0;
+	fclose(f);
+	if (!ret)
+		job->done = 1;
+	return ret;
+}
+
+// fork re_sim with its output going to a temporary cache file
+static int start_job(struct sweep_job *job)
+{
+	char *argv[SWEEP_MAX_ARGS + 16];
+	char path[512];
+	pid_t pid;
+	int fd;
+
+	job_argv(job, argv);
+	cache_path(path, sizeof(path), job->hash, ".tmp");
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return -errno;
+	pid = fork();
+	if (pid < 0) {
+		close(fd);
+		return -errno;
+	}
+	if (!pid) {
+		dup2(fd, STDOUT_FILENO);
+		close(fd);
+		execv(sim_path, argv);
+		perror(sim_path);
+		_exit(127);
+	}
+	close(fd);
+	job->pid = pid;
+	return 0;
+}
+
+static int finish_job(struct sweep_job *job, int status)
+{
+	char tmp[512], path[512];
+
+	job->pid = 0;
+	cache_path(tmp, sizeof(tmp), job->hash, ".tmp");
+	cache_path(path, sizeof(path), job->hash, "");
+	if (!WIFEXITED(status) || WEXITSTATUS(status) || rename(tmp, path)) {
+		unlink(tmp);
+		return -EIO;
+	}
+	return load_result(job);
+}
+
+static double job_fit(const struct sweep_job *job)
+{
+	return job->res.core_fit + job->res.mem_fit;
+}
+
+// a is at least as good as b in every objective and better in one
+static int dominates(const struct sweep_job *a, const struct sweep_job *b)
+{
+	if (a->res.throughput < b->res.throughput || job_fit(a) > job_fit(b) ||
+	    a->res.energy > b->res.energy)
+		return 0;
+	return a->res.throughput > b->res.throughput ||
+		job_fit(a) < job_fit(b) || a->res.energy < b->res.energy;
+}
+
+static int cmp_fit(const void *a, const void *b)
+{
+	const struct sweep_job *x = a, *y = b;
+	int ret = strcmp(x->workload, y->workload);
+
+	if (ret)
+		return ret;
+	if (job_fit(x) != job_fit(y))
+		return job_fit(x) < job_fit(y) ? -1 : 1;
+	return x->res.energy < y->res.energy ? -1 :
+		x->res.energy > y->res.energy;
+}
+
+static void report(struct sweep_job *jobs, unsigned int nr, int all)
+{
+	const char *workload = NULL;
+	unsigned int i, j;
+
+	for (i = 0; i < nr; i++) {
+		jobs[i].pareto = jobs[i].done;
+		for (j = 0; j < nr && jobs[i].pareto; j++)
+			if (jobs[j].done && jobs[j].workload == jobs[i].workload &&
+			    dominates(&jobs[j], &jobs[i]))
+				jobs[i].pareto = 0;
+	}
+	qsort(jobs, nr, sizeof(*jobs), cmp_fit);
+	for (i = 0; i < nr; i++) {
+		if (!jobs[i].done || (!all && !jobs[i].pareto))
+			continue;
+		if (!workload || strcmp(workload, jobs[i].workload)) {
+			workload = jobs[i].workload;
+			printf("# %s\n#   case factor dyn_freq throughput"
+				"      fit   energy resp_p99 compliant\n",
+					workload);
+		}
+		printf("%c %6u %6u %8u %10.4f %8.2f %8.3f %8.0f %9.2f\n",
+				jobs[i].pareto ? '*' : ' ', jobs[i].fit_case,
+				jobs[i].target_factor, jobs[i].dyn_freq,
+				jobs[i].res.throughput, job_fit(&jobs[i]),
+				jobs[i].res.energy, jobs[i].res.resp_p99,
+				jobs[i].res.compliant);
+	}
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-j jobs] [-c cases] [-f target_factors] [-D dyn_freqs]\n"
+		"       [-o \"re_sim options\"] [-s re_sim] [-C cache_dir] [-a] workload...\n"
+		"  lists are comma separated, -a prints the dominated configurations too\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	struct sweep_list cases = { 4, { 1, 2, 3, 4 } };
+	struct sweep_list factors = { 8, { 10, 20, 30, 40, 50, 60, 80, 100 } };
+	struct sweep_list freqs = { 5, { 1, 2, 3, 5, 10 } };
+	unsigned int jobs_max = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int nr, next = 0, running = 0, cached = 0, failed = 0;
+	unsigned int w, c, f, d, i;
+	char *sim_argv[SWEEP_MAX_ARGS + 16];
+	char *opts = NULL, *tok, *slash;
+	struct sweep_job *jobs;
+	struct timespec t0, t1;
+	int opt, all = 0, status;
+	pid_t pid;
+
+	while ((opt = getopt(argc, argv, "j:c:f:D:o:s:C:a")) != -1) {
+		switch (opt) {
+		case 'j':
+			jobs_max = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			if (parse_list(&cases, optarg))
+				goto bad;
+			break;
+		case 'f':
+			if (parse_list(&factors, optarg))
+				goto bad;
+			break;
+		case 'D':
+			if (parse_list(&freqs, optarg))
+				goto bad;
+			break;
+		case 'o':
+			opts = optarg;
+			break;
+		case 's':
+			sim_path = optarg;
+			break;
+		case 'C':
+			cache_dir = optarg;
+			break;
+		case 'a':
+			all = 1;
+			break;
+		default:
+			goto bad;
+		}
+	}
+	if (optind == argc || !jobs_max)
+		goto bad;
+	for (tok = opts ? strtok(opts, " ") : NULL; tok; tok = strtok(NULL, " ")) {
+		if (nr_sim_opts == SWEEP_MAX_ARGS)
+			goto bad;
+		sim_opts[nr_sim_opts++] = tok;
+	}
+	if (!sim_path) {
+		// re_sim next to re_sweep
+		slash = strrchr(argv[0], '/');
+		if (slash) {
+			sim_path = malloc(slash - argv[0] + sizeof("/re_sim"));
+			sprintf((char *)sim_path, "%.*s/re_sim",
+					(int)(slash - argv[0]), argv[0]);
+		} else {
+			sim_path = "./re_sim";
+		}
+	}
+	if (mkdir(cache_dir, 0755) && errno != EEXIST) {
+		perror(cache_dir);
+		return 1;
+	}
+
+	nr = (argc - optind) * cases.nr * factors.nr * freqs.nr;
+	jobs = calloc(nr, sizeof(*jobs));
+	if (!jobs)
+		return 1;
+	i = 0;
+	for (w = optind; w < (unsigned int)argc; w++)
+		for (c = 0; c < cases.nr; c++)
+			for (f = 0; f < factors.nr; f++)
+				for (d = 0; d < freqs.nr; d++) {
+					jobs[i].workload = argv[w];
+					jobs[i].fit_case = cases.val[c];
+					jobs[i].target_factor = factors.val[f];
+					jobs[i].dyn_freq = freqs.val[d];
+					job_argv(&jobs[i], sim_argv);
+					job_hash(&jobs[i], sim_argv);
+					i++;
+				}
+
+	/*
+	 * Runs are independent, so a shared queue that each free slot pulls
+	 * the next run from keeps every cpu busy until the grid is drained.
+	 */
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	while (next < nr || running) {
+		while (next < nr && running < jobs_max) {
+			if (!load_result(&jobs[next])) {
+				cached++;
+			} else if (start_job(&jobs[next])) {
+				perror("re_sim");
+				failed++;
+			} else {
+				running++;
+			}
+			next++;
+		}
+		if (!running)
+			continue;
+		pid = wait(&status);
+		if (pid < 0)
+			break;
+		for (i = 0; i < nr; i++)
+			if (jobs[i].pid == pid)
+				break;
+		if (i == nr)
+			continue;
+		running--;
+		if (finish_job(&jobs[i], status)) {
+			fprintf(stderr, "re_sim failed: case %u factor %u dyn_freq %u %s\n",
+					jobs[i].fit_case, jobs[i].target_factor,
+					jobs[i].dyn_freq, jobs[i].workload);
+			failed++;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	report(jobs, nr, all);
+	fprintf(stderr, "%u configurations, %u cached, %u failed, %.1f s on %u jobs\n",
+			nr, cached, failed, (t1.tv_sec - t0.tv_sec) +
+			(t1.tv_nsec - t0.tv_nsec) / 1e9, jobs_max);
+	return failed ? 1 : 0;
+bad:
+	usage(argv[0]);
+	return 1;
+}
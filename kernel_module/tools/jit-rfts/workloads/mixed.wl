@@ -0,0 +1,6 @@
+# seconds util% distribution mean_interarrival_usec
+# interactive bursts over a mostly idle baseline
+60	5	exp	20000
+20	60	exp	2000
+30	15	uniform	5000
+10	90	fixed	1000